@@ -0,0 +1,117 @@
+//! Allocation and hydration benches against the mock engine's fake slabs.
+//!
+//! Run with `cargo bench --no-default-features`, the extension-module feature
+//! leaves libpython unlinked and the bench binary would not load.
+
+mod mock_engine;
+
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use elbo_sdk_rust::bench_api::{self as sdk, AssetSyncContext, GroupNames, MeshSendInput};
+use mock_engine::MockEngine;
+use pivot_com_types::fields::Uuid;
+use pyo3::prelude::*;
+use std::time::Duration;
+
+const ATTACH_TIMEOUT: Duration = Duration::from_secs(10);
+const ASSET_COUNTS: [usize; 3] = [1, 1_000, 100_000];
+
+fn attach(name: &str) -> MockEngine {
+    let engine = MockEngine::spawn(&format!("bench-{}-{}", name, std::process::id()));
+    sdk::attach_engine(Some(engine.instance().to_string()), ATTACH_TIMEOUT, 1).expect("Failed to attach to mock engine");
+    engine
+}
+
+/// prepare_mesh_send arguments for `count` small cube-sized assets
+struct Scene {
+    vert_counts: Vec<u32>,
+    edge_counts: Vec<u32>,
+    loop_counts: Vec<u32>,
+    total_loop_lengths: Vec<u32>,
+    object_counts: Vec<u32>,
+    group_names: Vec<String>,
+    surface_contexts: Vec<u16>,
+    asset_uuids: Vec<Uuid>,
+}
+
+impl Scene {
+    fn new(count: usize) -> Scene {
+        Scene {
+            vert_counts: vec![8; count],
+            edge_counts: vec![12; count],
+            loop_counts: vec![6; count],
+            total_loop_lengths: vec![24; count],
+            object_counts: vec![1; count],
+            group_names: (0..count).map(|i| format!("group_{}", i)).collect(),
+            surface_contexts: vec![0; count],
+            asset_uuids: (0..count).map(|_| Uuid { bytes: sdk::generate_uuid_bytes() }).collect(),
+        }
+    }
+
+    fn input(&self) -> MeshSendInput<'_> {
+        MeshSendInput {
+            vert_counts: &self.vert_counts,
+            edge_counts: &self.edge_counts,
+            loop_counts: &self.loop_counts,
+            total_loop_lengths: &self.total_loop_lengths,
+            object_counts: &self.object_counts,
+            group_names: GroupNames::List(&self.group_names),
+            surface_contexts: &self.surface_contexts,
+            asset_uuids: &self.asset_uuids,
+        }
+    }
+}
+
+/// One alloc_request round-trip plus writing every asset's meta and group name
+fn allocate_memory(c: &mut Criterion) {
+    let _engine = attach("allocate-memory");
+    let mut group = c.benchmark_group("allocate_memory");
+
+    for count in ASSET_COUNTS {
+        let scene = Scene::new(count);
+        group.throughput(Throughput::Elements(count as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(count), &scene, |b, scene| {
+            b.iter(|| sdk::allocate_memory(&scene.input()).unwrap())
+        });
+    }
+
+    group.finish();
+    sdk::stop_engine().unwrap();
+}
+
+/// Resolving asset pointers to local addresses, with every slab already mapped
+fn hydrate_ptrs(c: &mut Criterion) {
+    let engine = attach("hydrate-ptrs");
+    let root_handle = engine.root_handle();
+    let mut group = c.benchmark_group("hydrate_ptrs");
+
+    for count in ASSET_COUNTS {
+        let asset_ptrs = engine.allocate(&vec![1024; count]);
+        group.throughput(Throughput::Elements(count as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(count), &asset_ptrs, |b, asset_ptrs| {
+            b.iter(|| sdk::hydrate_ptrs(asset_ptrs, &root_handle).unwrap())
+        });
+    }
+
+    group.finish();
+    sdk::stop_engine().unwrap();
+}
+
+/// The eleven memoryviews Python fills one asset through
+fn buffers(c: &mut Criterion) {
+    let _engine = attach("buffers");
+    let scene = Scene::new(1);
+    let context = sdk::allocate_memory(&scene.input()).unwrap();
+
+    Python::initialize();
+    Python::attach(|py| {
+        let context = Bound::new(py, context).unwrap();
+        c.bench_function("asset_sync_context_buffers", |b| {
+            b.iter(|| AssetSyncContext::buffers(&context, 0).unwrap())
+        });
+    });
+
+    sdk::stop_engine().unwrap();
+}
+
+criterion_group!(benches, allocate_memory, hydrate_ptrs, buffers);
+criterion_main!(benches);
@@ -0,0 +1,101 @@
+//! Command round-trip benches against an in-process mock engine.
+//!
+//! Run with `cargo bench --no-default-features`, the extension-module feature
+//! leaves libpython unlinked and the bench binary would not load.
+
+mod mock_engine;
+
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use elbo_sdk_rust::bench_api as sdk;
+use mock_engine::MockEngine;
+use pivot_com_types::fields::Uuid;
+use std::time::Duration;
+
+const ATTACH_TIMEOUT: Duration = Duration::from_secs(10);
+
+fn attach(name: &str) -> MockEngine {
+    let engine = MockEngine::spawn(&format!("bench-{}-{}", name, std::process::id()));
+    sdk::attach_engine(Some(engine.instance().to_string()), ATTACH_TIMEOUT, 1).expect("Failed to attach to mock engine");
+    engine
+}
+
+fn uuids(count: usize) -> Vec<Uuid> {
+    (0..count).map(|_| Uuid { bytes: sdk::generate_uuid_bytes() }).collect()
+}
+
+/// One blocking command at a time, the latency of a single round-trip
+fn round_trip(c: &mut Criterion) {
+    let _engine = attach("round-trip");
+    let mut group = c.benchmark_group("round_trip");
+
+    group.bench_function("organize_objects", |b| b.iter(|| sdk::organize_objects_command().unwrap()));
+    group.bench_function("drop_groups", |b| {
+        let batch = uuids(1);
+        b.iter(|| sdk::drop_groups_command(batch.clone()).unwrap())
+    });
+
+    group.finish();
+    sdk::stop_engine().unwrap();
+}
+
+/// `depth` commands submitted before waiting on any, with and without coalescing
+fn pipelined(c: &mut Criterion) {
+    let _engine = attach("pipelined");
+    let mut group = c.benchmark_group("pipelined");
+    let batch = uuids(1);
+
+    for coalesce in [false, true] {
+        sdk::set_command_coalescing(coalesce, Duration::ZERO);
+        let name = if coalesce { "drop_groups_coalesced" } else { "drop_groups" };
+
+        for depth in [1usize, 4, 16] {
+            group.throughput(Throughput::Elements(depth as u64));
+            group.bench_with_input(BenchmarkId::new(name, depth), &depth, |b, &depth| {
+                b.iter(|| {
+                    let handles: Vec<_> = (0..depth)
+                        .map(|_| sdk::submit_drop_groups_command(batch.clone()).unwrap())
+                        .collect();
+                    for handle in handles {
+                        handle.wait().unwrap();
+                    }
+                })
+            });
+        }
+    }
+
+    sdk::set_command_coalescing(false, Duration::ZERO);
+    group.finish();
+    sdk::stop_engine().unwrap();
+}
+
+/// TboExportContext's cycle over the engine calls: tbo_downsample and drop_groups per
+/// batch until the flush point, then tbo_flush and drop_all_groups
+fn tbo_export(c: &mut Criterion) {
+    let _engine = attach("tbo-export");
+    let output_dir = std::env::temp_dir().join(format!("bench-tbo-{}", std::process::id()));
+    let output_dir = output_dir.to_string_lossy().to_string();
+    let mut group = c.benchmark_group("tbo_export");
+
+    const BATCH_SIZE: usize = 900;
+    const BATCHES_PER_FLUSH: usize = 8;
+    let batches: Vec<Vec<Uuid>> = (0..BATCHES_PER_FLUSH).map(|_| uuids(BATCH_SIZE)).collect();
+
+    group.throughput(Throughput::Elements((BATCH_SIZE * BATCHES_PER_FLUSH) as u64));
+    group.bench_function("accumulate_flush", |b| {
+        b.iter(|| {
+            for batch in &batches {
+                sdk::tbo_downsample_command(batch).unwrap();
+                sdk::drop_groups_command(batch.clone()).unwrap();
+            }
+            sdk::submit_tbo_flush_command(&output_dir, 1 << 30, 0).unwrap().wait().unwrap();
+            sdk::drop_all_groups_command().unwrap();
+        })
+    });
+
+    group.finish();
+    sdk::stop_engine().unwrap();
+    let _ = std::fs::remove_dir_all(&output_dir);
+}
+
+criterion_group!(benches, round_trip, pipelined, tbo_export);
+criterion_main!(benches);
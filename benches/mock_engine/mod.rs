@@ -0,0 +1,152 @@
+//! In-process stand-in for pivot_engine, serving an instance's iceoryx2 services.
+//!
+//! Commands are answered without any engine work, so the benches measure the SDK
+//! side of a round-trip (queueing, loan, send, wakeup, receive, hydration).
+//! alloc_request is answered with real allocations from the fake slabs in
+//! `slabs`, tbo_downsample with the meshes accumulated since the last flush and
+//! tbo_flush with one file name; everything else gets a plain acknowledgement.
+
+mod slabs;
+
+use iceoryx2::prelude::*;
+use pivot_com_types::{EngineCommand, EngineResponse, MeshPublish};
+use pivot_com_types::asset_ptr::AssetPtr;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex};
+use std::sync::mpsc;
+use std::thread::{self, JoinHandle};
+use std::time::Duration;
+
+use elbo_sdk_rust::bench_api::ServiceNames;
+use slabs::FakeSlabs;
+
+/// Upper bound on one wait for command events, so shutdown is noticed
+const EVENT_TIMEOUT: Duration = Duration::from_millis(10);
+
+pub struct MockEngine {
+    instance: String,
+    slabs: Arc<Mutex<FakeSlabs>>,
+    shutdown: Arc<AtomicBool>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl MockEngine {
+    /// Creates the services of `instance` and answers them until dropped
+    pub fn spawn(instance: &str) -> MockEngine {
+        let shutdown = Arc::new(AtomicBool::new(false));
+        let (ready_tx, ready_rx) = mpsc::channel();
+        let names = ServiceNames::new(Some(instance));
+        let slabs = Arc::new(Mutex::new(FakeSlabs::create(instance)));
+        let thread = {
+            let (slabs, shutdown) = (slabs.clone(), shutdown.clone());
+            thread::spawn(move || serve(names, slabs, shutdown, ready_tx))
+        };
+        ready_rx.recv().expect("Mock engine failed to create its services");
+
+        MockEngine {
+            instance: instance.to_string(),
+            slabs,
+            shutdown,
+            thread: Some(thread),
+        }
+    }
+
+    pub fn instance(&self) -> &str {
+        &self.instance
+    }
+
+    /// Allocates like an alloc_request would, for benches that hydrate pointers directly
+    #[allow(dead_code)] // Not every bench binary hydrates directly
+    pub fn allocate(&self, sizes: &[usize]) -> Vec<AssetPtr> {
+        self.slabs
+            .lock()
+            .unwrap()
+            .allocate(sizes.iter().copied())
+            .expect("Mock slab too small for the requested sizes")
+    }
+
+    /// Root slab handle every response carries
+    #[allow(dead_code)]
+    pub fn root_handle(&self) -> Vec<u8> {
+        self.slabs.lock().unwrap().root_handle().to_vec()
+    }
+}
+
+impl Drop for MockEngine {
+    fn drop(&mut self) {
+        self.shutdown.store(true, Ordering::Relaxed);
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+fn serve(names: ServiceNames, slabs: Arc<Mutex<FakeSlabs>>, shutdown: Arc<AtomicBool>, ready: mpsc::Sender<()>) {
+    let node = NodeBuilder::new()
+        .create::<ipc::Service>()
+        .expect("Failed to create mock engine node");
+    let event = |name: &str| {
+        node.service_builder(&name.try_into().unwrap())
+            .event()
+            .open_or_create()
+            .expect("Failed to create mock engine event service")
+    };
+
+    let command_service = node
+        .service_builder(&names.command.as_str().try_into().unwrap())
+        .request_response::<EngineCommand, EngineResponse>()
+        .open_or_create()
+        .expect("Failed to create mock command service");
+    let mesh_service = node
+        .service_builder(&names.mesh_updates.as_str().try_into().unwrap())
+        .publish_subscribe::<MeshPublish>()
+        .open_or_create()
+        .expect("Failed to create mock mesh update service");
+
+    let server = command_service.server_builder().create().unwrap();
+    let command_listener = event(&names.command_events).listener_builder().create().unwrap();
+    let response_notifier = event(&names.response_events).notifier_builder().create().unwrap();
+    // Never publishes, but the SDK's mesh sync thread only reports ready once these exist
+    let _mesh_publisher = mesh_service.publisher_builder().create().unwrap();
+    let _notifications = event(&names.notifications).notifier_builder().create().unwrap();
+
+    let _ = ready.send(());
+    let mut accumulated = 0u32;
+
+    while !shutdown.load(Ordering::Relaxed) {
+        let _ = command_listener.timed_wait_all(|_| {}, EVENT_TIMEOUT);
+
+        let mut answered = false;
+        while let Ok(Some(request)) = server.receive() {
+            let reply = answer(request.payload(), &mut slabs.lock().unwrap(), &mut accumulated);
+            let Ok(response) = request.loan_uninit() else { continue };
+            let _ = response.write_payload(reply).send();
+            answered = true;
+        }
+        if answered {
+            let _ = response_notifier.notify();
+        }
+    }
+}
+
+/// The response the engine would send for `command`, minus the work behind it
+fn answer(command: &EngineCommand, slabs: &mut FakeSlabs, accumulated: &mut u32) -> EngineResponse {
+    let mut response = if let Ok((uuids, sizes)) = command.read_alloc_request() {
+        match slabs.allocate(sizes.iter().map(|&size| size as usize)) {
+            Some(ptrs) => EngineResponse::alloc_response(uuids, &ptrs),
+            None => EngineResponse::ack(),
+        }
+    } else if let Ok(uuids) = command.read_tbo_downsample() {
+        *accumulated += uuids.len() as u32;
+        EngineResponse::tbo_downsample(*accumulated)
+    } else if let Ok((_path, _target_bytes, batch_offset)) = command.read_tbo_flush() {
+        *accumulated = 0;
+        EngineResponse::tbo_flush(&[format!("mesh_{}.tbo", batch_offset).as_str()])
+    } else {
+        EngineResponse::ack()
+    };
+
+    let root = slabs.root_handle();
+    response.header.root_slab_handle[..root.len()].copy_from_slice(root);
+    response
+}
@@ -0,0 +1,91 @@
+//! Fake slab memory for the mock engine: a root slab holding the SlabRegistry and
+//! one asset slab that allocations are bump-allocated from.
+//!
+//! The SDK maps both exactly as it maps the engine's, so alloc responses and
+//! asset pointers handed out here hydrate for real. The bump offset wraps when a
+//! request doesn't fit, the benches never keep assets across requests.
+
+use iceoryx2_bb_posix::creation_mode::CreationMode;
+use iceoryx2_bb_posix::permission::Permission;
+use iceoryx2_bb_posix::shared_memory::{SharedMemory, SharedMemoryBuilder};
+use iceoryx2_bb_system_types::file_name::FileName;
+use pivot_com_types::alloc::SlabRegistry;
+use pivot_com_types::asset_ptr::AssetPtr;
+
+/// Size of the asset slab, enough for the largest bench request
+const ASSET_SLAB_BYTES: usize = 256 << 20;
+/// Alignment of every allocation, AssetMeta and the float arrays behind it need no more
+const ALLOC_ALIGN: usize = 16;
+/// Index of the asset slab in the registry, 0 is the root slab
+const ASSET_SLAB: u32 = 1;
+
+pub struct FakeSlabs {
+    root_handle: String,
+    _root: SharedMemory,
+    _assets: SharedMemory,
+    capacity: usize,
+    next: usize,
+}
+
+impl FakeSlabs {
+    pub fn create(instance: &str) -> FakeSlabs {
+        let root_handle = format!("mock_{}_root", instance);
+        let asset_handle = format!("mock_{}_slab1", instance);
+        let root = create_shm(&root_handle, std::mem::size_of::<SlabRegistry>());
+        let assets = create_shm(&asset_handle, ASSET_SLAB_BYTES);
+
+        // Zeroed on creation, only the count and the two handles need filling in
+        let registry = root.base_address().as_ptr() as *mut SlabRegistry;
+        unsafe {
+            (*registry).slab_handles[0][..root_handle.len()].copy_from_slice(root_handle.as_bytes());
+            (*registry).slab_handles[ASSET_SLAB as usize][..asset_handle.len()].copy_from_slice(asset_handle.as_bytes());
+            std::ptr::write_volatile(std::ptr::addr_of_mut!((*registry).num_slabs), 2);
+        }
+
+        FakeSlabs {
+            root_handle,
+            capacity: assets.size(),
+            _root: root,
+            _assets: assets,
+            next: 0,
+        }
+    }
+
+    /// Handle the SDK opens the registry with, sent in every response header
+    pub fn root_handle(&self) -> &[u8] {
+        self.root_handle.as_bytes()
+    }
+
+    /// One asset pointer per requested size, or None if the request is larger than the slab
+    pub fn allocate(&mut self, sizes: impl IntoIterator<Item = usize> + Clone) -> Option<Vec<AssetPtr>> {
+        let total: usize = sizes.clone().into_iter().map(|size| size.next_multiple_of(ALLOC_ALIGN)).sum();
+        if total > self.capacity {
+            return None;
+        }
+        if self.next + total > self.capacity {
+            self.next = 0;
+        }
+
+        let ptrs = sizes
+            .into_iter()
+            .map(|size| {
+                let ptr = AssetPtr::new(ASSET_SLAB, self.next as u64);
+                self.next += size.next_multiple_of(ALLOC_ALIGN);
+                ptr
+            })
+            .collect();
+        Some(ptrs)
+    }
+}
+
+fn create_shm(handle: &str, size: usize) -> SharedMemory {
+    let name = FileName::new(handle.as_bytes()).expect("Invalid mock slab name");
+    SharedMemoryBuilder::new(&name)
+        .is_memory_locked(false)
+        .creation_mode(CreationMode::PurgeAndCreate)
+        .size(size)
+        .permission(Permission::OWNER_ALL)
+        .zero_memory(true)
+        .create()
+        .expect("Failed to create mock slab")
+}
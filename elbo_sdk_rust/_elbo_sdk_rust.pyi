@@ -1,7 +1,29 @@
-from typing import List, Dict, Tuple, Optional
+from typing import Any, Dict, Generator, Iterator, List, Optional, Sequence, Tuple, Union
 
+# Any object exporting the buffer protocol (numpy arrays, array.array, bytes, memoryview)
+Buffer = Union[bytes, bytearray, memoryview, Any]
 
-def start_engine() -> None: ...
+
+def start_engine(
+    wait: bool = False,
+    timeout: float = 30.0,
+    instance: Optional[str] = None,
+    persistent: bool = False,
+    shards: int = 1,
+) -> None: ...
+
+
+def attach_engine(
+    instance: Optional[str] = None,
+    timeout: float = 30.0,
+    shards: int = 1,
+) -> None: ...
+
+
+def is_engine_ready() -> bool: ...
+
+
+def get_engine_shard_count() -> int: ...
 
 
 def stop_engine() -> None: ...
@@ -10,24 +32,77 @@ def stop_engine() -> None: ...
 def standardize_synced_groups_command(
     uuids: List[bytes],
     surface_contexts: List[int],
+    timeout: Optional[float] = None,
 ) -> None: ...
 
 
-def set_surface_types_command(group_surface_map: Dict[bytes, int]) -> None: ...
+def set_surface_types_command(group_surface_map: Dict[bytes, int], timeout: Optional[float] = None) -> None: ...
 
 
-def drop_groups_command(uuids: List[bytes]) -> None: ...
+def drop_groups_command(uuids: List[bytes], timeout: Optional[float] = None) -> None: ...
 
 
-def get_surface_types_command() -> None: ...
+def get_surface_types_command(timeout: Optional[float] = None) -> None: ...
 
 
-def organize_objects_command() -> None: ...
+def organize_objects_command(timeout: Optional[float] = None) -> None: ...
 
 
 def poll_mesh_sync() -> Optional["AssetSyncContext"]: ...
 
 
+def poll_mesh_sync_all() -> Optional["AssetSyncContext"]: ...
+
+
+def set_mesh_queue_capacity(capacity: int) -> None: ...
+
+
+def mesh_sync_fd() -> int: ...
+
+
+def set_prefault_allocations(enabled: bool) -> None: ...
+
+
+def set_command_coalescing(enabled: bool, linger: float = 0.0) -> None: ...
+
+
+def forget_content_hashes(uuids: Optional[List[bytes]] = None) -> None: ...
+
+
+def set_engine_capabilities(capabilities: List[str]) -> None: ...
+
+
+def set_command_timeout(timeout: Optional[float] = None) -> None: ...
+
+
+def engine_health(stall_after: float = 10.0) -> Dict[str, Any]: ...
+
+
+def reclaim_slab_memory(advise: bool = True) -> Dict[str, Any]: ...
+
+
+def set_slab_map_options(
+    huge_pages: bool = False,
+    populate: bool = False,
+    numa_node: Optional[int] = None,
+) -> None: ...
+
+
+def get_engine_stats() -> Dict[str, Any]: ...
+
+
+def reset_engine_stats() -> None: ...
+
+
+def enable_tracing() -> None: ...
+
+
+def disable_tracing() -> None: ...
+
+
+def dump_trace(path: str, clear: bool = True) -> int: ...
+
+
 def prepare_standardize_groups(
     vert_counts: List[int],
     edge_counts: List[int],
@@ -41,6 +116,66 @@ def prepare_standardize_groups(
 ) -> "AssetSyncContext": ...
 
 
+def prepare_mesh_send_buffers(
+    vert_counts: Buffer,
+    edge_counts: Buffer,
+    loop_counts: Buffer,
+    total_loop_lengths: Buffer,
+    object_counts: Buffer,
+    group_names: Buffer,
+    group_name_offsets: Buffer,
+    surface_contexts: Buffer,
+    asset_uuids: Buffer,
+    content_hashes: Optional[Buffer] = None,
+) -> "AssetSyncContext": ...
+
+
+def content_hash(*buffers: Buffer) -> int: ...
+
+
+def prepare_mesh_send_stream(
+    vert_counts: List[int],
+    edge_counts: List[int],
+    loop_counts: List[int],
+    total_loop_lengths: List[int],
+    object_counts: List[int],
+    group_names: List[str],
+    surface_contexts: List[int],
+    asset_uuids: List[bytes],
+    chunk_size: int = 4096,
+    max_in_flight: int = 2,
+) -> "MeshSendStream": ...
+
+
+def prepare_mesh_send_buffers_stream(
+    vert_counts: Buffer,
+    edge_counts: Buffer,
+    loop_counts: Buffer,
+    total_loop_lengths: Buffer,
+    object_counts: Buffer,
+    group_names: Buffer,
+    group_name_offsets: Buffer,
+    surface_contexts: Buffer,
+    asset_uuids: Buffer,
+    chunk_size: int = 4096,
+    max_in_flight: int = 2,
+) -> "MeshSendStream": ...
+
+
+class MeshSendStream:
+    """Iterator of per-chunk AssetSyncContexts, allocated ahead while the current one is filled.
+
+    Chunks still in flight on close() or drop are sent back to the engine as empty assets.
+    """
+    def close(self) -> None: ...
+    @property
+    def chunk_count(self) -> int: ...
+    @property
+    def asset_count(self) -> int: ...
+    def __iter__(self) -> Iterator["AssetSyncContext"]: ...
+    def __next__(self) -> "AssetSyncContext": ...
+
+
 def generate_uuid_bytes() -> bytes: ...
 
 
@@ -53,9 +188,131 @@ def get_platform_id() -> str: ...
 def set_engine_dir(path: str) -> None: ...
 
 
+class AssetBuffers(Sequence[Tuple["TypedBuffer", ...]]):
+    def __len__(self) -> int: ...
+    def __getitem__(self, i: int) -> Tuple["TypedBuffer", ...]: ...
+
+
 class AssetSyncContext:
     def uuids(self) -> memoryview: ...
     def surface_contexts(self) -> memoryview: ...
     def buffers(self, i: int) -> Tuple[memoryview, memoryview, memoryview, memoryview, memoryview, memoryview, memoryview, memoryview, memoryview, memoryview]: ...
+    def all_buffers(self) -> "AssetBuffers": ...
+    def buffer_table(self) -> "TypedBuffer": ...
     def size(self) -> int: ...
+    def send(self) -> int: ...
     def finalize(self) -> None: ...
+
+
+def submit_drop_groups_command(uuids: List[bytes]) -> "PendingCommand":
+    """Runs on the bulk lane, see PendingCommand for ordering."""
+
+
+def submit_standardize_groups_command(uuids: List[bytes]) -> "PendingCommand":
+    """Runs on the bulk lane, see PendingCommand for ordering."""
+
+
+def submit_standardize_synced_groups_command(
+    uuids: List[bytes],
+    surface_contexts: List[int],
+) -> "PendingCommand":
+    """Runs on the interactive lane, see PendingCommand for ordering."""
+
+
+def submit_set_surface_types_command(group_surface_map: Dict[bytes, int]) -> "PendingCommand":
+    """Runs on the interactive lane, see PendingCommand for ordering."""
+
+
+def submit_tbo_downsample_command(uuids: List[bytes]) -> "PendingCommand":
+    """Runs on the bulk lane, see PendingCommand for ordering."""
+
+
+def submit_tbo_flush_command(path: str, target_bytes: int, batch_offset: int) -> "PendingCommand":
+    """Runs on the bulk lane, see PendingCommand for ordering."""
+
+
+def submit_export_all_asset_tbo_command(path: str, target_bytes: int, skip_normalization: bool) -> "PendingCommand":
+    """Runs on the bulk lane, see PendingCommand for ordering."""
+
+
+def stream_tbo_flush_command(path: str, target_bytes: int, batch_offset: int) -> "TboFileStream": ...
+
+
+def stream_export_all_asset_tbo_command(path: str, target_bytes: int, skip_normalization: bool = False) -> "TboFileStream": ...
+
+
+class TboReader:
+    """Memory-mapped .tbo file with zero-copy channel views."""
+    def __init__(self, path: str, sequential: bool = False) -> None: ...
+    @property
+    def mesh_count(self) -> int: ...
+    @property
+    def point_count(self) -> int: ...
+    @property
+    def mode(self) -> str: ...
+    @property
+    def channels(self) -> List[str]: ...
+    def __len__(self) -> int: ...
+    def channel(self, name: str, start: int = 0, stop: Optional[int] = None) -> "TypedBuffer": ...
+    def mesh(self, index: int) -> Dict[str, "TypedBuffer"]: ...
+    def prefetch(self, start: int = 0, stop: Optional[int] = None) -> None: ...
+    def set_access_pattern(self, pattern: str) -> None: ...
+
+
+class TboFileStream:
+    """Iterator of (path, size_bytes) for every written file, as it lands in the output directory."""
+    def __iter__(self) -> Iterator[Tuple[str, Optional[int]]]: ...
+    def __next__(self) -> Tuple[str, Optional[int]]: ...
+    def cancel(self) -> None: ...
+
+
+def submit_import_assets_command(paths: List[str]) -> "PendingCommand":
+    """Runs on the bulk lane, see PendingCommand for ordering."""
+
+
+def import_assets_stream(
+    paths: List[str],
+    batch_size: int = 1,
+    max_in_flight: int = 4,
+    deliver_assets: bool = False,
+) -> "ImportStream": ...
+
+
+class ImportStream:
+    """Iterator of (paths, command_error, assets) per answered batch, in completion order.
+
+    command_error is only set when the command didn't go through (transport error, timeout, cancel).
+    With deliver_assets, assets holds every mesh sync publish received so far, not only the batch's.
+    """
+    @property
+    def total(self) -> int: ...
+    @property
+    def completed(self) -> int: ...
+    @property
+    def command_failed(self) -> int: ...
+    def __iter__(self) -> Iterator[Tuple[List[str], Optional[str], Optional["AssetSyncContext"]]]: ...
+    def __next__(self) -> Tuple[List[str], Optional[str], Optional["AssetSyncContext"]]: ...
+    def cancel(self) -> None: ...
+
+
+class PendingCommand:
+    """A command submitted without waiting for its response.
+
+    Commands go to one of two lanes. alloc, send, standardize_synced_groups,
+    set/get_surface_types and tbo_config run on the interactive lane, every
+    other command on the bulk lane. Commands keep their order within a lane
+    only: one submitted later on the other lane can reach the engine first,
+    even when both touch the same groups. Wait on a command before submitting
+    one that depends on it.
+    """
+    @property
+    def request_id(self) -> int: ...
+    def done(self) -> bool: ...
+    def result(self, timeout: Optional[float] = None) -> Any: ...
+    def cancel(self) -> None: ...
+    def __await__(self) -> Generator[Any, None, Any]: ...
+
+
+class TypedBuffer:
+    """Zero-copy buffer-protocol view with a typed format and shape."""
+    def __len__(self) -> int: ...
@@ -2,21 +2,60 @@ use pivot_com_types::{
     asset_meta::{AssetDataSlices, AssetMeta},
     asset_ptr::AssetPtr, fields::Uuid,
 };
-use pyo3::{ffi, prelude::*, types::PyByteArray};
-use std::{os::raw::c_char, ptr::NonNull};
+use pyo3::{prelude::*, types::{PyMemoryView, PyTuple}};
+use std::{any::Any, ffi::CStr, ptr::NonNull, sync::Arc};
 
 use crate::engine_api;
+use crate::slab_table::SlabPin;
+use crate::typed_buffer::TypedBuffer;
+
+/// Element layout of each slice, in buffers() tuple order:
+/// (verts, edges, loops, loop_bases, object_loop_counts, transforms, vert_counts, edge_counts, object_names, obj_uuids, embeddings)
+const FIELD_FORMATS: [(usize, &CStr); FIELD_COUNT] = [
+    (4, c"f"),
+    (4, c"i"),
+    (4, c"i"),
+    (4, c"i"),
+    (4, c"i"),
+    (4, c"f"),
+    (4, c"i"),
+    (4, c"i"),
+    (1, c"B"),
+    (Uuid::SIZE, c"32s"),
+    (4, c"f"),
+];
+
+const FIELD_COUNT: usize = 11;
 
 #[pyclass(unsendable)]
 pub struct AssetSyncContext {
     asset_slices: Vec<AssetDataSlices>,
     asset_ptrs: Vec<AssetPtr>,
-    asset_uuids: Vec<Uuid>,
-    asset_surface_contexts: Vec<u16>
+    /// Engine shard each asset lives on, send() returns it there
+    asset_shards: Vec<u16>,
+    asset_uuids: Arc<[Uuid]>,
+    asset_surface_contexts: Arc<[u16]>,
+    /// Buffer-protocol views over the two arrays above, created on first use
+    uuids_view: Option<Py<TypedBuffer>>,
+    surface_contexts_view: Option<Py<TypedBuffer>>,
+    /// Content hash of every asset when prepared with content_hashes, recorded once sent
+    content_hashes: Option<Vec<u64>>,
+    /// Keeps the slabs behind asset_slices mapped until the context is dropped
+    _pin: SlabPin,
 }
 
+// The slices point into engine shared memory that stays mapped while the context holds its SlabPin,
+// so the context can be built or consumed off the Python thread while the GIL is released.
+unsafe impl Send for AssetSyncContext {}
+
 impl AssetSyncContext {
-    pub fn new(ptrs: Vec<NonNull<AssetMeta>>, asset_ptrs: &[AssetPtr]) -> AssetSyncContext {
+    /// `pin` must have been taken before `ptrs` were hydrated
+    pub fn new(
+        ptrs: Vec<NonNull<AssetMeta>>,
+        asset_ptrs: &[AssetPtr],
+        asset_shards: Vec<u16>,
+        pin: SlabPin,
+    ) -> AssetSyncContext {
         let mut asset_slices = Vec::with_capacity(ptrs.len());
         let mut asset_uuids = Vec::with_capacity(ptrs.len());
         let mut asset_surface_contexts = Vec::with_capacity(ptrs.len());
@@ -30,34 +69,128 @@ impl AssetSyncContext {
         AssetSyncContext {
             asset_slices,
             asset_ptrs: asset_ptrs.to_vec(),
-            asset_uuids,
-            asset_surface_contexts,
+            asset_shards,
+            asset_uuids: asset_uuids.into(),
+            asset_surface_contexts: asset_surface_contexts.into(),
+            uuids_view: None,
+            surface_contexts_view: None,
+            content_hashes: None,
+            _pin: pin,
+        }
+    }
+
+    /// A context without assets, sending it is a no-op
+    pub fn empty() -> AssetSyncContext {
+        AssetSyncContext::new(Vec::new(), &[], Vec::new(), SlabPin::new())
+    }
+
+    /// Merges per-shard contexts back into request order, asset k of a part goes to `positions[k]`
+    pub fn interleave(parts: Vec<(Vec<usize>, AssetSyncContext)>, count: usize) -> AssetSyncContext {
+        let mut asset_slices: Vec<Option<AssetDataSlices>> = (0..count).map(|_| None).collect();
+        let mut asset_ptrs: Vec<Option<AssetPtr>> = (0..count).map(|_| None).collect();
+        let mut asset_shards = vec![0u16; count];
+        let mut asset_uuids = vec![None; count];
+        let mut asset_surface_contexts = vec![0u16; count];
+        // Pins are process wide, the first part's one covers every slab of every shard
+        let mut pin = None;
+
+        for (positions, part) in parts {
+            let slices = part.asset_slices.into_iter().zip(part.asset_ptrs);
+            for (k, (&pos, (slice, asset_ptr))) in positions.iter().zip(slices).enumerate() {
+                asset_slices[pos] = Some(slice);
+                asset_ptrs[pos] = Some(asset_ptr);
+                asset_shards[pos] = part.asset_shards[k];
+                asset_uuids[pos] = Some(part.asset_uuids[k]);
+                asset_surface_contexts[pos] = part.asset_surface_contexts[k];
+            }
+            pin.get_or_insert(part._pin);
+        }
+
+        AssetSyncContext {
+            asset_slices: asset_slices.into_iter().flatten().collect(),
+            asset_ptrs: asset_ptrs.into_iter().flatten().collect(),
+            asset_shards,
+            asset_uuids: asset_uuids.into_iter().flatten().collect::<Vec<_>>().into(),
+            asset_surface_contexts: asset_surface_contexts.into(),
+            uuids_view: None,
+            surface_contexts_view: None,
+            content_hashes: None,
+            _pin: pin.unwrap_or_else(SlabPin::new),
+        }
+    }
+
+    /// Hashes of the prepared content, one per asset, recorded for the assets once they are sent
+    pub fn set_content_hashes(&mut self, hashes: Vec<u64>) {
+        self.content_hashes = Some(hashes);
+    }
+
+    /// Hands every asset back to the engine, returns how many were sent
+    pub fn send_all(&mut self) -> Result<usize, String> {
+        let asset_ptrs = std::mem::take(&mut self.asset_ptrs);
+        let count = asset_ptrs.len();
+        // Nothing changed or it was sent already, no engine needs to hear about it
+        if count == 0 {
+            return Ok(0);
+        }
+        // Forgotten first, so a failed send never leaves a hash claiming the engine has this content
+        engine_api::forget_content_hashes(Some(&self.asset_uuids));
+        engine_api::send_mesh_command(asset_ptrs, &self.asset_shards)?;
+        if let Some(hashes) = self.content_hashes.take() {
+            engine_api::record_content_hashes(&self.asset_uuids, &hashes);
         }
+        Ok(count)
     }
 }
 
 #[pymethods]
 impl AssetSyncContext {
-    pub fn uuids(&self, py: Python) -> PyResult<Py<PyAny>> {
-        let flattened: Vec<u8> = self.asset_uuids.iter()
-            .flat_map(|uuid| uuid.bytes.iter())
-            .copied()
-            .collect();
+    /// Read-only memoryview of the asset uuids as 32-byte records (format `32s`), no copy.
+    pub fn uuids(&mut self, py: Python) -> PyResult<Py<PyAny>> {
+        if self.uuids_view.is_none() {
+            let data = self.asset_uuids.clone();
+            let buffer = unsafe {
+                TypedBuffer::new(
+                    data.as_ptr() as *mut u8,
+                    data.len() * Uuid::SIZE,
+                    Uuid::SIZE,
+                    c"32s",
+                    &[data.len()],
+                    true,
+                    Some(Box::new(data)),
+                )
+            };
+            self.uuids_view = Some(Py::new(py, buffer)?);
+        }
 
-        Ok(PyByteArray::new(py, &flattened).into_any().unbind())
+        let buffer = self.uuids_view.as_ref().unwrap().bind(py);
+        Ok(PyMemoryView::from(buffer.as_any())?.into_any().unbind())
     }
 
-    pub fn surface_contexts(&self, py: Python) -> PyResult<Py<PyAny>> {
-        let flattened: Vec<u8> = self.asset_surface_contexts.iter()
-            .flat_map(|c| c.to_le_bytes())
-            .collect();
+    /// Read-only memoryview of the surface contexts (format `H`), no copy.
+    pub fn surface_contexts(&mut self, py: Python) -> PyResult<Py<PyAny>> {
+        if self.surface_contexts_view.is_none() {
+            let data = self.asset_surface_contexts.clone();
+            let buffer = unsafe {
+                TypedBuffer::new(
+                    data.as_ptr() as *mut u8,
+                    data.len() * std::mem::size_of::<u16>(),
+                    std::mem::size_of::<u16>(),
+                    c"H",
+                    &[data.len()],
+                    true,
+                    Some(Box::new(data)),
+                )
+            };
+            self.surface_contexts_view = Some(Py::new(py, buffer)?);
+        }
 
-        Ok(PyByteArray::new(py, &flattened).into_any().unbind())
+        let buffer = self.surface_contexts_view.as_ref().unwrap().bind(py);
+        Ok(PyMemoryView::from(buffer.as_any())?.into_any().unbind())
     }
 
+    /// Writable byte memoryviews over asset `i`'s slab buffers, each keeps this context's slabs mapped.
     pub fn buffers(
-        &self,
-        py: Python,
+        slf: &Bound<'_, Self>,
         i: usize,
     ) -> PyResult<(
         Py<PyAny>,
@@ -72,22 +205,25 @@ impl AssetSyncContext {
         Py<PyAny>,
         Py<PyAny>,
     )> {
-        let g = self.asset_slices.get(i).ok_or_else(|| {
+        let py = slf.py();
+        let context = slf.borrow();
+        let g = context.asset_slices.get(i).ok_or_else(|| {
             PyErr::new::<pyo3::exceptions::PyIndexError, _>(format!("index {} out of range", i))
         })?;
+        let owner = slf.clone().unbind();
 
         // Tuple order: (obj_uuids, verts, edges, loops, loop_bases, object_loop_counts, transforms, vert_counts, edge_counts, object_names, embeddings)
-        let obj_uuids = memoryview_from_slice(py, g.0)?;
-        let verts = memoryview_from_slice(py, g.1)?;
-        let edges = memoryview_from_slice(py, g.2)?;
-        let loops = memoryview_from_slice(py, g.3)?;
-        let loop_bases = memoryview_from_slice(py, g.4)?;
-        let object_loop_counts = memoryview_from_slice(py, g.5)?;
-        let transforms = memoryview_from_slice(py, g.6)?;
-        let vert_counts = memoryview_from_slice(py, g.7)?;
-        let edge_counts = memoryview_from_slice(py, g.8)?;
-        let object_names = memoryview_from_slice(py, g.9)?;
-        let embeddings = memoryview_from_slice(py, g.10)?;
+        let obj_uuids = memoryview_from_slice(py, g.0, &owner)?;
+        let verts = memoryview_from_slice(py, g.1, &owner)?;
+        let edges = memoryview_from_slice(py, g.2, &owner)?;
+        let loops = memoryview_from_slice(py, g.3, &owner)?;
+        let loop_bases = memoryview_from_slice(py, g.4, &owner)?;
+        let object_loop_counts = memoryview_from_slice(py, g.5, &owner)?;
+        let transforms = memoryview_from_slice(py, g.6, &owner)?;
+        let vert_counts = memoryview_from_slice(py, g.7, &owner)?;
+        let edge_counts = memoryview_from_slice(py, g.8, &owner)?;
+        let object_names = memoryview_from_slice(py, g.9, &owner)?;
+        let embeddings = memoryview_from_slice(py, g.10, &owner)?;
 
         Ok((
             verts,
@@ -104,28 +240,98 @@ impl AssetSyncContext {
         ))
     }
 
+    /// All buffers of all assets as one lazily indexed sequence of typed zero-copy views.
+    ///
+    /// `all_buffers()[i]` is a tuple in the same order as buffers(), floats as `f`,
+    /// indices/counts as `i`, names as `B` and uuids as 32-byte records, so the views
+    /// can go straight into numpy or foreach_set. Views are only created for the
+    /// assets that are indexed, and each one keeps this context's slabs mapped.
+    pub fn all_buffers(slf: &Bound<'_, Self>) -> PyResult<Py<AssetBuffers>> {
+        Py::new(slf.py(), AssetBuffers { context: slf.clone().unbind() })
+    }
+
+    /// Address table of every slice of every asset, for consumers that build their own views.
+    ///
+    /// Returns a single `Q` buffer shaped (size, 11, 2) holding (address, byte_length)
+    /// per field in buffers() order. The addresses stay valid while the table is alive.
+    pub fn buffer_table(slf: &Bound<'_, Self>) -> PyResult<Py<TypedBuffer>> {
+        let context = slf.borrow();
+        let mut table: Vec<u64> = Vec::with_capacity(context.asset_slices.len() * FIELD_COUNT * 2);
+
+        for g in &context.asset_slices {
+            for slice in ordered_fields(g) {
+                table.push(slice as *mut u8 as u64);
+                table.push(unsafe { (&*slice).len() } as u64);
+            }
+        }
+
+        let ptr = table.as_mut_ptr() as *mut u8;
+        let len = table.len() * std::mem::size_of::<u64>();
+        let shape = [context.asset_slices.len(), FIELD_COUNT, 2];
+        let owner: Box<dyn Any> = Box::new((table, slf.clone().unbind()));
+        let buffer = unsafe { TypedBuffer::new(ptr, len, 8, c"Q", &shape, true, Some(owner)) };
+        Py::new(slf.py(), buffer)
+    }
+
     pub fn size(&self) -> usize {
         self.asset_slices.len()
     }
 
-    pub fn send(&mut self) -> () {
-        let response = engine_api::send_mesh_command(std::mem::take(&mut self.asset_ptrs));
-
-        if response.is_err() {
-            println!("{:?}", response.err());
+    /// Hand the filled buffers back to the engine.
+    ///
+    /// Returns:
+    ///     Number of assets sent
+    pub fn send(&mut self, py: Python) -> usize {
+        match py.detach(|| self.send_all()) {
+            Ok(sent) => sent,
+            Err(e) => {
+                println!("{:?}", e);
+                0
+            }
         }
     }
 }
 
-fn memoryview_from_slice(py: Python, slice_ptr: *mut [u8]) -> PyResult<Py<PyAny>> {
-    let ptr = slice_ptr as *mut u8 as *mut c_char;
-    let len = unsafe { (&*slice_ptr).len() } as isize;
-    let mv = unsafe { ffi::PyMemoryView_FromMemory(ptr, len, ffi::PyBUF_WRITE) };
-    if mv.is_null() {
-        return Err(PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
-            "failed to create memoryview from slice",
-        ));
+/// Sequence returned by AssetSyncContext.all_buffers()
+#[pyclass(unsendable)]
+pub struct AssetBuffers {
+    context: Py<AssetSyncContext>,
+}
+
+#[pymethods]
+impl AssetBuffers {
+    fn __len__(&self, py: Python) -> usize {
+        self.context.borrow(py).size()
+    }
+
+    /// Typed views of asset `i`, negative indices count from the end
+    fn __getitem__(&self, py: Python, i: isize) -> PyResult<Py<PyTuple>> {
+        let context = self.context.borrow(py);
+        let size = context.size() as isize;
+        let index = if i < 0 { i + size } else { i };
+        if index < 0 || index >= size {
+            return Err(PyErr::new::<pyo3::exceptions::PyIndexError, _>(format!("index {} out of range", i)));
+        }
+
+        let fields = ordered_fields(&context.asset_slices[index as usize]);
+        let mut views = Vec::with_capacity(FIELD_COUNT);
+        for (slice, (itemsize, format)) in fields.into_iter().zip(FIELD_FORMATS) {
+            let owner: Box<dyn Any> = Box::new(self.context.clone_ref(py));
+            let buffer = unsafe { TypedBuffer::from_slice(slice, itemsize, format, false, Some(owner)) };
+            views.push(Py::new(py, buffer)?.into_any());
+        }
+        Ok(PyTuple::new(py, views)?.unbind())
     }
-    Ok(unsafe { Py::from_owned_ptr(py, mv) })
 }
 
+/// Slices of one asset reordered to match the buffers() tuple
+fn ordered_fields(g: &AssetDataSlices) -> [*mut [u8]; FIELD_COUNT] {
+    [g.1, g.2, g.3, g.4, g.5, g.6, g.7, g.8, g.9, g.0, g.10]
+}
+
+fn memoryview_from_slice(py: Python, slice_ptr: *mut [u8], context: &Py<AssetSyncContext>) -> PyResult<Py<PyAny>> {
+    let owner: Box<dyn Any> = Box::new(context.clone_ref(py));
+    let buffer = unsafe { TypedBuffer::from_slice(slice_ptr, 1, c"B", false, Some(owner)) };
+    let buffer = Bound::new(py, buffer)?;
+    Ok(PyMemoryView::from(buffer.as_any())?.into_any().unbind())
+}
@@ -1,50 +1,694 @@
+use iceoryx2::pending_response::PendingResponse;
 use iceoryx2::prelude::*;
+use pivot_com_types::asset_surface::GroupSurface;
+use pivot_com_types::fields::Uuid;
 use pivot_com_types::{EngineCommand, EngineResponse};
-use std::sync::Arc;
-use std::sync::atomic::{AtomicBool, Ordering};
+use std::cell::Cell;
+use std::sync::{Arc, LazyLock};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
 use std::thread;
-use std::time::Duration;
+use std::time::{Duration, Instant};
 use crossbeam::channel;
 
-const COMMAND_SERVICE_NAME: &str = "PivotEngine/CommandService";
-const COMMAND_EVENT_SERVICE_NAME: &str = "PivotEngine/CommandEvents";
+use crate::engine_stats::{CommandKind, STATS};
+use crate::readiness::{BULK_COMMAND_SERVICES, DiscoveryBackoff, INTERACTIVE_COMMAND_SERVICES, ReadyLatch};
+use crate::service_names::ServiceNames;
+use crate::trace;
+
+/// Upper bound on a single listener wait so a missed notification never stalls a request
+const RESPONSE_EVENT_TIMEOUT: Duration = Duration::from_millis(5);
+
+/// Requests the command thread keeps outstanding at once (matches the iceoryx2 default max_active_requests_per_client)
+const MAX_IN_FLIGHT: usize = 4;
+
+/// How long to wait for responses while queued commands could still be sent
+const SUBMIT_POLL_TIMEOUT: Duration = Duration::from_millis(1);
+
+/// Capacity of every lane's queue
+pub const LANE_QUEUE_CAPACITY: usize = 10;
+
+/// Upper bound on groups in one coalesced command, keeps a single request's payload reasonable
+const MAX_COALESCED_GROUPS: usize = 1 << 16;
+
+/// Whether runs of queued group commands are merged into one request
+static COALESCE: AtomicBool = AtomicBool::new(false);
+
+/// How long a mergeable command waits for more of its kind once the queue is empty, in microseconds
+static COALESCE_LINGER_US: AtomicU64 = AtomicU64::new(0);
+
+/// Deadline given to newly submitted commands in milliseconds, 0 waits forever
+static DEFAULT_TIMEOUT_MS: AtomicU64 = AtomicU64::new(0);
+
+/// Extra time a caller waits past the deadline for the command thread's own timeout answer,
+/// after that the caller gives up by itself in case the lane thread is stuck
+const CALLER_GRACE: Duration = Duration::from_secs(1);
+
+/// Origin of the heartbeat timestamps
+static HEARTBEAT_EPOCH: LazyLock<Instant> = LazyLock::new(Instant::now);
+
+/// Opt-in: merge adjacent queued drop/standardize/surface type commands into one engine request.
+/// Every caller gets the shared response, an error fails all of them. With a `linger`, a run
+/// that drained the queue waits that long for more commands of its kind before it is sent,
+/// while the lane keeps collecting responses and sending nothing else.
+pub fn set_coalescing(enabled: bool, linger: Duration) {
+    COALESCE_LINGER_US.store(linger.as_micros() as u64, Ordering::Relaxed);
+    COALESCE.store(enabled, Ordering::Relaxed);
+}
+
+/// Deadline for commands submitted from now on, None lets them wait forever
+pub fn set_default_timeout(timeout: Option<Duration>) {
+    let ms = timeout.map_or(0, |t| (t.as_millis() as u64).max(1));
+    DEFAULT_TIMEOUT_MS.store(ms, Ordering::Relaxed);
+}
+
+thread_local! {
+    /// Deadline of the blocking call running on this thread, overrides the default, see with_call_timeout
+    static CALL_TIMEOUT: Cell<Option<Duration>> = const { Cell::new(None) };
+}
+
+/// Deadline for a command submitted now: the current call's own one, else the default
+pub fn default_timeout() -> Option<Duration> {
+    if let Some(timeout) = CALL_TIMEOUT.get() {
+        return Some(timeout);
+    }
+    match DEFAULT_TIMEOUT_MS.load(Ordering::Relaxed) {
+        0 => None,
+        ms => Some(Duration::from_millis(ms)),
+    }
+}
+
+/// Runs `f` with every command it submits from this thread given `timeout` as deadline,
+/// so one blocking call can fan out over shards and still get a single per-call timeout
+pub fn with_call_timeout<R>(timeout: Option<Duration>, f: impl FnOnce() -> R) -> R {
+    struct Restore(Option<Duration>);
+    impl Drop for Restore {
+        fn drop(&mut self) {
+            CALL_TIMEOUT.set(self.0);
+        }
+    }
+
+    let Some(timeout) = timeout else { return f() };
+    let _restore = Restore(CALL_TIMEOUT.replace(Some(timeout)));
+    f()
+}
+
+/// Progress of one lane thread, read by the health check
+#[derive(Debug, Default)]
+pub struct LaneHeartbeat {
+    /// When the oldest outstanding request was sent, in us since HEARTBEAT_EPOCH, 0 when idle
+    oldest_pending_us: AtomicU64,
+    /// When the engine last answered this lane, 0 if it never did
+    last_response_us: AtomicU64,
+}
+
+impl LaneHeartbeat {
+    fn stamp(at: Instant) -> u64 {
+        (at.saturating_duration_since(*HEARTBEAT_EPOCH).as_micros() as u64).max(1)
+    }
+
+    fn age(stamp: u64) -> Option<Duration> {
+        match stamp {
+            0 => None,
+            us => Some(HEARTBEAT_EPOCH.elapsed().saturating_sub(Duration::from_micros(us))),
+        }
+    }
+
+    /// How long the oldest outstanding request has been waiting on the engine
+    pub fn oldest_pending(&self) -> Option<Duration> {
+        Self::age(self.oldest_pending_us.load(Ordering::Relaxed))
+    }
+
+    /// Time since the engine last answered on this lane
+    pub fn since_last_response(&self) -> Option<Duration> {
+        Self::age(self.last_response_us.load(Ordering::Relaxed))
+    }
+}
+
+type CommandResult = Result<EngineResponse, String>;
+type PendingCommandResponse =
+    PendingResponse<ipc::Service, EngineCommand, (), EngineResponse, ()>;
+
+/// Priority lane of a command. Each lane has its own queue, command thread and
+/// iceoryx2 client, so quick UI-driven commands never wait behind an export
+/// in the SDK. Commands stay FIFO within a lane only: a command on one lane can
+/// reach the engine before an earlier one on the other, even for the same
+/// groups, so callers wait on the earlier command before submitting one that
+/// depends on it.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum Lane {
+    Interactive,
+    Bulk,
+}
+
+impl Lane {
+    pub const COUNT: usize = 2;
+
+    pub const ALL: [Lane; Lane::COUNT] = [Lane::Interactive, Lane::Bulk];
+
+    /// Long-running commands and everything that has to stay ordered with them
+    /// (drops after downsampling or exports) go to the bulk lane
+    pub fn of(kind: CommandKind) -> Lane {
+        match kind {
+            CommandKind::AllocRequest
+            | CommandKind::SendMesh
+            | CommandKind::StandardizeSyncedGroups
+            | CommandKind::SetSurfaceTypes
+            | CommandKind::GetSurfaceTypes
+            | CommandKind::TboConfig => Lane::Interactive,
+            CommandKind::StandardizeGroups
+            | CommandKind::DropGroups
+            | CommandKind::OrganizeObjects
+            | CommandKind::ExportAssets
+            | CommandKind::ExportAll
+            | CommandKind::ExportAssetTbo
+            | CommandKind::ExportAllAssetTbo
+            | CommandKind::DropAllGroups
+            | CommandKind::ImportAssets
+            | CommandKind::TboDownsample
+            | CommandKind::TboFlush
+            | CommandKind::GroupAllObjects
+            | CommandKind::EmbedAllAssets
+            | CommandKind::StopEngine => Lane::Bulk,
+        }
+    }
+
+    pub fn index(self) -> usize {
+        self as usize
+    }
+
+    pub fn name(self) -> &'static str {
+        match self {
+            Lane::Interactive => "interactive",
+            Lane::Bulk => "bulk",
+        }
+    }
+
+    fn ready_bit(self) -> u8 {
+        match self {
+            Lane::Interactive => INTERACTIVE_COMMAND_SERVICES,
+            Lane::Bulk => BULK_COMMAND_SERVICES,
+        }
+    }
+}
+
+/// What a queued command sends. Per-group payloads stay unencoded until the
+/// command thread submits them, so runs of them can be coalesced.
+pub enum CommandBody {
+    Encoded(EngineCommand),
+    /// standardize_groups, drop_groups
+    Uuids(Vec<Uuid>),
+    /// set_surface_types, standardize_synced_groups
+    Surfaces(Vec<GroupSurface>),
+}
+
+impl CommandBody {
+    fn group_count(&self) -> usize {
+        match self {
+            CommandBody::Encoded(_) => 0,
+            CommandBody::Uuids(uuids) => uuids.len(),
+            CommandBody::Surfaces(surfaces) => surfaces.len(),
+        }
+    }
+
+    fn is_mergeable(&self) -> bool {
+        !matches!(self, CommandBody::Encoded(_))
+    }
+
+    /// Appends `other`'s groups, hands it back if the payloads don't match
+    fn merge(&mut self, other: CommandBody) -> Result<(), CommandBody> {
+        match (self, other) {
+            (CommandBody::Uuids(uuids), CommandBody::Uuids(more)) => uuids.extend(more),
+            (CommandBody::Surfaces(surfaces), CommandBody::Surfaces(more)) => surfaces.extend(more),
+            (_, other) => return Err(other),
+        }
+        Ok(())
+    }
+
+    fn encode(self, kind: CommandKind) -> EngineCommand {
+        match (kind, self) {
+            (_, CommandBody::Encoded(cmd)) => cmd,
+            (CommandKind::StandardizeGroups, CommandBody::Uuids(uuids)) => EngineCommand::standardize_groups(&uuids),
+            (CommandKind::DropGroups, CommandBody::Uuids(uuids)) => EngineCommand::drop_groups(&uuids, 1),
+            (CommandKind::SetSurfaceTypes, CommandBody::Surfaces(surfaces)) => {
+                EngineCommand::set_surface_types(&surfaces, 1)
+            }
+            (CommandKind::StandardizeSyncedGroups, CommandBody::Surfaces(surfaces)) => {
+                EngineCommand::standardize_synced_groups(&surfaces, 1)
+            }
+            (kind, _) => unreachable!("{} has no group payload", kind.name()),
+        }
+    }
+}
+
+/// A command and the kind it is queued, timed and routed as. Encoded commands are built with
+/// `command!(builder(args))`, which derives the kind from the builder; the group commands that
+/// can be coalesced have their own constructors here.
+pub struct Command {
+    kind: CommandKind,
+    body: CommandBody,
+}
+
+impl Command {
+    /// Used by `command!`, which pairs every EngineCommand builder with its generated kind
+    #[doc(hidden)]
+    pub fn tagged(kind: CommandKind, cmd: EngineCommand) -> Command {
+        Command { kind, body: CommandBody::Encoded(cmd) }
+    }
+
+    pub fn standardize_groups(uuids: Vec<Uuid>) -> Command {
+        Command { kind: CommandKind::StandardizeGroups, body: CommandBody::Uuids(uuids) }
+    }
+
+    pub fn drop_groups(uuids: Vec<Uuid>) -> Command {
+        Command { kind: CommandKind::DropGroups, body: CommandBody::Uuids(uuids) }
+    }
+
+    pub fn set_surface_types(surfaces: Vec<GroupSurface>) -> Command {
+        Command { kind: CommandKind::SetSurfaceTypes, body: CommandBody::Surfaces(surfaces) }
+    }
+
+    pub fn standardize_synced_groups(surfaces: Vec<GroupSurface>) -> Command {
+        Command { kind: CommandKind::StandardizeSyncedGroups, body: CommandBody::Surfaces(surfaces) }
+    }
+
+    pub fn kind(&self) -> CommandKind {
+        self.kind
+    }
+}
 
 pub struct CommandWork {
-    pub cmd: EngineCommand,
+    pub kind: CommandKind,
+    pub body: CommandBody,
+    /// When the caller queued the command, for the queue wait histogram
+    pub queued_at: Instant,
+    /// SDK-side id tying the command's trace spans together
+    pub request_id: u64,
+    /// Answer with a timeout error instead of waiting past this
+    pub deadline: Option<Instant>,
+    /// Set by the caller to give up on the command
+    pub cancelled: Arc<AtomicBool>,
     // A one-shot channel to send the response back to the caller
-    pub response_tx: channel::Sender<Result<EngineResponse, String>>,
+    pub response_tx: channel::Sender<CommandResult>,
 }
 
+/// Caller side of a submitted command, resolves once the engine responds,
+/// the deadline passes or the command is cancelled
+pub struct CommandHandle {
+    request_id: u64,
+    deadline: Option<Instant>,
+    cancelled: Arc<AtomicBool>,
+    response_rx: channel::Receiver<CommandResult>,
+    /// Response taken off the channel by wait_until
+    received: Option<CommandResult>,
+}
+
+impl CommandHandle {
+    /// Creates the work item for the command thread and the handle that receives its response.
+    /// Without a `timeout` the command waits forever.
+    pub fn new(command: Command, timeout: Option<Duration>) -> (CommandWork, CommandHandle) {
+        let Command { kind, body } = command;
+        let (response_tx, response_rx) = channel::bounded(1);
+        let request_id = trace::next_request_id();
+        let queued_at = Instant::now();
+        let deadline = timeout.map(|timeout| queued_at + timeout);
+        let cancelled = Arc::new(AtomicBool::new(false));
+        (
+            CommandWork {
+                kind,
+                body,
+                queued_at,
+                request_id,
+                deadline,
+                cancelled: cancelled.clone(),
+                response_tx,
+            },
+            CommandHandle {
+                request_id,
+                deadline,
+                cancelled,
+                response_rx,
+                received: None,
+            },
+        )
+    }
+
+    pub fn request_id(&self) -> u64 {
+        self.request_id
+    }
+
+    /// Gives up on the command; the lane thread answers it with an error and stops waiting for the engine
+    pub fn cancel(&self) {
+        self.cancelled.store(true, Ordering::Relaxed);
+    }
+
+    /// Blocks until the response arrives or the deadline has passed
+    pub fn wait(mut self) -> CommandResult {
+        if let Some(result) = self.received.take() {
+            return result;
+        }
+        let Some(deadline) = self.deadline else {
+            return self
+                .response_rx
+                .recv()
+                .map_err(|e| format!("Failed to receive response: {}", e))?;
+        };
+        match self.response_rx.recv_deadline(deadline + CALLER_GRACE) {
+            Ok(result) => result,
+            Err(channel::RecvTimeoutError::Timeout) => {
+                self.cancel();
+                Err("Command timed out, the command thread did not answer".to_string())
+            }
+            Err(e) => Err(format!("Failed to receive response: {}", e)),
+        }
+    }
+
+    /// Waits until `until` at most, returns whether the response is in
+    pub fn wait_until(&mut self, until: Instant) -> bool {
+        if self.received.is_none() {
+            self.received = match self.response_rx.recv_deadline(until) {
+                Ok(result) => Some(result),
+                Err(channel::RecvTimeoutError::Timeout) => None,
+                Err(e) => Some(Err(format!("Failed to receive response: {}", e))),
+            };
+        }
+        self.received.is_some()
+    }
+
+    /// Returns the response if it already arrived, otherwise hands the handle back
+    pub fn try_wait(mut self) -> Result<CommandResult, CommandHandle> {
+        if let Some(result) = self.received.take() {
+            return Ok(result);
+        }
+        match self.response_rx.try_recv() {
+            Ok(result) => Ok(result),
+            Err(channel::TryRecvError::Empty) => Err(self),
+            Err(e) => Ok(Err(format!("Failed to receive response: {}", e))),
+        }
+    }
+
+    pub fn is_ready(&self) -> bool {
+        self.received.is_some() || !self.response_rx.is_empty()
+    }
+
+    /// Blocks until any of `handles` has its response (kept for wait()), returns its index.
+    /// `handles` must not be empty.
+    pub fn select(handles: &mut [CommandHandle]) -> usize {
+        Self::select_until(handles, None).expect("select without a deadline always picks a handle")
+    }
+
+    /// Like select(), but returns None if no response arrived before `until`
+    pub fn select_until(handles: &mut [CommandHandle], until: Option<Instant>) -> Option<usize> {
+        if let Some(i) = handles.iter().position(|handle| handle.received.is_some()) {
+            return Some(i);
+        }
+
+        let mut select = channel::Select::new();
+        for handle in handles.iter() {
+            select.recv(&handle.response_rx);
+        }
+        // Same grace as wait(), past the last deadline the command thread is not answering anymore
+        let give_up = handles
+            .iter()
+            .map(|handle| handle.deadline)
+            .collect::<Option<Vec<_>>>()
+            .and_then(|deadlines| deadlines.into_iter().max())
+            .map(|deadline| deadline + CALLER_GRACE);
+
+        let operation = match (until, give_up) {
+            (Some(until), Some(give_up)) if until < give_up => select.select_deadline(until).ok()?,
+            (Some(until), None) => select.select_deadline(until).ok()?,
+            (_, Some(give_up)) => match select.select_deadline(give_up) {
+                Ok(operation) => operation,
+                Err(_) => {
+                    handles[0].cancel();
+                    handles[0].received = Some(Err("Command timed out, the command thread did not answer".to_string()));
+                    return Some(0);
+                }
+            },
+            (None, None) => select.select(),
+        };
+        let i = operation.index();
+        let result = operation
+            .recv(&handles[i].response_rx)
+            .unwrap_or_else(|e| Err(format!("Failed to receive response: {}", e)));
+        handles[i].received = Some(result);
+        Some(i)
+    }
+}
+
+/// A caller waiting on a request
+struct Waiter {
+    queued_at: Instant,
+    request_id: u64,
+    deadline: Option<Instant>,
+    cancelled: Arc<AtomicBool>,
+    response_tx: channel::Sender<CommandResult>,
+}
+
+impl Waiter {
+    fn answer(self, kind: CommandKind, result: CommandResult) {
+        trace::async_span(kind.name(), self.queued_at, Instant::now(), self.request_id);
+        let _ = self.response_tx.send(result);
+    }
+
+    /// Answers the caller with an error if it cancelled or its deadline passed, otherwise hands it back
+    fn expire(self, kind: CommandKind, now: Instant) -> Option<Waiter> {
+        let stats = STATS.command(kind);
+        if self.cancelled.load(Ordering::Relaxed) {
+            stats.cancelled.fetch_add(1, Ordering::Relaxed);
+            self.answer(kind, Err(format!("{} cancelled", kind.name())));
+            None
+        } else if self.deadline.is_some_and(|deadline| now >= deadline) {
+            stats.timeouts.fetch_add(1, Ordering::Relaxed);
+            let waited = now - self.queued_at;
+            self.answer(kind, Err(format!("{} timed out after {:?}", kind.name(), waited)));
+            None
+        } else {
+            Some(self)
+        }
+    }
+}
+
+/// One engine request, answering every command coalesced into it
+struct Batch {
+    kind: CommandKind,
+    body: CommandBody,
+    waiters: Vec<Waiter>,
+}
+
+impl Batch {
+    fn new(work: CommandWork) -> Batch {
+        Batch {
+            kind: work.kind,
+            body: work.body,
+            waiters: vec![Waiter {
+                queued_at: work.queued_at,
+                request_id: work.request_id,
+                deadline: work.deadline,
+                cancelled: work.cancelled,
+                response_tx: work.response_tx,
+            }],
+        }
+    }
+
+    /// Takes `work` into this request if it is the same group command, hands it back otherwise
+    fn absorb(&mut self, work: CommandWork) -> Result<(), CommandWork> {
+        if work.kind != self.kind {
+            return Err(work);
+        }
+        let CommandWork { kind, body, queued_at, request_id, deadline, cancelled, response_tx } = work;
+        match self.body.merge(body) {
+            Ok(()) => {
+                STATS.command(kind).coalesced.fetch_add(1, Ordering::Relaxed);
+                self.waiters.push(Waiter { queued_at, request_id, deadline, cancelled, response_tx });
+                Ok(())
+            }
+            Err(body) => Err(CommandWork { kind, body, queued_at, request_id, deadline, cancelled, response_tx }),
+        }
+    }
+}
+
+/// Lane queue plus the one command a coalescing run stopped at, which goes next
+struct Intake {
+    rx: channel::Receiver<CommandWork>,
+    held: Option<CommandWork>,
+    /// Coalesced run waiting out its linger window for more of its kind
+    lingering: Option<(Batch, Instant)>,
+}
+
+impl Intake {
+    fn new(rx: channel::Receiver<CommandWork>) -> Intake {
+        Intake { rx, held: None, lingering: None }
+    }
+
+    /// Blocks up to `timeout` for a command, returns whether one is waiting to be picked up
+    fn wait(&mut self, timeout: Duration) -> bool {
+        if self.held.is_none() {
+            self.held = self.rx.recv_timeout(timeout).ok();
+        }
+        self.held.is_some()
+    }
+
+    /// Next request to send: the lingering run once it is full or its window passed, otherwise
+    /// the next queued command merged with the run of its kind queued behind it. None while a
+    /// run still lingers or nothing is queued. `linger` is None with coalescing off.
+    fn next(&mut self, linger: Option<Duration>, now: Instant) -> Option<Batch> {
+        if let Some((mut batch, until)) = self.lingering.take() {
+            if self.fill(&mut batch) || now >= until {
+                return Some(batch);
+            }
+            self.lingering = Some((batch, until));
+            return None;
+        }
+
+        let work = self.held.take().or_else(|| self.rx.try_recv().ok())?;
+        let mut batch = Batch::new(work);
+        let Some(linger) = linger.filter(|_| batch.body.is_mergeable()) else {
+            return Some(batch);
+        };
+        if self.fill(&mut batch) || linger.is_zero() {
+            return Some(batch);
+        }
+        self.lingering = Some((batch, now + linger));
+        None
+    }
+
+    /// Merges the same-kind group commands queued right behind the run, returns whether the run
+    /// is closed: full, or stopped at a command it can't take, which goes next.
+    /// Only adjacent commands are merged, so nothing overtakes a non-mergeable command.
+    fn fill(&mut self, batch: &mut Batch) -> bool {
+        loop {
+            if batch.body.group_count() >= MAX_COALESCED_GROUPS {
+                return true;
+            }
+            let Some(next) = self.held.take().or_else(|| self.rx.try_recv().ok()) else {
+                return false;
+            };
+            if batch.body.group_count() + next.body.group_count() > MAX_COALESCED_GROUPS {
+                self.held = Some(next);
+                return true;
+            }
+            if let Err(next) = batch.absorb(next) {
+                self.held = Some(next);
+                return true;
+            }
+        }
+    }
+
+    /// Whether a command is waiting to be picked up or a run lingers
+    fn has_work(&self) -> bool {
+        self.held.is_some() || self.lingering.is_some() || !self.rx.is_empty()
+    }
+
+    /// Time left in the lingering run's window, None without one
+    fn linger_remaining(&self, now: Instant) -> Option<Duration> {
+        self.lingering.as_ref().map(|(_, until)| until.saturating_duration_since(now))
+    }
+
+    /// Answers the commands of the lingering run, which will never be sent
+    fn shut_down(&mut self) {
+        if let Some((batch, _)) = self.lingering.take() {
+            for waiter in batch.waiters {
+                waiter.answer(batch.kind, Err("Command thread shut down".to_string()));
+            }
+        }
+    }
+}
+
+/// The linger window of coalesced runs, None with coalescing off
+fn coalesce_linger() -> Option<Duration> {
+    COALESCE
+        .load(Ordering::Relaxed)
+        .then(|| Duration::from_micros(COALESCE_LINGER_US.load(Ordering::Relaxed)))
+}
+
+struct InFlight {
+    kind: CommandKind,
+    sent_at: Instant,
+    pending: PendingCommandResponse,
+    waiters: Vec<Waiter>,
+}
+
+impl InFlight {
+    /// Answers cancelled and expired callers, returns false once nobody waits for the response anymore
+    fn expire(&mut self, now: Instant) -> bool {
+        let kind = self.kind;
+        self.waiters = std::mem::take(&mut self.waiters)
+            .into_iter()
+            .filter_map(|waiter| waiter.expire(kind, now))
+            .collect();
+        if self.waiters.is_empty() {
+            // Dropping the pending response abandons the request and frees its slot
+            STATS.request_finished();
+            return false;
+        }
+        true
+    }
+
+    fn finish(&mut self, result: CommandResult) {
+        let stats = STATS.command(self.kind);
+        stats.response.record(self.sent_at.elapsed());
+        if result.is_err() {
+            stats.errors.fetch_add(1, Ordering::Relaxed);
+        }
+        STATS.request_finished();
+        for waiter in std::mem::take(&mut self.waiters) {
+            waiter.answer(self.kind, result.clone());
+        }
+    }
+}
+
+/// Runs one lane: takes its queued commands and keeps up to MAX_IN_FLIGHT of them outstanding
 pub fn spawn_command_thread(
     node: Arc<Node<ipc::Service>>,
+    names: Arc<ServiceNames>,
+    lane: Lane,
     command_rx: channel::Receiver<CommandWork>,
     shutdown: Arc<AtomicBool>,
+    ready: Arc<ReadyLatch>,
+    heartbeat: Arc<LaneHeartbeat>,
 ) -> std::thread::JoinHandle<()> {
     thread::spawn(move || {
+        trace::set_thread_name(&format!("command-{}", lane.name()));
 
-        let (service, notifier) = loop {
+        let open = |command: &str, events: &str| {
             let cmd_service = node
-                .service_builder(&COMMAND_SERVICE_NAME.try_into().unwrap())
+                .service_builder(&command.try_into().unwrap())
                 .request_response::<EngineCommand, EngineResponse>()
                 .open();
 
             let cmd_event_service = node
-                .service_builder(&COMMAND_EVENT_SERVICE_NAME.try_into().unwrap())
+                .service_builder(&events.try_into().unwrap())
                 .event()
                 .open();
 
             match (cmd_service, cmd_event_service) {
-                (Ok(s), Ok(n)) => break (s, n),
-                _ => {
-                    // Engine isn't fully ready yet, or services aren't registered.
-                    // Sleep for a bit and try again.
-                    thread::sleep(Duration::from_millis(500));
-                    println!("Waiting for Engine command services to appear...");
-                }
+                (Ok(s), Ok(n)) => Some((s, n)),
+                _ => None,
             }
         };
 
-        println!("Command service loop active.");
+        let mut discovery = DiscoveryBackoff::new();
+        let (service, notifier) = loop {
+            if shutdown.load(Ordering::Relaxed) {
+                return;
+            }
+
+            // Engines that handle interactive requests on their own worker offer a dedicated service
+            let opened = match lane {
+                Lane::Interactive => open(&names.interactive_command, &names.interactive_command_events)
+                    .or_else(|| open(&names.command, &names.command_events)),
+                Lane::Bulk => open(&names.command, &names.command_events),
+            };
+
+            match opened {
+                Some(services) => break services,
+                // Engine isn't fully ready yet, or services aren't registered. Retry shortly.
+                None => discovery.wait("command"),
+            }
+        };
+
+        println!("Command service loop active ({} lane).", lane.name());
 
         let iox_client = service.client_builder().create().unwrap();
         let cmd_notifier = notifier
@@ -52,32 +696,355 @@ pub fn spawn_command_thread(
             .create()
             .expect("Failed to create Notifier");
 
-        while !shutdown.load(Ordering::Relaxed) {
-            while let Ok(work) = command_rx.recv_timeout(Duration::from_millis(200)) {
-                let result = (|| -> Result<EngineResponse, String> {
-                    let request = iox_client
-                        .loan_uninit()
-                        .map_err(|e| format!("SHM loan failed: {}", e))?;
-                    let pending = request
-                        .write_payload(work.cmd)
-                        .send()
-                        .map_err(|e| format!("Send failed: {}", e))?;
-                    // Notify the engine that a new command is available
-                    cmd_notifier
-                        .notify()
-                        .map_err(|e| format!("Notifier failed: {}", e))?;
-                    loop {
-                        if let Some(res) = pending.receive().map_err(|e| e.to_string())? {
-                            return Ok(res.payload().clone());
-                        }
-                        // Tiny sleep to prevent 100% CPU during the microsecond wait
-                        thread::sleep(std::time::Duration::from_micros(100));
+        // The response event is optional, only engines that publish it can wake us directly.
+        // Engines that don't provide it fall back to adaptive backoff.
+        let response_listener = node
+            .service_builder(&names.response_events.as_str().try_into().unwrap())
+            .event()
+            .open()
+            .ok()
+            .and_then(|service| service.listener_builder().create().ok());
+
+        if response_listener.is_none() {
+            println!("Engine has no response event service, using adaptive backoff.");
+        }
+        ready.mark(lane.ready_bit());
+
+        let submit = |batch: Batch| -> Option<InFlight> {
+            let Batch { kind, body, waiters } = batch;
+            let stats = STATS.command(kind);
+            let picked_up = Instant::now();
+            for waiter in &waiters {
+                stats.queue_wait.record(picked_up - waiter.queued_at);
+            }
+
+            // Commands that expired or were cancelled while queued are never sent
+            let waiters: Vec<Waiter> = waiters
+                .into_iter()
+                .filter_map(|waiter| waiter.expire(kind, picked_up))
+                .collect();
+            if waiters.is_empty() {
+                return None;
+            }
+
+            let result = (|| -> Result<PendingCommandResponse, String> {
+                let request = iox_client
+                    .loan_uninit()
+                    .map_err(|e| format!("SHM loan failed: {}", e))?;
+                let loaned = Instant::now();
+                stats.loan.record(loaned - picked_up);
+
+                let pending = request
+                    .write_payload(body.encode(kind))
+                    .send()
+                    .map_err(|e| format!("Send failed: {}", e))?;
+                // Notify the engine that a new command is available
+                cmd_notifier
+                    .notify()
+                    .map_err(|e| format!("Notifier failed: {}", e))?;
+                stats.send.record(loaned.elapsed());
+                Ok(pending)
+            })();
+
+            match result {
+                Ok(pending) => {
+                    let sent_at = Instant::now();
+                    STATS.request_sent();
+                    for waiter in &waiters {
+                        trace::complete("submit", picked_up, sent_at, waiter.request_id);
+                    }
+                    Some(InFlight {
+                        kind,
+                        sent_at,
+                        pending,
+                        waiters,
+                    })
+                }
+                Err(e) => {
+                    stats.errors.fetch_add(1, Ordering::Relaxed);
+                    for waiter in waiters {
+                        waiter.answer(kind, Err(e.clone()));
                     }
-                })();
+                    None
+                }
+            }
+        };
 
-                let _ = work.response_tx.send(result);
+        let mut intake = Intake::new(command_rx);
+        let mut in_flight: Vec<InFlight> = Vec::with_capacity(MAX_IN_FLIGHT);
+        let mut backoff = Backoff::new();
+
+        while !shutdown.load(Ordering::Relaxed) {
+            // Nothing outstanding, block on the queue so an idle SDK doesn't spin. A lingering
+            // run only waits out its window, then goes out below.
+            if in_flight.is_empty() {
+                let timeout = intake.linger_remaining(Instant::now()).unwrap_or(Duration::from_millis(200));
+                if !intake.wait(timeout) && intake.linger_remaining(Instant::now()).is_none() {
+                    continue;
+                }
+            }
+
+            // Top up the pipeline with whatever else is queued
+            let linger = coalesce_linger();
+            while in_flight.len() < MAX_IN_FLIGHT {
+                match intake.next(linger, Instant::now()) {
+                    Some(batch) => in_flight.extend(submit(batch)),
+                    None => break,
+                }
+            }
+
+            let before = in_flight.len();
+            let mut answered = false;
+            in_flight.retain_mut(|f| match f.pending.receive() {
+                Ok(Some(res)) => {
+                    f.finish(Ok(res.payload().clone()));
+                    answered = true;
+                    false
+                }
+                Ok(None) => true,
+                Err(e) => {
+                    f.finish(Err(e.to_string()));
+                    false
+                }
+            });
+
+            // Give up on requests whose callers all timed out or cancelled, a hung engine
+            // then no longer holds the lane's slots
+            let now = Instant::now();
+            in_flight.retain_mut(|f| f.expire(now));
+
+            if answered {
+                heartbeat.last_response_us.store(LaneHeartbeat::stamp(now), Ordering::Relaxed);
+            }
+            let oldest = in_flight.iter().map(|f| f.sent_at).min();
+            heartbeat
+                .oldest_pending_us
+                .store(oldest.map_or(0, LaneHeartbeat::stamp), Ordering::Relaxed);
+
+            if in_flight.len() < before || in_flight.is_empty() {
+                backoff.reset();
+                continue;
+            }
+
+            match &response_listener {
+                // Sleep until the engine signals a response. Only poll briefly while queued work
+                // could be sent, an idle queue would otherwise wake us every millisecond for nothing.
+                // Responses keep arriving while a run lingers, its window only bounds the wait.
+                Some(listener) => {
+                    let timeout = if in_flight.len() < MAX_IN_FLIGHT && intake.has_work() {
+                        intake.linger_remaining(Instant::now()).map_or(SUBMIT_POLL_TIMEOUT, |left| left.min(SUBMIT_POLL_TIMEOUT))
+                    } else {
+                        RESPONSE_EVENT_TIMEOUT
+                    };
+                    if let Err(e) = listener.timed_wait_all(|_| {}, timeout) {
+                        eprintln!("Response listener failed: {:?}", e);
+                        backoff.snooze();
+                    }
+                }
+                None => backoff.snooze(),
             }
         }
-        println!("Command service loop exiting.");
+
+        for mut f in in_flight {
+            f.finish(Err("Command thread shut down".to_string()));
+        }
+        intake.shut_down();
+        println!("Command service loop exiting ({} lane).", lane.name());
     })
 }
+
+/// Spin -> yield -> park wait strategy for polling responses without a wakeup event.
+/// Short commands are answered while we are still spinning, long ones end up parked and stop burning CPU.
+pub struct Backoff {
+    step: u32,
+}
+
+impl Backoff {
+    const SPIN_STEPS: u32 = 64;
+    const YIELD_STEPS: u32 = 128;
+    const MIN_PARK: Duration = Duration::from_micros(20);
+    const MAX_PARK: Duration = Duration::from_millis(1);
+
+    pub fn new() -> Self {
+        Backoff { step: 0 }
+    }
+
+    pub fn reset(&mut self) {
+        self.step = 0;
+    }
+
+    pub fn snooze(&mut self) {
+        if self.step < Self::SPIN_STEPS {
+            std::hint::spin_loop();
+        } else if self.step < Self::YIELD_STEPS {
+            thread::yield_now();
+        } else {
+            // Double the park time every step past the yield phase, capped at MAX_PARK
+            let shift = (self.step - Self::YIELD_STEPS).min(6);
+            let park = (Self::MIN_PARK * (1 << shift)).min(Self::MAX_PARK);
+            thread::park_timeout(park);
+        }
+        self.step = self.step.saturating_add(1);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    //! Run with `cargo test --no-default-features`. Only the lane intake is covered here,
+    //! sending needs a running engine.
+
+    use super::*;
+    use crate::engine_stats::command;
+
+    const LINGER: Duration = Duration::from_millis(5);
+
+    fn uuids(count: usize) -> Vec<Uuid> {
+        (0..count)
+            .map(|i| {
+                let mut bytes = [0u8; Uuid::SIZE];
+                bytes[..8].copy_from_slice(&(i as u64).to_le_bytes());
+                Uuid { bytes }
+            })
+            .collect()
+    }
+
+    /// Queues `commands` on a fresh lane queue, the handles keep the response channels open
+    fn intake(commands: Vec<Command>) -> (Intake, Vec<CommandHandle>) {
+        let (tx, rx) = channel::unbounded();
+        let handles = commands
+            .into_iter()
+            .map(|command| {
+                let (work, handle) = CommandHandle::new(command, None);
+                tx.send(work).unwrap();
+                handle
+            })
+            .collect();
+        (Intake::new(rx), handles)
+    }
+
+    #[test]
+    fn merges_adjacent_commands_of_one_kind() {
+        let (mut intake, _handles) = intake(vec![
+            Command::drop_groups(uuids(2)),
+            Command::drop_groups(uuids(3)),
+            Command::standardize_groups(uuids(1)),
+            Command::drop_groups(uuids(4)),
+        ]);
+        let now = Instant::now();
+
+        let first = intake.next(Some(Duration::ZERO), now).unwrap();
+        assert_eq!(first.kind, CommandKind::DropGroups);
+        assert_eq!(first.body.group_count(), 5);
+        assert_eq!(first.waiters.len(), 2);
+
+        // The standardize the run stopped at goes next, the later drop doesn't overtake it
+        let second = intake.next(Some(Duration::ZERO), now).unwrap();
+        assert_eq!(second.kind, CommandKind::StandardizeGroups);
+        let third = intake.next(Some(Duration::ZERO), now).unwrap();
+        assert_eq!(third.body.group_count(), 4);
+        assert!(intake.next(Some(Duration::ZERO), now).is_none());
+    }
+
+    #[test]
+    fn never_merges_past_the_group_limit() {
+        let half = MAX_COALESCED_GROUPS / 2;
+        let (mut intake, _handles) = intake(vec![
+            Command::drop_groups(uuids(half)),
+            Command::drop_groups(uuids(half)),
+            Command::drop_groups(uuids(1)),
+        ]);
+        let now = Instant::now();
+
+        let full = intake.next(Some(Duration::ZERO), now).unwrap();
+        assert_eq!(full.body.group_count(), MAX_COALESCED_GROUPS);
+        let rest = intake.next(Some(Duration::ZERO), now).unwrap();
+        assert_eq!(rest.body.group_count(), 1);
+    }
+
+    #[test]
+    fn a_command_over_the_limit_goes_out_alone() {
+        let (mut intake, _handles) = intake(vec![
+            Command::drop_groups(uuids(1)),
+            Command::drop_groups(uuids(MAX_COALESCED_GROUPS)),
+        ]);
+        let now = Instant::now();
+
+        assert_eq!(intake.next(Some(LINGER), now).unwrap().body.group_count(), 1);
+        assert_eq!(intake.next(Some(LINGER), now).unwrap().body.group_count(), MAX_COALESCED_GROUPS);
+    }
+
+    #[test]
+    fn lingering_run_takes_later_commands_until_its_window_closes() {
+        let (tx, rx) = channel::unbounded();
+        let mut intake = Intake::new(rx);
+        let mut handles = Vec::new();
+        let mut queue = |command: Command| {
+            let (work, handle) = CommandHandle::new(command, None);
+            tx.send(work).unwrap();
+            handles.push(handle);
+        };
+        let start = Instant::now();
+
+        queue(Command::drop_groups(uuids(1)));
+        assert!(intake.next(Some(LINGER), start).is_none());
+        assert!(intake.has_work());
+        assert_eq!(intake.linger_remaining(start), Some(LINGER));
+
+        queue(Command::drop_groups(uuids(2)));
+        assert!(intake.next(Some(LINGER), start).is_none());
+
+        let batch = intake.next(Some(LINGER), start + LINGER).unwrap();
+        assert_eq!(batch.body.group_count(), 3);
+        assert_eq!(batch.waiters.len(), 2);
+        assert!(!intake.has_work());
+    }
+
+    #[test]
+    fn lingering_run_closes_at_a_command_of_another_kind() {
+        let (mut intake, _handles) = intake(vec![
+            Command::set_surface_types(Vec::new()),
+            Command::drop_groups(uuids(1)),
+        ]);
+        let now = Instant::now();
+
+        let batch = intake.next(Some(LINGER), now).unwrap();
+        assert_eq!(batch.kind, CommandKind::SetSurfaceTypes);
+        assert!(intake.linger_remaining(now).is_none());
+        assert_eq!(intake.next(None, now).unwrap().kind, CommandKind::DropGroups);
+    }
+
+    #[test]
+    fn nothing_is_merged_with_coalescing_off_or_across_encoded_commands() {
+        let (mut intake, _handles) = intake(vec![
+            Command::drop_groups(uuids(1)),
+            Command::drop_groups(uuids(1)),
+            command!(drop_all_groups()),
+            command!(drop_all_groups()),
+        ]);
+        let now = Instant::now();
+
+        assert_eq!(intake.next(None, now).unwrap().waiters.len(), 1);
+        assert_eq!(intake.next(None, now).unwrap().waiters.len(), 1);
+        assert_eq!(intake.next(Some(LINGER), now).unwrap().waiters.len(), 1);
+        assert_eq!(intake.next(Some(LINGER), now).unwrap().waiters.len(), 1);
+        assert!(intake.next(Some(LINGER), now).is_none());
+    }
+
+    #[test]
+    fn wait_hands_a_command_to_the_lingering_run() {
+        let (tx, rx) = channel::unbounded();
+        let mut intake = Intake::new(rx);
+        let (first, _first) = CommandHandle::new(Command::standardize_groups(uuids(1)), None);
+        let (second, _second) = CommandHandle::new(Command::standardize_groups(uuids(1)), None);
+        let now = Instant::now();
+
+        tx.send(first).unwrap();
+        assert!(intake.next(Some(LINGER), now).is_none());
+        assert!(!intake.wait(Duration::ZERO));
+        tx.send(second).unwrap();
+        assert!(intake.wait(Duration::ZERO));
+
+        assert!(intake.next(Some(LINGER), now).is_none());
+        assert_eq!(intake.next(Some(LINGER), now + LINGER).unwrap().waiters.len(), 2);
+    }
+}
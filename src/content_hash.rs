@@ -0,0 +1,116 @@
+//! Per-asset content hashes for incremental sends.
+//!
+//! Python hashes each asset's source arrays with `content_hash()` and passes
+//! the hashes to `prepare_mesh_send`. Assets whose hash matches the one last
+//! sent for that UUID are left out of the alloc_request, so no slab space is
+//! claimed for them and the engine keeps the copy it already has. The hash
+//! only has to notice edits, not resist adversaries, so it is four independent
+//! multiply-rotate lanes over 32-byte blocks that the compiler vectorizes and
+//! that keep up with memory bandwidth.
+
+use pivot_com_types::fields::Uuid;
+use std::collections::HashMap;
+use std::sync::RwLock;
+
+const LANES: usize = 4;
+const BLOCK: usize = LANES * 8;
+const PRIME: u64 = 0x9E37_79B9_7F4A_7C15;
+const SEEDS: [u64; LANES] = [
+    0x243F_6A88_85A3_08D3,
+    0x1319_8A2E_0370_7344,
+    0xA409_3822_299F_31D0,
+    0x082E_FA98_EC4E_6C89,
+];
+
+struct LaneHasher {
+    lanes: [u64; LANES],
+}
+
+impl LaneHasher {
+    fn new() -> Self {
+        LaneHasher { lanes: SEEDS }
+    }
+
+    fn mix_block(&mut self, block: &[u8]) {
+        for (lane, word) in self.lanes.iter_mut().zip(block.chunks_exact(8)) {
+            let word = u64::from_le_bytes(word.try_into().unwrap());
+            *lane = (*lane ^ word).wrapping_mul(PRIME).rotate_left(31);
+        }
+    }
+
+    /// Feeds one field, its length goes in too so bytes can't move between fields unnoticed
+    fn write(&mut self, bytes: &[u8]) {
+        let mut blocks = bytes.chunks_exact(BLOCK);
+        for block in &mut blocks {
+            self.mix_block(block);
+        }
+
+        let rest = blocks.remainder();
+        let mut tail = [0u8; BLOCK];
+        tail[..rest.len()].copy_from_slice(rest);
+        tail[BLOCK - 8..].copy_from_slice(&(bytes.len() as u64).to_le_bytes());
+        self.mix_block(&tail);
+    }
+
+    fn finish(&self) -> u64 {
+        let mut h = self.lanes.iter().fold(0u64, |h, &lane| (h ^ lane).wrapping_mul(PRIME).rotate_left(27));
+        // fmix64 from MurmurHash3, spreads the last lane's bits over the whole word
+        h ^= h >> 33;
+        h = h.wrapping_mul(0xFF51_AFD7_ED55_8CCD);
+        h ^= h >> 33;
+        h = h.wrapping_mul(0xC4CE_B9FE_1A85_EC53);
+        h ^ (h >> 33)
+    }
+}
+
+/// Content hash of one asset given as its fields, order and field boundaries both count
+pub fn hash_fields(fields: &[&[u8]]) -> u64 {
+    let mut hasher = LaneHasher::new();
+    for field in fields {
+        hasher.write(field);
+    }
+    hasher.finish()
+}
+
+/// Hash of the content last sent for every UUID
+#[derive(Debug, Default)]
+pub struct ContentHashes {
+    hashes: RwLock<HashMap<Uuid, u64>>,
+}
+
+impl ContentHashes {
+    pub fn new() -> Self {
+        ContentHashes::default()
+    }
+
+    /// Indices of the assets whose hash differs from the one on record
+    pub fn changed(&self, uuids: &[Uuid], hashes: &[u64]) -> Vec<usize> {
+        let known = self.hashes.read().unwrap();
+        (0..uuids.len())
+            .filter(|&i| known.get(&uuids[i]) != Some(&hashes[i]))
+            .collect()
+    }
+
+    pub fn record(&self, entries: impl Iterator<Item = (Uuid, u64)>) {
+        self.hashes.write().unwrap().extend(entries);
+    }
+
+    /// Whether any hash is on record, so callers can skip collecting UUIDs to forget
+    pub fn has_entries(&self) -> bool {
+        !self.hashes.read().unwrap().is_empty()
+    }
+
+    /// Forgets the hashes of `uuids` so they are sent again, `None` forgets every asset
+    pub fn forget(&self, uuids: Option<&[Uuid]>) {
+        let mut hashes = self.hashes.write().unwrap();
+        match uuids {
+            Some(uuids) if !hashes.is_empty() => {
+                for uuid in uuids {
+                    hashes.remove(uuid);
+                }
+            }
+            Some(_) => {}
+            None => hashes.clear(),
+        }
+    }
+}
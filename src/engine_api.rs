@@ -1,4 +1,3 @@
-use pivot_com_types::EngineCommand;
 use pivot_com_types::EngineResponse;
 use pivot_com_types::asset_meta::AssetMeta;
 use pivot_com_types::asset_ptr::AssetPtr;
@@ -6,28 +5,70 @@ use pivot_com_types::asset_surface::GroupSurface;
 use pivot_com_types::fields::Uuid;
 
 use crate::asset_sync_context::AssetSyncContext;
-use crate::engine_client::EngineClient;
+use crate::command_thread::{self, Command, CommandHandle};
+use crate::content_hash::ContentHashes;
+use crate::engine_client::EngineHealth;
+use crate::engine_stats::{STATS, command};
+use crate::parallel;
+use crate::shards::{ShardHandles, ShardedClient};
+use crate::slab_options::SlabMapOptions;
+use crate::slab_table::{ReclaimStats, SlabPin};
+use std::borrow::Cow;
 use std::collections::HashMap;
 use std::env;
 use std::fs;
-use std::iter::zip;
 use std::os::unix::fs::PermissionsExt;
+use std::ops::Range;
 use std::path::PathBuf;
+use std::ptr::NonNull;
+use std::sync::atomic::{AtomicBool, Ordering};
 use std::sync::{LazyLock, Mutex};
+use std::time::Duration;
 use uuid::Uuid as ExternalUuid;
 
-pub static CLIENT: LazyLock<EngineClient> = LazyLock::new(|| EngineClient::new());
+pub static CLIENT: LazyLock<ShardedClient> = LazyLock::new(|| ShardedClient::new());
 pub static ENGINE_DIR: LazyLock<Mutex<Option<PathBuf>>> = LazyLock::new(|| Mutex::new(None));
-
-pub fn start_engine() -> Result<(), String> {
+static PREFAULT_ALLOCATIONS: AtomicBool = AtomicBool::new(false);
+/// Content hash of what the engines last received per asset, for prepare_mesh_send(content_hashes=...)
+static CONTENT_HASHES: LazyLock<ContentHashes> = LazyLock::new(ContentHashes::new);
+/// Whether the engines decode the experimental ENCODING_* bits of tbo_config, see set_engine_capabilities
+static TBO_ENCODINGS: AtomicBool = AtomicBool::new(false);
+
+/// Optional engine features that have to be declared before the SDK sends anything that needs them
+pub const ENGINE_CAPABILITIES: &[&str] = &["experimental_tbo_encodings"];
+
+/// Spawns `shards` engines, with `wait` set blocks until their services are live or the timeout passes
+pub fn start_engine(
+    wait: Option<Duration>,
+    instance: Option<String>,
+    persistent: bool,
+    shards: usize,
+) -> Result<(), String> {
     let engine_path = resolve_engine_binary_path()
         .ok_or_else(|| "Failed to locate pivot_engine binary".to_string())?;
-    CLIENT.start(engine_path.to_string_lossy().to_string())?;
+    CONTENT_HASHES.forget(None);
+    CLIENT.start(engine_path.to_string_lossy().to_string(), wait, instance, persistent, shards)?;
     Ok(())
 }
 
+/// Connects to already running engines instead of spawning them
+pub fn attach_engine(instance: Option<String>, timeout: Duration, shards: usize) -> Result<(), String> {
+    // An attached engine may hold anything, send everything once before skipping
+    CONTENT_HASHES.forget(None);
+    CLIENT.attach(instance, timeout, shards)
+}
+
+pub fn shard_count() -> usize {
+    CLIENT.shard_count()
+}
+
+pub fn is_engine_ready() -> bool {
+    CLIENT.is_ready()
+}
+
 pub fn stop_engine() -> Result<(), String> {
     CLIENT.stop()?;
+    CONTENT_HASHES.forget(None);
     Ok(())
 }
 
@@ -45,182 +86,767 @@ pub fn generate_uuid_bytes() -> [u8; Uuid::SIZE] {
 }
 
 pub fn poll_mesh_sync() -> Result<Option<AssetSyncContext>, String> {
-    let mp = match CLIENT.poll_mesh_sync() {
-        Ok(Some(mp)) => mp,
+    let (shard, mp) = match CLIENT.poll_mesh_sync() {
+        Ok(Some(publish)) => publish,
         Ok(None) => return Ok(None),
         Err(e) => return Err(e),
     };
 
     let asset_ptrs = mp.read_send_mesh()
         .map_err(|e| format!("Buffer read error: {}", e))?;
-    let ptrs = CLIENT.hydrate_ptrs(asset_ptrs, &mp.header.root_slab_handle)?;
+    let pin = SlabPin::new();
+    let ptrs = CLIENT.shard(shard).hydrate_ptrs(asset_ptrs, &mp.header.root_slab_handle)?;
+    note_published(shard, &ptrs);
+
+    let asset_shards = vec![shard as u16; ptrs.len()];
+    Ok(Some(AssetSyncContext::new(ptrs, asset_ptrs, asset_shards, pin)))
+}
+
+/// Drains every queued publish and hydrates them into a single merged context.
+/// If one publish can't be read or hydrated its error is returned and every other drained
+/// publish goes back to the queue for the next poll, only the broken one is lost.
+pub fn poll_mesh_sync_all() -> Result<Option<AssetSyncContext>, String> {
+    let mut publishes = CLIENT.drain_mesh_sync();
+    if publishes.is_empty() {
+        return Ok(None);
+    }
+
+    let pin = SlabPin::new();
+    let mut ptrs = Vec::new();
+    let mut asset_ptrs = Vec::new();
+    let mut asset_shards = Vec::new();
+
+    let mut failed = None;
+
+    for (i, (shard, mp)) in publishes.iter().enumerate() {
+        let hydrated = mp
+            .read_send_mesh()
+            .map_err(|e| format!("Buffer read error: {}", e))
+            .and_then(|publish_ptrs| {
+                let meta_ptrs = CLIENT.shard(*shard).hydrate_ptrs(publish_ptrs, &mp.header.root_slab_handle)?;
+                Ok((publish_ptrs, meta_ptrs))
+            });
+        let (publish_ptrs, publish_meta_ptrs) = match hydrated {
+            Ok(hydrated) => hydrated,
+            Err(e) => {
+                failed = Some((i, e));
+                break;
+            }
+        };
+        note_published(*shard, &publish_meta_ptrs);
+        ptrs.extend(publish_meta_ptrs);
+        asset_ptrs.extend_from_slice(publish_ptrs);
+        asset_shards.extend(std::iter::repeat_n(*shard as u16, publish_ptrs.len()));
+    }
+
+    if let Some((i, e)) = failed {
+        publishes.remove(i);
+        CLIENT.requeue_mesh_sync(publishes);
+        return Err(e);
+    }
+
+    Ok(Some(AssetSyncContext::new(ptrs, &asset_ptrs, asset_shards, pin)))
+}
+
+/// Remembers which shard published these groups, only needed (and paid for) with several shards.
+/// The engine changed them, so their content hashes no longer describe its copy either.
+fn note_published(shard: usize, ptrs: &[NonNull<AssetMeta>]) {
+    if CLIENT.shard_count() > 1 || CONTENT_HASHES.has_entries() {
+        let uuids: Vec<Uuid> = ptrs.iter().map(|ptr| unsafe { ptr.as_ref().uuid }).collect();
+        CLIENT.note_placement(shard, uuids.iter().copied());
+        CONTENT_HASHES.forget(Some(&uuids));
+    }
+}
+
+/// Number of engine slabs currently mapped into this process
+pub fn mapped_slab_count() -> usize {
+    CLIENT.mapped_slab_count()
+}
+
+/// Number of slabs the engines have registered, grows as soon as an engine adds one
+/// while mapped_slab_count only catches up on the next hydration
+pub fn registered_slab_count() -> usize {
+    CLIENT.registered_slab_count()
+}
+
+/// (command queue, mesh update queue) lengths
+pub fn queue_lengths() -> (usize, usize) {
+    CLIENT.queue_lengths()
+}
+
+pub fn set_mesh_queue_capacity(capacity: usize) {
+    CLIENT.set_mesh_queue_capacity(capacity);
+}
+
+#[cfg(unix)]
+pub fn mesh_sync_fd() -> i32 {
+    CLIENT.mesh_sync_fd()
+}
+
+/// Per-asset inputs for an allocation. Borrowed so Python buffers can be read in place.
+pub struct MeshSendInput<'a> {
+    pub vert_counts: &'a [u32],
+    pub edge_counts: &'a [u32],
+    pub loop_counts: &'a [u32],
+    pub total_loop_lengths: &'a [u32],
+    pub object_counts: &'a [u32],
+    pub group_names: GroupNames<'a>,
+    pub surface_contexts: &'a [u16],
+    pub asset_uuids: &'a [Uuid],
+}
+
+/// Group names either as individual strings or packed into one buffer with offsets (len + 1 entries)
+pub enum GroupNames<'a> {
+    List(&'a [String]),
+    Packed { bytes: &'a [u8], offsets: &'a [u32] },
+}
+
+impl<'a> GroupNames<'a> {
+    fn len(&self) -> usize {
+        match self {
+            GroupNames::List(names) => names.len(),
+            GroupNames::Packed { offsets, .. } => offsets.len().saturating_sub(1),
+        }
+    }
+
+    fn get(&self, i: usize) -> Result<&'a str, String> {
+        match self {
+            GroupNames::List(names) => Ok(names[i].as_str()),
+            GroupNames::Packed { bytes, offsets } => {
+                let (start, end) = (offsets[i] as usize, offsets[i + 1] as usize);
+                let name = bytes
+                    .get(start..end)
+                    .ok_or_else(|| format!("Group name {} range {}..{} is out of bounds", i, start, end))?;
+                std::str::from_utf8(name).map_err(|e| format!("Group name {} is not UTF-8: {}", i, e))
+            }
+        }
+    }
+}
 
-    Ok(Some(AssetSyncContext::new(ptrs, asset_ptrs)))
+impl<'a> MeshSendInput<'a> {
+    pub fn validate(&self) -> Result<usize, String> {
+        let count = self.asset_uuids.len();
+        let lengths = [
+            ("vert_counts", self.vert_counts.len()),
+            ("edge_counts", self.edge_counts.len()),
+            ("loop_counts", self.loop_counts.len()),
+            ("total_loop_lengths", self.total_loop_lengths.len()),
+            ("object_counts", self.object_counts.len()),
+            ("group_names", self.group_names.len()),
+            ("surface_contexts", self.surface_contexts.len()),
+        ];
+
+        for (name, len) in lengths {
+            if len != count {
+                return Err(format!("{} has {} entries, expected {}", name, len, count));
+            }
+        }
+        Ok(count)
+    }
 }
 
 /// Requests memory for the provided asset metadata and writes the group names and asset metas into the correct places
-pub fn allocate_memory(
-    vert_counts: Vec<u32>,
-    edge_counts: Vec<u32>,
-    loop_counts: Vec<u32>,
-    total_loop_lengths: Vec<u32>,
-    object_counts: Vec<u32>,
-    group_names: Vec<String>,
-    surface_contexts: Vec<u16>,
-    asset_uuids: Vec<Uuid>,
-) -> Result<AssetSyncContext, String> {
-    let count = asset_uuids.len();
-
-    let mut sizes = Vec::with_capacity(count);
-    let mut asset_metas = Vec::with_capacity(count);
+pub fn allocate_memory(input: &MeshSendInput) -> Result<AssetSyncContext, String> {
+    let count = input.validate()?;
+    let chunk = submit_alloc_chunk(input, 0..count)?;
+    complete_alloc_chunk(input, chunk)
+}
+
+/// Like allocate_memory, but leaves out every asset whose content hash matches the one last sent
+/// for its UUID. Nothing is allocated for those, the engine keeps its copy. The context only
+/// holds the changed assets, in input order, and records their hashes once it is sent; with
+/// none changed no engine is contacted at all.
+pub fn allocate_changed(input: &MeshSendInput, hashes: &[u64]) -> Result<AssetSyncContext, String> {
+    let count = input.validate()?;
+    if hashes.len() != count {
+        return Err(format!("content_hashes has {} entries, expected {}", hashes.len(), count));
+    }
+
+    let changed = CONTENT_HASHES.changed(input.asset_uuids, hashes);
+    STATS
+        .unchanged_skipped
+        .fetch_add((count - changed.len()) as u64, Ordering::Relaxed);
+    // Every engine already has every asset, skip the alloc and send round-trips entirely
+    if changed.is_empty() {
+        return Ok(AssetSyncContext::empty());
+    }
 
+    let uuids = pick(input.asset_uuids, &changed);
+    let chunk = submit_alloc_positions(input, &uuids, |j| changed[j])?;
+    let mut context = complete_alloc_chunk(input, chunk)?;
+    context.set_content_hashes(pick(hashes, &changed).into_owned());
+    Ok(context)
+}
+
+/// An alloc_request for a contiguous range of a MeshSendInput, submitted but not yet answered.
+/// Holds one sub-request per shard owning any of the range's groups.
+pub struct AllocChunk {
+    len: usize,
+    parts: Vec<AllocPart>,
+}
+
+/// The assets of a chunk that live on one shard
+struct AllocPart {
+    shard: usize,
+    /// Input index of every asset in the part, ascending
+    indices: Vec<usize>,
+    /// Position of every asset within the chunk
+    positions: Vec<usize>,
+    asset_metas: Vec<AssetMeta>,
+    sizes: Vec<usize>,
+    handle: CommandHandle,
+}
+
+impl AllocChunk {
+    pub fn len(&self) -> usize {
+        self.len
+    }
+}
+
+/// Lays out the assets in `range` and submits their alloc_requests without waiting for them.
+/// The input must already be validated.
+pub fn submit_alloc_chunk(input: &MeshSendInput, range: Range<usize>) -> Result<AllocChunk, String> {
+    let start = range.start;
+    submit_alloc_positions(input, &input.asset_uuids[range], |j| start + j)
+}
+
+/// Submits the assets `uuids` name, asset j of the chunk being input asset `index_of(j)`
+fn submit_alloc_positions<F>(input: &MeshSendInput, uuids: &[Uuid], index_of: F) -> Result<AllocChunk, String>
+where
+    F: Fn(usize) -> usize,
+{
+    let by_shard = CLIENT.partition(uuids);
+
+    let mut parts = Vec::new();
+    for (shard, positions) in by_shard.into_iter().enumerate() {
+        if positions.is_empty() {
+            continue;
+        }
+        let indices: Vec<usize> = positions.iter().map(|&j| index_of(j)).collect();
+        CLIENT.note_placement(shard, positions.iter().map(|&j| uuids[j]));
+        parts.push(submit_alloc_part(input, shard, indices, positions)?);
+    }
+
+    Ok(AllocChunk { len: uuids.len(), parts })
+}
+
+fn submit_alloc_part(
+    input: &MeshSendInput,
+    shard: usize,
+    indices: Vec<usize>,
+    positions: Vec<usize>,
+) -> Result<AllocPart, String> {
     // Calculate the asset meta (offsets) and accumulate them to request memory from engine
-    for i in 0..count as usize {
-        let (group_metadata, total_size) = AssetMeta::new(
-            vert_counts[i],
-            edge_counts[i],
-            loop_counts[i],
-            total_loop_lengths[i],
-            object_counts[i],
-            surface_contexts[i],
-            &group_names[i],
-            asset_uuids[i],
-        )?;
-
-        asset_metas.push(group_metadata);
-        sizes.push(total_size);
+    let layouts = parallel::map_ranges(indices.len(), |local| {
+        local
+            .map(|j| {
+                let i = indices[j];
+                AssetMeta::new(
+                    input.vert_counts[i],
+                    input.edge_counts[i],
+                    input.loop_counts[i],
+                    input.total_loop_lengths[i],
+                    input.object_counts[i],
+                    input.surface_contexts[i],
+                    input.group_names.get(i)?,
+                    input.asset_uuids[i],
+                )
+            })
+            .collect()
+    })?;
+    let (asset_metas, sizes): (Vec<_>, Vec<_>) = layouts.into_iter().unzip();
+
+    let uuids: Vec<Uuid> = indices.iter().map(|&i| input.asset_uuids[i]).collect();
+    let handle = CLIENT.shard(shard).submit_command(command!(alloc_request(&uuids, &sizes)))?;
+
+    Ok(AllocPart {
+        shard,
+        indices,
+        positions,
+        asset_metas,
+        sizes: sizes.iter().map(|&size| size as usize).collect(),
+        handle,
+    })
+}
+
+/// Waits for a chunk's allocations and writes its metas and group names into the returned memory
+pub fn complete_alloc_chunk(input: &MeshSendInput, chunk: AllocChunk) -> Result<AssetSyncContext, String> {
+    let AllocChunk { len, parts } = chunk;
+
+    // A single shard needs no reordering
+    if parts.len() == 1 {
+        let part = parts.into_iter().next().unwrap();
+        return complete_alloc_part(input, part).map(|(_, context)| context);
+    }
+
+    let mut contexts = Vec::with_capacity(parts.len());
+    for part in parts {
+        contexts.push(complete_alloc_part(input, part)?);
     }
+    Ok(AssetSyncContext::interleave(contexts, len))
+}
+
+/// Waits for a chunk nobody is going to fill and sends its allocations back as empty assets,
+/// so the engine reclaims the space instead of holding it for a send that never comes
+pub fn release_alloc_chunk(input: &MeshSendInput, chunk: AllocChunk) -> Result<(), String> {
+    for mut part in chunk.parts {
+        // An empty asset's layout fits in the allocation made for the full one
+        part.asset_metas = part
+            .indices
+            .iter()
+            .map(|&i| {
+                let group_name = input.group_names.get(i)?;
+                AssetMeta::new(0, 0, 0, 0, 0, input.surface_contexts[i], group_name, input.asset_uuids[i])
+                    .map(|(meta, _)| meta)
+            })
+            .collect::<Result<_, String>>()?;
+
+        let (_, mut context) = complete_alloc_part(input, part)?;
+        context.send_all()?;
+    }
+    Ok(())
+}
 
-    let command = EngineCommand::alloc_request(&asset_uuids, &sizes);
-    let resp = CLIENT.send_command(command)?;
+fn complete_alloc_part(input: &MeshSendInput, part: AllocPart) -> Result<(Vec<usize>, AssetSyncContext), String> {
+    let AllocPart { shard, indices, positions, asset_metas, sizes, handle } = part;
+    let count = asset_metas.len();
+    let resp = handle.wait()?;
 
     let (_uuids, asset_ptrs) = resp
         .read_alloc_response()
         .map_err(|e| format!("Buffer read error: {}", e))?;
 
-    let ptrs = CLIENT.hydrate_ptrs(asset_ptrs, &resp.header.root_slab_handle)?;
+    let pin = SlabPin::new();
+    let ptrs = CLIENT.shard(shard).hydrate_ptrs(asset_ptrs, &resp.header.root_slab_handle)?;
 
-    // Write group names and meta datas into the provided memory
-    for ((ptr, asset_meta), group_name) in zip(&ptrs, asset_metas).zip(group_names) {
-        unsafe {
-            let raw_ptr = ptr.as_ptr();
-            let base_bytes = raw_ptr as *mut u8;
-            let name_dest = base_bytes.add(asset_meta.offset_group_name as usize);
-            std::ptr::write_unaligned(raw_ptr, asset_meta);
-            std::ptr::copy_nonoverlapping(group_name.as_ptr(), name_dest, group_name.len());
-        };
+    if ptrs.len() != count {
+        return Err(format!("Engine allocated {} assets, requested {}", ptrs.len(), count));
+    }
+
+    // Write group names and meta datas into the provided memory, every asset owns a disjoint region
+    let regions = AssetRegions(&ptrs);
+    let prefault = PREFAULT_ALLOCATIONS.load(Ordering::Relaxed);
+    parallel::for_each_range(count, |range| {
+        for j in range {
+            let group_name = input.group_names.get(indices[j])?;
+            let asset_meta = &asset_metas[j];
+            unsafe {
+                let raw_ptr = regions.get(j);
+                let base_bytes = raw_ptr as *mut u8;
+                if prefault {
+                    prefault_region(base_bytes, sizes[j]);
+                }
+                let name_dest = base_bytes.add(asset_meta.offset_group_name as usize);
+                std::ptr::copy_nonoverlapping(
+                    asset_meta as *const AssetMeta as *const u8,
+                    base_bytes,
+                    std::mem::size_of::<AssetMeta>(),
+                );
+                std::ptr::copy_nonoverlapping(group_name.as_ptr(), name_dest, group_name.len());
+            };
+        }
+        Ok(())
+    })?;
+    let asset_shards = vec![shard as u16; count];
+    Ok((positions, AssetSyncContext::new(ptrs, asset_ptrs, asset_shards, pin)))
+}
+
+/// Destination pointers shared with the write workers
+struct AssetRegions<'a>(&'a [NonNull<AssetMeta>]);
+
+// Each worker only writes to the regions of its own index range
+unsafe impl Sync for AssetRegions<'_> {}
+
+impl AssetRegions<'_> {
+    fn get(&self, i: usize) -> *mut AssetMeta {
+        self.0[i].as_ptr()
+    }
+}
+
+/// Page size of this system, the stride prefaulting touches regions with
+static PAGE_SIZE: LazyLock<usize> = LazyLock::new(|| unsafe { libc::sysconf(libc::_SC_PAGESIZE) }.max(1) as usize);
+
+/// Touches every page of a freshly allocated region so the page faults happen here instead of in the Python fill
+unsafe fn prefault_region(base: *mut u8, len: usize) {
+    if len == 0 {
+        return;
+    }
+    let touch = |offset: usize| unsafe {
+        let byte = base.add(offset);
+        std::ptr::write_volatile(byte, std::ptr::read_volatile(byte));
+    };
+    let page = *PAGE_SIZE;
+    let mut offset = 0;
+    while offset < len {
+        touch(offset);
+        offset += page;
+    }
+    // The region needn't start on a page boundary, so its last byte can sit on a page the stride skipped
+    touch(len - 1);
+}
+
+/// Fault in the pages of every new allocation while its metadata is written
+pub fn set_prefault_allocations(enabled: bool) {
+    PREFAULT_ALLOCATIONS.store(enabled, Ordering::Relaxed);
+}
+
+/// Sends the assets back to the shards they were allocated or published on
+pub fn send_mesh_command(asset_ptrs: Vec<AssetPtr>, asset_shards: &[u16]) -> Result<(), String> {
+    let shard_count = CLIENT.shard_count();
+    if shard_count == 1 {
+        return CLIENT.shard(0).send_command(command!(send_mesh(&asset_ptrs))).map(|_| ());
+    }
+
+    let mut by_shard: Vec<Vec<AssetPtr>> = vec![Vec::new(); shard_count];
+    for (asset_ptr, &shard) in asset_ptrs.iter().zip(asset_shards) {
+        by_shard
+            .get_mut(shard as usize)
+            .ok_or("Engine shards changed since these assets were allocated")?
+            .push(asset_ptr.clone());
+    }
+    CLIENT
+        .submit_each(|shard| {
+            let part = &by_shard[shard];
+            (!part.is_empty()).then(|| command!(send_mesh(part)))
+        })?
+        .wait()
+        .map(|_| ())
+}
+
+/// Remembers what the engines received for `uuids`, the next prepare with matching hashes skips them
+pub fn record_content_hashes(uuids: &[Uuid], hashes: &[u64]) {
+    CONTENT_HASHES.record(uuids.iter().copied().zip(hashes.iter().copied()));
+}
+
+/// The next prepare with content hashes allocates these assets again, `None` every asset
+pub fn forget_content_hashes(uuids: Option<&[Uuid]>) {
+    CONTENT_HASHES.forget(uuids);
+}
+
+/// Splits `uuids` by owning shard and submits `command(shard, indices)` to every shard owning any of them,
+/// groups with no known owner go to every shard. With a single shard the command is always sent,
+/// even for an empty list.
+fn submit_routed<F>(uuids: &[Uuid], command: F) -> Result<ShardHandles, String>
+where
+    F: Fn(usize, &[usize]) -> Command,
+{
+    let by_shard = CLIENT.partition_known(uuids);
+    let single = by_shard.len() == 1;
+    CLIENT.submit_each(|shard| {
+        let part = &by_shard[shard];
+        (single || !part.is_empty()).then(|| command(shard, part))
+    })
+}
+
+/// The entries of `items` at `indices`, borrowed when that is all of them
+fn pick<'a, T: Clone>(items: &'a [T], indices: &[usize]) -> Cow<'a, [T]> {
+    if indices.len() == items.len() {
+        // Partitions are ascending, so a full one is the identity
+        Cow::Borrowed(items)
+    } else {
+        Cow::Owned(indices.iter().map(|&i| items[i].clone()).collect())
+    }
+}
+
+/// Output directory of one shard, its own subdirectory once there are several so file names never collide
+fn shard_dir(path: &str, shard: usize) -> PathBuf {
+    match CLIENT.shard_count() {
+        1 => PathBuf::from(path),
+        _ => PathBuf::from(path).join(format!("shard-{}", shard)),
+    }
+}
+
+/// shard_dir, with the shard subdirectories created if missing
+fn shard_path(path: &str, shard: usize) -> Result<String, String> {
+    if CLIENT.shard_count() == 1 {
+        return Ok(path.to_string());
+    }
+    let dir = shard_dir(path, shard);
+    fs::create_dir_all(&dir).map_err(|e| format!("Failed to create {}: {}", dir.display(), e))?;
+    Ok(dir.to_string_lossy().to_string())
+}
+
+/// Output directories of every shard, in shard order
+fn shard_paths(path: &str) -> Result<Vec<String>, String> {
+    (0..CLIENT.shard_count()).map(|shard| shard_path(path, shard)).collect()
+}
+
+/// Output directories of every shard, created if missing, for watching a flush or export
+pub fn tbo_output_dirs(path: &str) -> Result<Vec<PathBuf>, String> {
+    Ok(shard_paths(path)?.into_iter().map(PathBuf::from).collect())
+}
+
+/// Where a file `shard` reported for a flush or export below `path` is on disk: looked up
+/// as reported, then in that shard's output directory. None if it can't be found.
+pub fn locate_written_file(path: &str, shard: usize, name: &str) -> Option<PathBuf> {
+    [PathBuf::from(name), shard_dir(path, shard).join(name)]
+        .into_iter()
+        .find(|candidate| fs::metadata(candidate).is_ok_and(|meta| meta.is_file()))
+}
+
+/// Size of a file `shard` wrote below `path`, None if it can't be found
+pub fn written_file_size(path: &str, shard: usize, name: &str) -> Option<u64> {
+    let file = locate_written_file(path, shard, name)?;
+    fs::metadata(file).ok().map(|meta| meta.len())
+}
+
+/// Total meshes accumulated over the tbo_downsample responses of every shard
+pub fn merge_tbo_downsample(responses: &[EngineResponse]) -> u32 {
+    responses.iter().map(|resp| resp.read_tbo_downsample()).sum()
+}
+
+/// Files written by every shard's tbo_flush / export_all_asset_tbo, in shard order
+pub fn merge_tbo_flush(responses: &[EngineResponse]) -> Result<Vec<String>, String> {
+    let mut files = Vec::new();
+    for resp in responses {
+        let filenames = resp
+            .read_tbo_flush()
+            .map_err(|e| format!("Failed to read flush response: {}", e))?;
+        files.extend(filenames.into_iter().map(|s| s.to_string()));
     }
-    Ok(AssetSyncContext::new(ptrs, asset_ptrs))
+    Ok(files)
 }
 
-pub fn send_mesh_command(meta_vec: Vec<AssetPtr>) -> Result<EngineResponse, String> {
-    let command = EngineCommand::send_mesh(&meta_vec);
-    CLIENT.send_command(command)
+pub fn standardize_groups_command(uuids: Vec<Uuid>) -> Result<(), String> {
+    submit_standardize_groups_command(uuids)?.wait().map(|_| ())
 }
 
-pub fn standardize_groups_command(uuids: Vec<Uuid>) -> Result<EngineResponse, String> {
-    let command = EngineCommand::standardize_groups(&uuids);
-    CLIENT.send_command(command)
+pub fn submit_standardize_groups_command(uuids: Vec<Uuid>) -> Result<ShardHandles, String> {
+    submit_routed(&uuids, |_, indices| {
+        Command::standardize_groups(pick(&uuids, indices).into_owned())
+    })
 }
 
 pub fn standardize_synced_groups_command(
     uuids: Vec<Uuid>,
     surface_types: Vec<u32>,
-) -> Result<EngineResponse, String> {
-    let count = uuids.len();
-    let mut surface_vec: Vec<GroupSurface> = Vec::with_capacity(count);
+) -> Result<(), String> {
+    submit_standardize_synced_groups_command(uuids, surface_types)?.wait().map(|_| ())
+}
 
-    for i in 0..count {
-        let surf = GroupSurface::new(uuids[i], surface_types[i] as u64);
-        surface_vec.push(surf);
+pub fn submit_standardize_synced_groups_command(
+    uuids: Vec<Uuid>,
+    surface_types: Vec<u32>,
+) -> Result<ShardHandles, String> {
+    if surface_types.len() != uuids.len() {
+        return Err(format!("surface_contexts has {} entries, expected {}", surface_types.len(), uuids.len()));
     }
-
-    let command = EngineCommand::standardize_synced_groups(&surface_vec, 1);
-    CLIENT.send_command(command)
+    submit_routed(&uuids, |_, indices| {
+        let surface_vec: Vec<GroupSurface> = indices
+            .iter()
+            .map(|&i| GroupSurface::new(uuids[i], surface_types[i] as u64))
+            .collect();
+        Command::standardize_synced_groups(surface_vec)
+    })
 }
 
 pub fn set_surface_types_command(
     group_surface_map: HashMap<Uuid, i64>,
-) -> Result<EngineResponse, String> {
-    let count = group_surface_map.len();
-    let mut surface_vec: Vec<GroupSurface> = Vec::with_capacity(count);
+) -> Result<(), String> {
+    submit_set_surface_types_command(group_surface_map)?.wait().map(|_| ())
+}
 
-    group_surface_map.iter().for_each(|(uuid, surface_type)| {
-        let surf = GroupSurface::new(*uuid, *surface_type as u64);
-        surface_vec.push(surf);
-    });
+pub fn submit_set_surface_types_command(
+    group_surface_map: HashMap<Uuid, i64>,
+) -> Result<ShardHandles, String> {
+    let (uuids, surface_types): (Vec<Uuid>, Vec<i64>) = group_surface_map.into_iter().unzip();
+
+    submit_routed(&uuids, |_, indices| {
+        let surface_vec: Vec<GroupSurface> = indices
+            .iter()
+            .map(|&i| GroupSurface::new(uuids[i], surface_types[i] as u64))
+            .collect();
+        Command::set_surface_types(surface_vec)
+    })
+}
 
-    let command = EngineCommand::set_surface_types(&surface_vec, 1);
-    CLIENT.send_command(command)
+pub fn drop_groups_command(uuids: Vec<Uuid>) -> Result<(), String> {
+    submit_drop_groups_command(uuids)?.wait().map(|_| ())
 }
 
-pub fn drop_groups_command(uuids: Vec<Uuid>) -> Result<EngineResponse, String> {
-    let command = EngineCommand::drop_groups(&uuids, 1);
-    CLIENT.send_command(command)
+pub fn submit_drop_groups_command(uuids: Vec<Uuid>) -> Result<ShardHandles, String> {
+    let handles = submit_routed(&uuids, |_, indices| {
+        Command::drop_groups(pick(&uuids, indices).into_owned())
+    })?;
+    CLIENT.forget_placement(Some(&uuids));
+    CONTENT_HASHES.forget(Some(&uuids));
+    Ok(handles)
 }
 
-pub fn organize_objects_command() -> Result<EngineResponse, String> {
-    let command = EngineCommand::organize_objects(1);
-    CLIENT.send_command(command)
+pub fn organize_objects_command() -> Result<(), String> {
+    CLIENT
+        .send_all(|| command!(organize_objects(1)))
+        .map(|_| ())
 }
 
-pub fn get_surface_types_command() -> Result<EngineResponse, String> {
-    let command = EngineCommand::get_surface_types(1);
-    CLIENT.send_command(command)
+pub fn get_surface_types_command() -> Result<(), String> {
+    CLIENT
+        .send_all(|| command!(get_surface_types(1)))
+        .map(|_| ())
 }
 
 pub fn export_assets_command(
     path: &str,
     target_bytes: u64,
     uuids: Vec<Uuid>,
-) -> Result<EngineResponse, String> {
-    let command = EngineCommand::export_assets(path, target_bytes, &uuids);
-    CLIENT.send_command(command)
+) -> Result<(), String> {
+    let paths = shard_paths(path)?;
+    submit_routed(&uuids, |shard, indices| {
+        command!(export_assets(&paths[shard], target_bytes, &pick(&uuids, indices)))
+    })?
+    .wait()
+    .map(|_| ())
 }
 
-pub fn export_all_command(path: &str, target_bytes: u64) -> Result<EngineResponse, String> {
-    let command = EngineCommand::export_all(path, target_bytes);
-    CLIENT.send_command(command)
+pub fn export_all_command(path: &str, target_bytes: u64) -> Result<(), String> {
+    let paths = shard_paths(path)?;
+    CLIENT
+        .submit_each(|shard| {
+            Some(command!(export_all(&paths[shard], target_bytes)))
+        })?
+        .wait()
+        .map(|_| ())
 }
 
 pub fn export_asset_tbo_command(
     path: &str,
     target_bytes: u64,
     uuids: Vec<Uuid>,
-) -> Result<EngineResponse, String> {
-    let command = EngineCommand::export_asset_tbo(path, target_bytes, &uuids);
-    CLIENT.send_command(command)
+) -> Result<(), String> {
+    let paths = shard_paths(path)?;
+    submit_routed(&uuids, |shard, indices| {
+        command!(export_asset_tbo(&paths[shard], target_bytes, &pick(&uuids, indices)))
+    })?
+    .wait()
+    .map(|_| ())
+}
+
+/// Files written by every shard
+pub fn export_all_asset_tbo_command(path: &str, target_bytes: u64, skip_normalization: bool) -> Result<Vec<String>, String> {
+    let responses = submit_export_all_asset_tbo_command(path, target_bytes, skip_normalization)?.wait()?;
+    merge_tbo_flush(&responses)
+}
+
+pub fn submit_export_all_asset_tbo_command(path: &str, target_bytes: u64, skip_normalization: bool) -> Result<ShardHandles, String> {
+    let paths = shard_paths(path)?;
+    CLIENT.submit_each(|shard| {
+        Some(command!(export_all_asset_tbo(&paths[shard], target_bytes, skip_normalization)))
+    })
 }
 
-pub fn export_all_asset_tbo_command(path: &str, target_bytes: u64, skip_normalization: bool) -> Result<EngineResponse, String> {
-    let command = EngineCommand::export_all_asset_tbo(path, target_bytes, skip_normalization);
-    CLIENT.send_command(command)
+pub fn drop_all_groups_command() -> Result<(), String> {
+    CLIENT.send_all(|| command!(drop_all_groups()))?;
+    CLIENT.forget_placement(None);
+    CONTENT_HASHES.forget(None);
+
+    // Only unmap what the engine retired, dropping the pages of live slabs would undo prefaulting.
+    // A deferred pass shows up in the reclaims_deferred stat and the slabs go on the next one.
+    CLIENT.reclaim_slabs(false);
+    Ok(())
 }
 
-pub fn drop_all_groups_command() -> Result<EngineResponse, String> {
-    let command = EngineCommand::drop_all_groups();
-    CLIENT.send_command(command)
+/// Huge page, prefault and NUMA settings for the engine slabs mapped into this process
+pub fn set_slab_map_options(options: SlabMapOptions) {
+    CLIENT.set_slab_map_options(options);
 }
 
-pub fn import_assets_command(paths: Vec<String>) -> Result<EngineResponse, String> {
-    let path_refs: Vec<&str> = paths.iter().map(|s| s.as_str()).collect();
-    let command = EngineCommand::import_assets(&path_refs);
-    CLIENT.send_command(command)
+/// Unmaps retired slabs and, with `advise`, releases this process' pages of the rest.
+/// Skipped while contexts are alive.
+pub fn reclaim_slabs(advise: bool) -> ReclaimStats {
+    CLIENT.reclaim_slabs(advise)
 }
 
-  pub fn tbo_config_command(channel_mask: u32, target_point_count: u32) -> Result<EngineResponse, String> {
-    let command = EngineCommand::tbo_config(channel_mask, target_point_count);
-    CLIENT.send_command(command)
+/// Runs a blocking command call with its own deadline, None keeps the default one
+pub fn with_call_timeout<R>(timeout: Option<Duration>, f: impl FnOnce() -> R) -> R {
+    command_thread::with_call_timeout(timeout, f)
 }
 
-pub fn tbo_downsample_command(uuids: Vec<Uuid>) -> Result<EngineResponse, String> {
-    let command = EngineCommand::tbo_downsample(&uuids);
-    CLIENT.send_command(command)
+/// Declares which optional features the engines this process talks to support. The
+/// engine has no way to report them, an engine not built with a feature silently
+/// ignores what it doesn't know, so nothing that relies on one is sent until declared.
+pub fn set_engine_capabilities(capabilities: &[String]) -> Result<(), String> {
+    if let Some(unknown) = capabilities.iter().find(|name| !ENGINE_CAPABILITIES.contains(&name.as_str())) {
+        return Err(format!(
+            "Unknown engine capability '{}', expected one of {}",
+            unknown,
+            ENGINE_CAPABILITIES.join(", ")
+        ));
+    }
+    TBO_ENCODINGS.store(capabilities.iter().any(|name| name == "experimental_tbo_encodings"), Ordering::Relaxed);
+    Ok(())
 }
 
-pub fn tbo_flush_command(path: &str, target_bytes: u64, batch_offset: u32) -> Result<EngineResponse, String> {
-    let command = EngineCommand::tbo_flush(path, target_bytes, batch_offset);
-    CLIENT.send_command(command)
+pub fn engine_supports_tbo_encodings() -> bool {
+    TBO_ENCODINGS.load(Ordering::Relaxed)
+}
+
+/// Merge runs of queued drop/standardize/surface type commands into single requests
+pub fn set_command_coalescing(enabled: bool, linger: Duration) {
+    command_thread::set_coalescing(enabled, linger);
+}
+
+/// Deadline for every command submitted from now on, None waits forever
+pub fn set_command_timeout(timeout: Option<Duration>) {
+    command_thread::set_default_timeout(timeout);
+}
+
+pub fn engine_health() -> Vec<Option<EngineHealth>> {
+    CLIENT.health()
+}
+
+pub fn import_assets_command(paths: Vec<String>) -> Result<(), String> {
+    submit_import_assets_command(paths)?.wait().map(|_| ())
+}
+
+/// Files are dealt round-robin over the shards, each engine imports its share in parallel
+pub fn submit_import_assets_command(paths: Vec<String>) -> Result<ShardHandles, String> {
+    let shard_count = CLIENT.shard_count();
+    CLIENT.submit_each(|shard| {
+        let path_refs: Vec<&str> = paths
+            .iter()
+            .skip(shard)
+            .step_by(shard_count)
+            .map(|s| s.as_str())
+            .collect();
+        (shard_count == 1 || !path_refs.is_empty()).then(|| command!(import_assets(&path_refs)))
+    })
+}
+
+/// Imports one batch of a streaming import on the shard whose turn batch number `batch` is
+pub fn submit_import_batch(paths: &[String], batch: usize) -> Result<CommandHandle, String> {
+    let path_refs: Vec<&str> = paths.iter().map(String::as_str).collect();
+    CLIENT
+        .shard(batch % CLIENT.shard_count())
+        .submit_command(command!(import_assets(&path_refs)))
+}
+
+pub fn tbo_config_command(channel_mask: u32, target_point_count: u32) -> Result<(), String> {
+    CLIENT
+        .send_all(|| command!(tbo_config(channel_mask, target_point_count)))
+        .map(|_| ())
+}
+
+/// Meshes accumulated over every shard owning part of the batch
+pub fn tbo_downsample_command(uuids: &[Uuid]) -> Result<u32, String> {
+    let responses = submit_routed(uuids, |_, indices| {
+        command!(tbo_downsample(&pick(uuids, indices)))
+    })?
+    .wait()?;
+    Ok(merge_tbo_downsample(&responses))
+}
+
+pub fn submit_tbo_downsample_command(uuids: Vec<Uuid>) -> Result<ShardHandles, String> {
+    submit_routed(&uuids, |_, indices| {
+        command!(tbo_downsample(&pick(&uuids, indices)))
+    })
+}
+
+
+pub fn submit_tbo_flush_command(path: &str, target_bytes: u64, batch_offset: u32) -> Result<ShardHandles, String> {
+    let paths = shard_paths(path)?;
+    CLIENT.submit_each(|shard| {
+        Some(command!(tbo_flush(&paths[shard], target_bytes, batch_offset)))
+    })
 }
 
 pub fn set_engine_dir(path: PathBuf) {
@@ -300,12 +926,14 @@ pub fn resolve_engine_binary_path() -> Option<PathBuf> {
     None
 }
 
-pub fn group_all_objects_command() -> Result<EngineResponse, String> {
-    let command = EngineCommand::group_all_objects();
-    CLIENT.send_command(command)
+pub fn group_all_objects_command() -> Result<(), String> {
+    CLIENT
+        .send_all(|| command!(group_all_objects()))
+        .map(|_| ())
 }
 
-pub fn embed_all_assets_command() -> Result<EngineResponse, String> {
-    let command = EngineCommand::embed_all_assets(0);
-    CLIENT.send_command(command)
+pub fn embed_all_assets_command() -> Result<(), String> {
+    CLIENT
+        .send_all(|| command!(embed_all_assets(0)))
+        .map(|_| ())
 }
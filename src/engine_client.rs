@@ -1,122 +1,442 @@
 use crossbeam::channel;
 use iceoryx2::prelude::*;
-use iceoryx2_bb_posix::file::AccessMode;
-use iceoryx2_bb_posix::shared_memory::{SharedMemory, SharedMemoryBuilder};
-use pivot_com_types::alloc::SlabRegistry;
 use pivot_com_types::asset_meta::AssetMeta;
 use pivot_com_types::asset_ptr::AssetPtr;
-use pivot_com_types::{EngineCommand, EngineResponse, MeshPublish};
+use pivot_com_types::{EngineResponse, MeshPublish};
+use std::collections::VecDeque;
 use std::process::Child;
 use std::ptr::NonNull;
-use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
 use std::sync::{Arc, Mutex};
-
-use crate::command_thread::{CommandWork, spawn_command_thread};
-use crate::mesh_sync_thread::spawn_mesh_sync_thread;
+use std::time::{Duration, Instant};
+
+use crate::command_thread::{
+    self, Command, CommandHandle, CommandWork, LANE_QUEUE_CAPACITY, Lane, LaneHeartbeat, spawn_command_thread,
+};
+use crate::engine_stats::{STATS, command};
+use crate::mesh_sync_thread::{MeshSyncSignal, spawn_mesh_sync_thread};
+use crate::readiness::ReadyLatch;
+use crate::service_names::{INSTANCE_ENV_VAR, ServiceNames};
+use crate::slab_options::SlabMapOptions;
+use crate::slab_table::{ReclaimStats, SlabPin, SlabTable};
 
 #[derive(Debug)]
 struct ActiveState {
-    engine_process: Child,
-    command_tx: channel::Sender<CommandWork>,
+    /// None when attached to an engine some other process started
+    engine_process: Option<Child>,
+    /// Whether stop() shuts the engine down, false for attached and persistent engines
+    owns_engine: bool,
+    names: Arc<ServiceNames>,
+    /// One queue per priority lane, indexed by Lane::index
+    command_tx: Vec<channel::Sender<CommandWork>>,
     mesh_update_rx: channel::Receiver<MeshPublish>,
+    /// Publishes handed back by a failed poll, served before the queue
+    requeued: VecDeque<MeshPublish>,
     shutdown: Arc<AtomicBool>,
     threads: Vec<std::thread::JoinHandle<()>>,
-
-    slabs: Vec<SharedMemory>,
+    ready: Arc<ReadyLatch>,
+    heartbeats: Vec<Arc<LaneHeartbeat>>,
 }
 unsafe impl Send for ActiveState {}
 
+/// How long stop() waits for the engine to acknowledge stop_engine before killing it
+const STOP_TIMEOUT: Duration = Duration::from_secs(10);
+
+/// Liveness of one engine connection, see EngineClient::health
+#[derive(Debug, Clone)]
+pub struct EngineHealth {
+    pub instance: Option<String>,
+    pub ready: bool,
+    /// None for engines this process did not spawn
+    pub process_alive: Option<bool>,
+    /// Whether every IPC thread is still running
+    pub threads_alive: bool,
+    /// Longest a request has currently been waiting on the engine, over all lanes
+    pub oldest_pending: Option<Duration>,
+    /// Time since the engine last answered any lane
+    pub since_last_response: Option<Duration>,
+}
+
 #[derive(Debug)]
 pub struct EngineClient {
     state: Mutex<Option<ActiveState>>,
+    /// Serializes start, attach and stop. Held across the readiness wait so `state` never is,
+    /// and submits or health checks from other threads don't stall behind a starting engine.
+    lifecycle: Mutex<()>,
+    /// Set while a start or attach is waiting for the engine, the state isn't published yet
+    connecting: AtomicBool,
     node: Arc<Node<ipc::Service>>,
+    slabs: SlabTable,
+    /// Capacity of the mesh update queue for the next start, 0 means unbounded
+    mesh_queue_capacity: AtomicUsize,
+    /// Outlives engine restarts so Python can register its fd once, shared between shards
+    mesh_signal: Arc<MeshSyncSignal>,
 }
 
 impl EngineClient {
-    pub fn new() -> Self {
-        let node = NodeBuilder::new()
-            .create::<ipc::Service>()
-            .expect("Failed to create iceoryx2 node");
-
+    /// `node` and `mesh_signal` may be shared with the other shards of a ShardedClient
+    pub fn new(node: Arc<Node<ipc::Service>>, mesh_signal: Arc<MeshSyncSignal>) -> Self {
         EngineClient {
             state: Mutex::new(None),
-            node: Arc::new(node),
+            lifecycle: Mutex::new(()),
+            connecting: AtomicBool::new(false),
+            node,
+            slabs: SlabTable::new(),
+            mesh_queue_capacity: AtomicUsize::new(0),
+            mesh_signal,
         }
     }
 
-    pub fn send_command(&self, cmd: EngineCommand) -> Result<EngineResponse, String> {
-        let (tx, rx) = channel::bounded(1);
+    /// True while started or attached, or while either is still waiting for the engine
+    pub fn is_active(&self) -> bool {
+        self.connecting.load(Ordering::SeqCst) || self.state.lock().unwrap().is_some()
+    }
 
-        let guard = self.state.lock().unwrap();
-        let state = guard.as_ref().ok_or("Engine not started")?;
-
-        state
-            .command_tx
-            .send(CommandWork {
-                cmd,
-                response_tx: tx,
-            })
-            .map_err(|e| format!("Failed to send command: {}", e))?;
+    pub fn send_command(&self, command: Command) -> Result<EngineResponse, String> {
+        self.submit_command(command)?.wait()
+    }
 
-        drop(guard);
+    /// Queues a command without waiting for its response, so several can be in flight at once.
+    /// It gets the default deadline set through set_default_timeout.
+    pub fn submit_command(&self, command: Command) -> Result<CommandHandle, String> {
+        self.submit_command_with_timeout(command, command_thread::default_timeout())
+    }
+
+    pub fn submit_command_with_timeout(
+        &self,
+        command: Command,
+        timeout: Option<Duration>,
+    ) -> Result<CommandHandle, String> {
+        let lane = Lane::of(command.kind());
+        let (work, handle) = CommandHandle::new(command, timeout);
+
+        // Clone the lane's sender so a full bulk queue never holds the lock an interactive submit needs
+        let command_tx = {
+            let guard = self.state.lock().unwrap();
+            let state = guard.as_ref().ok_or("Engine not started")?;
+            state.command_tx[lane.index()].clone()
+        };
+
+        command_tx
+            .send(work)
+            .map_err(|e| format!("Failed to send command: {}", e))?;
 
-        rx.recv()
-            .map_err(|e| format!("Failed to receive response: {}", e))?
+        Ok(handle)
     }
 
     pub fn poll_mesh_sync(&self) -> Result<Option<MeshPublish>, String> {
-        let guard = self.state.lock().unwrap();
+        let mut guard = self.state.lock().unwrap();
 
-        let state = match guard.as_ref() {
+        let state = match guard.as_mut() {
             Some(state) => state,
             None => return Ok(None),
         };
 
-        match state.mesh_update_rx.try_recv() {
-            Ok(publish) => Ok(Some(publish)),
-            Err(_) => Ok(None),
+        self.mesh_signal.clear();
+        let publish = state.requeued.pop_front().or_else(|| state.mesh_update_rx.try_recv().ok());
+
+        // Still more queued, stay readable for the next poll
+        if !state.requeued.is_empty() || !state.mesh_update_rx.is_empty() {
+            self.mesh_signal.raise();
         }
+
+        Ok(publish)
     }
 
-    pub fn start(&self, path: String) -> Result<(), String> {
+    pub fn has_mesh_updates(&self) -> bool {
+        let guard = self.state.lock().unwrap();
+        guard
+            .as_ref()
+            .is_some_and(|state| !state.requeued.is_empty() || !state.mesh_update_rx.is_empty())
+    }
+
+    /// Pops every publish queued so far
+    pub fn drain_mesh_sync(&self) -> Vec<MeshPublish> {
         let mut guard = self.state.lock().unwrap();
 
-        if guard.is_some() {
-            return Ok(());
+        match guard.as_mut() {
+            Some(state) => {
+                self.mesh_signal.clear();
+                let mut publishes: Vec<MeshPublish> = state.requeued.drain(..).collect();
+                publishes.extend(state.mesh_update_rx.try_iter());
+                publishes
+            }
+            None => Vec::new(),
+        }
+    }
+
+    /// Puts drained publishes back in front of the queue, in order, for the next poll
+    pub fn requeue_mesh_sync(&self, publishes: Vec<MeshPublish>) {
+        if publishes.is_empty() {
+            return;
+        }
+        let mut guard = self.state.lock().unwrap();
+        if let Some(state) = guard.as_mut() {
+            for publish in publishes.into_iter().rev() {
+                state.requeued.push_front(publish);
+            }
+            self.mesh_signal.raise();
+        }
+    }
+
+    /// File descriptor that becomes readable while mesh publishes are waiting to be polled
+    #[cfg(unix)]
+    pub fn mesh_sync_fd(&self) -> std::os::fd::RawFd {
+        self.mesh_signal.fd()
+    }
+
+    pub fn mapped_slab_count(&self) -> usize {
+        self.slabs.len()
+    }
+
+    /// Slabs the engine has registered so far, including ones this process hasn't mapped yet
+    pub fn registered_slab_count(&self) -> usize {
+        self.slabs.registered_slabs()
+    }
+
+    pub fn set_slab_map_options(&self, options: SlabMapOptions) {
+        self.slabs.set_options(options);
+    }
+
+    pub fn reclaim_slabs(&self, advise: bool) -> ReclaimStats {
+        self.slabs.reclaim(advise)
+    }
+
+    /// (command queue, mesh update queue) lengths, zero while the engine is stopped
+    pub fn queue_lengths(&self) -> (usize, usize) {
+        let guard = self.state.lock().unwrap();
+        match guard.as_ref() {
+            Some(state) => (
+                state.command_tx.iter().map(|tx| tx.len()).sum(),
+                state.requeued.len() + state.mesh_update_rx.len(),
+            ),
+            None => (0, 0),
+        }
+    }
+
+    /// Bounds the mesh update queue of the next engine start. Once full the sync thread stops pulling
+    /// from the engine, or drops the oldest queued publish when the engine's service overwrites on overflow.
+    pub fn set_mesh_queue_capacity(&self, capacity: usize) {
+        self.mesh_queue_capacity.store(capacity, Ordering::Relaxed);
+    }
+
+    /// Liveness of the connection, None while stopped
+    pub fn health(&self) -> Option<EngineHealth> {
+        let mut guard = self.state.lock().unwrap();
+        let state = guard.as_mut()?;
+
+        let process_alive = state
+            .engine_process
+            .as_mut()
+            .map(|process| matches!(process.try_wait(), Ok(None)));
+        let oldest_pending = state.heartbeats.iter().filter_map(|hb| hb.oldest_pending()).max();
+        let since_last_response = state.heartbeats.iter().filter_map(|hb| hb.since_last_response()).min();
+
+        Some(EngineHealth {
+            instance: state.names.instance.clone(),
+            ready: state.ready.is_ready(),
+            process_alive,
+            threads_alive: state.threads.iter().all(|handle| !handle.is_finished()),
+            oldest_pending,
+            since_last_response,
+        })
+    }
+
+    /// True once both IPC threads have opened their engine services
+    pub fn is_ready(&self) -> bool {
+        let guard = self.state.lock().unwrap();
+        guard.as_ref().is_some_and(|state| state.ready.is_ready())
+    }
+
+    /// Spawns the engine and its IPC threads. With `wait` set, returns only once both
+    /// service sets are live; on timeout or an early engine exit everything is torn down again.
+    /// An `instance` id puts the engine's services under their own names; a `persistent`
+    /// engine is left running by stop() so later SDK processes can attach to it.
+    pub fn start(
+        &self,
+        path: String,
+        wait: Option<Duration>,
+        instance: Option<String>,
+        persistent: bool,
+    ) -> Result<(), String> {
+        let lifecycle = self.lifecycle.lock().unwrap();
+        let guard = self.state.lock().unwrap();
+
+        if let Some(state) = guard.as_ref() {
+            if state.names.instance != instance {
+                return Err(format!(
+                    "Already connected to engine instance {:?}, stop it first",
+                    state.names.instance
+                ));
+            }
+            let ready = state.ready.clone();
+            drop(guard);
+            drop(lifecycle);
+            return match wait {
+                Some(timeout) if !ready.wait_for(timeout) => {
+                    Err(format!("Engine did not become ready within {:?}", timeout))
+                }
+                _ => Ok(()),
+            };
+        }
+
+        drop(guard);
+
+        if let Some(id) = &instance {
+            ServiceNames::validate_instance(id)?;
+        }
+
+        let mut command = std::process::Command::new(path);
+        if let Some(id) = &instance {
+            command.env(INSTANCE_ENV_VAR, id);
         }
+        let engine_process = command.spawn().map_err(|e| e.to_string())?;
 
-        let engine_process = std::process::Command::new(path)
-            .spawn()
-            .map_err(|e| e.to_string())?;
+        let state = self.connect(Some(engine_process), ServiceNames::new(instance.as_deref()), !persistent, wait)?;
+        self.publish(state);
+        Ok(())
+    }
+
+    /// Connects to an engine that is already running (or about to be) under `instance`,
+    /// without spawning one. stop() then only detaches and leaves the engine running.
+    pub fn attach(&self, instance: Option<String>, timeout: Duration) -> Result<(), String> {
+        let _lifecycle = self.lifecycle.lock().unwrap();
+
+        if let Some(state) = self.state.lock().unwrap().as_ref() {
+            if state.names.instance == instance {
+                return Ok(());
+            }
+            return Err(format!(
+                "Already connected to engine instance {:?}, stop it first",
+                state.names.instance
+            ));
+        }
+
+        if let Some(id) = &instance {
+            ServiceNames::validate_instance(id)?;
+        }
+
+        let state = self.connect(None, ServiceNames::new(instance.as_deref()), false, Some(timeout))?;
+        self.publish(state);
+        Ok(())
+    }
 
-        let (command_tx, command_rx) = channel::bounded::<CommandWork>(10);
-        let (mesh_update_tx, mesh_update_rx) = channel::unbounded::<MeshPublish>();
+    /// Makes a connected engine visible to submits, polls and health checks
+    fn publish(&self, state: ActiveState) {
+        *self.state.lock().unwrap() = Some(state);
+        self.connecting.store(false, Ordering::SeqCst);
+    }
+
+    /// Starts the IPC threads against `names`, optionally waiting for the services to come up.
+    /// Runs under the lifecycle lock only, the caller publishes the returned state.
+    fn connect(
+        &self,
+        engine_process: Option<Child>,
+        names: ServiceNames,
+        owns_engine: bool,
+        wait: Option<Duration>,
+    ) -> Result<ActiveState, String> {
+        self.connecting.store(true, Ordering::SeqCst);
+        let result = self.connect_threads(engine_process, names, owns_engine, wait);
+        if result.is_err() {
+            self.connecting.store(false, Ordering::SeqCst);
+        }
+        result
+    }
+
+    fn connect_threads(
+        &self,
+        mut engine_process: Option<Child>,
+        names: ServiceNames,
+        owns_engine: bool,
+        wait: Option<Duration>,
+    ) -> Result<ActiveState, String> {
+        let names = Arc::new(names);
+        let (mesh_update_tx, mesh_update_rx) = match self.mesh_queue_capacity.load(Ordering::Relaxed) {
+            0 => channel::unbounded::<MeshPublish>(),
+            capacity => channel::bounded::<MeshPublish>(capacity),
+        };
         let shutdown = Arc::new(AtomicBool::new(false));
-        let command_thread = spawn_command_thread(self.node.clone(), command_rx, shutdown.clone());
+        let ready = Arc::new(ReadyLatch::new());
+        let mut command_tx = Vec::with_capacity(Lane::COUNT);
+        let mut heartbeats = Vec::with_capacity(Lane::COUNT);
+        let mut threads = Vec::with_capacity(Lane::COUNT + 1);
+        for lane in Lane::ALL {
+            let (tx, command_rx) = channel::bounded::<CommandWork>(LANE_QUEUE_CAPACITY);
+            let heartbeat = Arc::new(LaneHeartbeat::default());
+            command_tx.push(tx);
+            heartbeats.push(heartbeat.clone());
+            threads.push(spawn_command_thread(
+                self.node.clone(),
+                names.clone(),
+                lane,
+                command_rx,
+                shutdown.clone(),
+                ready.clone(),
+                heartbeat,
+            ));
+        }
         let mesh_sync_thread =
-            spawn_mesh_sync_thread(self.node.clone(), shutdown.clone(), mesh_update_tx);
+            spawn_mesh_sync_thread(
+                self.node.clone(),
+                names.clone(),
+                shutdown.clone(),
+                mesh_update_tx,
+                mesh_update_rx.clone(),
+                self.mesh_signal.clone(),
+                ready.clone(),
+            );
+        threads.push(mesh_sync_thread);
+
+        if let Some(timeout) = wait {
+            if let Err(e) = wait_until_ready(&ready, engine_process.as_mut(), timeout) {
+                shutdown.store(true, Ordering::SeqCst);
+                if let Some(process) = engine_process.as_mut() {
+                    let _ = process.kill();
+                }
+                for handle in threads {
+                    let _ = handle.join();
+                }
+                if let Some(process) = engine_process.as_mut() {
+                    let _ = process.wait();
+                }
+                return Err(e);
+            }
+        }
 
-        *guard = Some(ActiveState {
+        Ok(ActiveState {
             engine_process,
+            owns_engine,
+            names,
             command_tx,
-            threads: vec![command_thread, mesh_sync_thread],
+            threads,
             shutdown: shutdown,
             mesh_update_rx,
-            slabs: Vec::new(),
-        });
-        Ok(())
+            requeued: VecDeque::new(),
+            ready,
+            heartbeats,
+        })
     }
 
     pub fn stop(&self) -> Result<(), String> {
-        {
+        let _lifecycle = self.lifecycle.lock().unwrap();
+        let owns_engine = {
             let guard = self.state.lock().unwrap();
-            if guard.is_none() {
-                return Ok(());
+            match guard.as_ref() {
+                Some(state) => state.owns_engine,
+                None => return Ok(()),
             }
-        }
+        };
 
-        let command = EngineCommand::stop_engine();
-        let res = self.send_command(command);
+        // Attached and persistent engines keep running for the next SDK process.
+        // A hung engine is killed once STOP_TIMEOUT passes instead of blocking forever.
+        let res = if owns_engine {
+            self.submit_command_with_timeout(command!(stop_engine()), Some(STOP_TIMEOUT))
+                .and_then(|handle| handle.wait())
+                .map(|_| ())
+        } else {
+            Ok(())
+        };
 
         let mut guard = self.state.lock().unwrap();
         if let Some(mut state) = guard.take() {
@@ -125,7 +445,9 @@ impl EngineClient {
                     "Failed to send stop command to engine, killing process: {}",
                     e
                 );
-                let _ = state.engine_process.kill();
+                if let Some(process) = state.engine_process.as_mut() {
+                    let _ = process.kill();
+                }
             }
 
             state.shutdown.store(true, Ordering::SeqCst);
@@ -134,7 +456,12 @@ impl EngineClient {
                 let _ = handle.join();
             }
 
-            let _ = state.engine_process.wait();
+            if owns_engine {
+                if let Some(process) = state.engine_process.as_mut() {
+                    let _ = process.wait();
+                }
+            }
+            self.slabs.clear();
 
             println!("All threads joined. SDK is clean.");
         }
@@ -144,66 +471,50 @@ impl EngineClient {
 
     ///Takes asset ptrs and hydrates them into local pointers into shared memory for AssetMetas
     /// If we dont have any slabs registered yet we use the root_handle as the slab registry is the first address there
+    /// Never touches the state lock, so hydration runs concurrently with command submission
     pub fn hydrate_ptrs(
         &self,
         asset_ptrs: &[AssetPtr],
         root_handle: &[u8],
     ) -> Result<Vec<NonNull<AssetMeta>>, String> {
-        let mut guard = self.state.lock().unwrap();
-        let state = guard.as_mut().expect("Engine not started");
-
-        //If this is engine startup we open the root shm which contains the slab registry for later syncing
-        if state.slabs.is_empty() {
-            state.slabs.push(open_shm(root_handle)?);
-        }
-
-        Self::ensure_slabs_synced(state); // Ensure that we have the correct number of slabs
-
-        let mut ptrs = Vec::with_capacity(asset_ptrs.len());
-
-        for asset_ptr in asset_ptrs {
-            let (slab_index, offset) = asset_ptr.unpack();
-
-            let shm = &state
-                .slabs
-                .get(slab_index as usize)
-                .ok_or_else(|| format!("Slab index {} is out of bounds", slab_index))?;
-
-            unsafe {
-                let raw_ptr = shm.base_address().as_ptr().add(offset as usize) as *mut AssetMeta;
-                ptrs.push(NonNull::new_unchecked(raw_ptr));
-            }
-        };
-
-        Ok(ptrs)
-        
+        let started = Instant::now();
+        // Callers keep their own pin for the returned pointers, this one covers the lookup itself
+        let _pin = SlabPin::new();
+        self.slabs.sync(root_handle)?; // Ensure that we have the correct number of slabs
+
+        let ptrs = asset_ptrs
+            .iter()
+            .map(|asset_ptr| self.slabs.resolve(asset_ptr))
+            .collect();
+
+        STATS.hydrate.record(started.elapsed());
+        STATS.hydrated_ptrs.fetch_add(asset_ptrs.len() as u64, Ordering::Relaxed);
+        ptrs
     }
+}
 
-    ///Checks the returned number of slabs and opens the ones at the end of the list until we have the correct ones open as the engine will only ever create new ones at the end
-    fn ensure_slabs_synced(state: &mut ActiveState) {
-        let registry = unsafe { &*(state.slabs[0].base_address().as_ptr() as *const SlabRegistry) };
-        let target_count = registry.num_slabs as usize;
-
-        // If the Engine added a slab, Blender catches up here.
-        while state.slabs.len() < target_count {
-            let next_idx = state.slabs.len();
-            let handle = &registry.slab_handles[next_idx];
-
-            match open_shm(handle) {
-                Ok(shm) => {
-                    println!(
-                        "[SDK] Auto-mapped new memory slab [{}]: {:?}",
-                        next_idx,
-                        bytes_to_clean_str(handle)
-                    );
-                    state.slabs.push(shm);
-                }
-                Err(e) => {
-                    eprintln!("[SDK] Failed to map discovered slab: {}", e);
-                    break;
-                }
+/// Waits for the IPC threads to report live services, bailing out early if the engine exits
+fn wait_until_ready(
+    ready: &ReadyLatch,
+    mut engine_process: Option<&mut Child>,
+    timeout: Duration,
+) -> Result<(), String> {
+    const EXIT_CHECK_INTERVAL: Duration = Duration::from_millis(20);
+    let deadline = Instant::now() + timeout;
+
+    loop {
+        let remaining = deadline.saturating_duration_since(Instant::now());
+        if ready.wait_for(remaining.min(EXIT_CHECK_INTERVAL)) {
+            return Ok(());
+        }
+        if let Some(process) = engine_process.as_mut() {
+            if let Ok(Some(status)) = process.try_wait() {
+                return Err(format!("Engine exited during startup: {}", status));
             }
         }
+        if remaining.is_zero() {
+            return Err(format!("Engine did not become ready within {:?}", timeout));
+        }
     }
 }
 
@@ -212,24 +523,3 @@ pub fn bytes_to_clean_str(bytes: &[u8]) -> &[u8] {
     let len = bytes.iter().position(|&b| b == 0).unwrap_or(bytes.len());
     &bytes[..len]
 }
-
-///Opens existing shm by u8 handle
-fn open_shm(handle: &[u8]) -> Result<SharedMemory, String> {
-    let clean_handle = bytes_to_clean_str(handle);
-    let file_name = match FileName::new(clean_handle) {
-        Ok(f) => f,
-        Err(e) => {
-            return Err(format!(
-                "invalid shared memory name '{:?}': {:?}",
-                clean_handle, e
-            ));
-        }
-    };
-
-    let shm = {
-        SharedMemoryBuilder::new(&file_name)
-            .open_existing(AccessMode::ReadWrite)
-            .expect("Failed to open shm")
-    };
-    Ok(shm)
-}
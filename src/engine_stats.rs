@@ -0,0 +1,305 @@
+//! Process-wide counters and latency histograms for engine IPC.
+//!
+//! Everything is a relaxed atomic so recording from the command thread,
+//! the mesh sync thread and Python callers never contends on a lock.
+//! `snapshot` turns the current values into a Python dict for get_engine_stats().
+
+use pyo3::prelude::*;
+use pyo3::types::PyDict;
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::time::Duration;
+
+pub static STATS: EngineStats = EngineStats::new();
+
+/// Declares every engine command once, as its CommandKind variant and the EngineCommand builder
+/// that creates it. The kind's name is the builder's name, and `command!` takes the kind from the
+/// builder it calls, so a request can never be queued, timed or routed under another command's kind.
+/// `$d` is a literal `$` so the generated `command!` can have repetitions of its own.
+macro_rules! engine_commands {
+    ($d:tt $($kind:ident => $builder:ident),* $(,)?) => {
+        /// Which engine command a request is, used to key the per-command histograms
+        #[derive(Clone, Copy, Debug, PartialEq, Eq)]
+        pub enum CommandKind {
+            $($kind),*
+        }
+
+        impl CommandKind {
+            pub const ALL: &'static [CommandKind] = &[$(CommandKind::$kind),*];
+
+            pub const COUNT: usize = CommandKind::ALL.len();
+
+            pub fn name(self) -> &'static str {
+                match self {
+                    $(CommandKind::$kind => stringify!($builder)),*
+                }
+            }
+        }
+
+        /// `command!(tbo_flush(path, target_bytes, offset))` is `EngineCommand::tbo_flush(..)`
+        /// tagged with CommandKind::TboFlush
+        macro_rules! command {
+            $(($builder($d($d arg:expr),* $d(,)?)) => {
+                $crate::command_thread::Command::tagged(
+                    $crate::engine_stats::CommandKind::$kind,
+                    ::pivot_com_types::EngineCommand::$builder($d($d arg),*),
+                )
+            };)*
+        }
+        pub(crate) use command;
+    };
+}
+
+engine_commands! {$
+    AllocRequest => alloc_request,
+    SendMesh => send_mesh,
+    StandardizeGroups => standardize_groups,
+    StandardizeSyncedGroups => standardize_synced_groups,
+    SetSurfaceTypes => set_surface_types,
+    DropGroups => drop_groups,
+    OrganizeObjects => organize_objects,
+    GetSurfaceTypes => get_surface_types,
+    ExportAssets => export_assets,
+    ExportAll => export_all,
+    ExportAssetTbo => export_asset_tbo,
+    ExportAllAssetTbo => export_all_asset_tbo,
+    DropAllGroups => drop_all_groups,
+    ImportAssets => import_assets,
+    TboConfig => tbo_config,
+    TboDownsample => tbo_downsample,
+    TboFlush => tbo_flush,
+    GroupAllObjects => group_all_objects,
+    EmbedAllAssets => embed_all_assets,
+    StopEngine => stop_engine,
+}
+
+const BUCKETS: usize = 32;
+
+/// Log2 histogram of durations in microseconds; bucket i holds [2^(i-1), 2^i) us
+pub struct Histogram {
+    buckets: [AtomicU64; BUCKETS],
+    count: AtomicU64,
+    sum_ns: AtomicU64,
+    max_ns: AtomicU64,
+}
+
+impl Histogram {
+    const fn new() -> Self {
+        Histogram {
+            buckets: [const { AtomicU64::new(0) }; BUCKETS],
+            count: AtomicU64::new(0),
+            sum_ns: AtomicU64::new(0),
+            max_ns: AtomicU64::new(0),
+        }
+    }
+
+    pub fn record(&self, elapsed: Duration) {
+        let ns = elapsed.as_nanos().min(u64::MAX as u128) as u64;
+        let us = ns / 1000;
+        let bucket = ((u64::BITS - us.leading_zeros()) as usize).min(BUCKETS - 1);
+
+        self.buckets[bucket].fetch_add(1, Ordering::Relaxed);
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.sum_ns.fetch_add(ns, Ordering::Relaxed);
+        self.max_ns.fetch_max(ns, Ordering::Relaxed);
+    }
+
+    fn reset(&self) {
+        for bucket in &self.buckets {
+            bucket.store(0, Ordering::Relaxed);
+        }
+        self.count.store(0, Ordering::Relaxed);
+        self.sum_ns.store(0, Ordering::Relaxed);
+        self.max_ns.store(0, Ordering::Relaxed);
+    }
+
+    fn count(&self) -> u64 {
+        self.count.load(Ordering::Relaxed)
+    }
+
+    /// Upper edge in us of the bucket containing quantile q
+    fn quantile_us(&self, counts: &[u64; BUCKETS], total: u64, q: f64) -> u64 {
+        let target = ((total as f64) * q).ceil().max(1.0) as u64;
+        let mut seen = 0;
+        for (i, &c) in counts.iter().enumerate() {
+            seen += c;
+            if seen >= target {
+                return 1u64 << i;
+            }
+        }
+        1u64 << (BUCKETS - 1)
+    }
+
+    fn to_dict<'py>(&self, py: Python<'py>) -> PyResult<Bound<'py, PyDict>> {
+        let counts: [u64; BUCKETS] =
+            std::array::from_fn(|i| self.buckets[i].load(Ordering::Relaxed));
+        let total: u64 = counts.iter().sum();
+        let sum_ns = self.sum_ns.load(Ordering::Relaxed);
+
+        let dict = PyDict::new(py);
+        dict.set_item("count", total)?;
+        dict.set_item("mean_us", if total > 0 { sum_ns as f64 / total as f64 / 1000.0 } else { 0.0 })?;
+        dict.set_item("max_us", self.max_ns.load(Ordering::Relaxed) as f64 / 1000.0)?;
+        dict.set_item("p50_us", self.quantile_us(&counts, total, 0.50))?;
+        dict.set_item("p90_us", self.quantile_us(&counts, total, 0.90))?;
+        dict.set_item("p99_us", self.quantile_us(&counts, total, 0.99))?;
+        dict.set_item("buckets_us_log2", counts.to_vec())?;
+        Ok(dict)
+    }
+}
+
+/// Latency of each stage a command passes through
+pub struct CommandStats {
+    /// Waiting in the command queue until the command thread picks it up
+    pub queue_wait: Histogram,
+    /// Loaning the request sample from shared memory
+    pub loan: Histogram,
+    /// Writing, sending and notifying the engine
+    pub send: Histogram,
+    /// From send until the response was received
+    pub response: Histogram,
+    pub errors: AtomicU64,
+    /// Commands merged into an earlier queued one instead of being sent on their own
+    pub coalesced: AtomicU64,
+    /// Commands answered with a timeout error because their deadline passed
+    pub timeouts: AtomicU64,
+    pub cancelled: AtomicU64,
+}
+
+impl CommandStats {
+    const fn new() -> Self {
+        CommandStats {
+            queue_wait: Histogram::new(),
+            loan: Histogram::new(),
+            send: Histogram::new(),
+            response: Histogram::new(),
+            errors: AtomicU64::new(0),
+            coalesced: AtomicU64::new(0),
+            timeouts: AtomicU64::new(0),
+            cancelled: AtomicU64::new(0),
+        }
+    }
+}
+
+pub struct EngineStats {
+    commands: [CommandStats; CommandKind::COUNT],
+    in_flight: AtomicUsize,
+    max_in_flight: AtomicUsize,
+    pub mesh_publishes: AtomicU64,
+    /// Queued publishes discarded to make room because the engine's service overwrites on overflow
+    pub mesh_publishes_dropped: AtomicU64,
+    pub hydrate: Histogram,
+    pub hydrated_ptrs: AtomicU64,
+    pub slabs_mapped: AtomicU64,
+    pub slabs_unmapped: AtomicU64,
+    pub mapped_bytes: AtomicU64,
+    pub reclaimed_bytes: AtomicU64,
+    /// Reclaim passes skipped because an AssetSyncContext or one of its views was alive
+    pub reclaims_deferred: AtomicU64,
+    /// Assets prepare_mesh_send(content_hashes=...) left out because their content hash matched
+    pub unchanged_skipped: AtomicU64,
+}
+
+impl EngineStats {
+    const fn new() -> Self {
+        EngineStats {
+            commands: [const { CommandStats::new() }; CommandKind::COUNT],
+            in_flight: AtomicUsize::new(0),
+            max_in_flight: AtomicUsize::new(0),
+            mesh_publishes: AtomicU64::new(0),
+            mesh_publishes_dropped: AtomicU64::new(0),
+            hydrate: Histogram::new(),
+            hydrated_ptrs: AtomicU64::new(0),
+            slabs_mapped: AtomicU64::new(0),
+            slabs_unmapped: AtomicU64::new(0),
+            mapped_bytes: AtomicU64::new(0),
+            reclaimed_bytes: AtomicU64::new(0),
+            reclaims_deferred: AtomicU64::new(0),
+            unchanged_skipped: AtomicU64::new(0),
+        }
+    }
+
+    pub fn command(&self, kind: CommandKind) -> &CommandStats {
+        &self.commands[kind as usize]
+    }
+
+    pub fn request_sent(&self) {
+        let depth = self.in_flight.fetch_add(1, Ordering::Relaxed) + 1;
+        self.max_in_flight.fetch_max(depth, Ordering::Relaxed);
+    }
+
+    pub fn request_finished(&self) {
+        self.in_flight.fetch_sub(1, Ordering::Relaxed);
+    }
+
+    /// Clears counters and histograms; gauges (in-flight depth, mapped bytes) keep their current value
+    pub fn reset(&self) {
+        for stats in &self.commands {
+            stats.queue_wait.reset();
+            stats.loan.reset();
+            stats.send.reset();
+            stats.response.reset();
+            stats.errors.store(0, Ordering::Relaxed);
+            stats.coalesced.store(0, Ordering::Relaxed);
+            stats.timeouts.store(0, Ordering::Relaxed);
+            stats.cancelled.store(0, Ordering::Relaxed);
+        }
+        self.max_in_flight
+            .store(self.in_flight.load(Ordering::Relaxed), Ordering::Relaxed);
+        self.mesh_publishes.store(0, Ordering::Relaxed);
+        self.mesh_publishes_dropped.store(0, Ordering::Relaxed);
+        self.hydrate.reset();
+        self.hydrated_ptrs.store(0, Ordering::Relaxed);
+        self.slabs_mapped.store(0, Ordering::Relaxed);
+        self.slabs_unmapped.store(0, Ordering::Relaxed);
+        self.reclaimed_bytes.store(0, Ordering::Relaxed);
+        self.reclaims_deferred.store(0, Ordering::Relaxed);
+        self.unchanged_skipped.store(0, Ordering::Relaxed);
+    }
+
+    /// Current values as a dict; queue lengths and slab count are sampled by the caller
+    pub fn snapshot<'py>(
+        &self,
+        py: Python<'py>,
+        command_queue_len: usize,
+        mesh_queue_len: usize,
+        slab_count: usize,
+    ) -> PyResult<Bound<'py, PyDict>> {
+        let commands = PyDict::new(py);
+        for &kind in CommandKind::ALL {
+            let stats = self.command(kind);
+            if stats.queue_wait.count() == 0 && stats.errors.load(Ordering::Relaxed) == 0 {
+                continue;
+            }
+
+            let entry = PyDict::new(py);
+            entry.set_item("queue_wait", stats.queue_wait.to_dict(py)?)?;
+            entry.set_item("loan", stats.loan.to_dict(py)?)?;
+            entry.set_item("send", stats.send.to_dict(py)?)?;
+            entry.set_item("response", stats.response.to_dict(py)?)?;
+            entry.set_item("errors", stats.errors.load(Ordering::Relaxed))?;
+            entry.set_item("coalesced", stats.coalesced.load(Ordering::Relaxed))?;
+            entry.set_item("timeouts", stats.timeouts.load(Ordering::Relaxed))?;
+            entry.set_item("cancelled", stats.cancelled.load(Ordering::Relaxed))?;
+            commands.set_item(kind.name(), entry)?;
+        }
+
+        let dict = PyDict::new(py);
+        dict.set_item("commands", commands)?;
+        dict.set_item("in_flight", self.in_flight.load(Ordering::Relaxed))?;
+        dict.set_item("max_in_flight", self.max_in_flight.load(Ordering::Relaxed))?;
+        dict.set_item("command_queue_len", command_queue_len)?;
+        dict.set_item("mesh_queue_len", mesh_queue_len)?;
+        dict.set_item("mesh_publishes", self.mesh_publishes.load(Ordering::Relaxed))?;
+        dict.set_item("mesh_publishes_dropped", self.mesh_publishes_dropped.load(Ordering::Relaxed))?;
+        dict.set_item("hydrate", self.hydrate.to_dict(py)?)?;
+        dict.set_item("hydrated_ptrs", self.hydrated_ptrs.load(Ordering::Relaxed))?;
+        dict.set_item("slab_count", slab_count)?;
+        dict.set_item("slabs_mapped", self.slabs_mapped.load(Ordering::Relaxed))?;
+        dict.set_item("slabs_unmapped", self.slabs_unmapped.load(Ordering::Relaxed))?;
+        dict.set_item("mapped_bytes", self.mapped_bytes.load(Ordering::Relaxed))?;
+        dict.set_item("reclaimed_bytes", self.reclaimed_bytes.load(Ordering::Relaxed))?;
+        dict.set_item("reclaims_deferred", self.reclaims_deferred.load(Ordering::Relaxed))?;
+        dict.set_item("unchanged_skipped", self.unchanged_skipped.load(Ordering::Relaxed))?;
+        Ok(dict)
+    }
+}
@@ -0,0 +1,173 @@
+//! Streaming import for large asset libraries.
+//!
+//! The paths are split into small import_assets commands with up to
+//! `max_in_flight` outstanding, dealt round-robin over the engine shards.
+//! Each batch is reported as soon as its engine answers, which gives per-batch
+//! progress. The import response carries no status, so a file the engine fails
+//! to import is not reported; only commands that fail to go through (transport
+//! errors, timeouts, cancels) are. Imported assets still
+//! arrive through the mesh sync publishes, optionally drained into each item.
+//! Publishes don't say which command produced them, so draining takes every
+//! publish received so far, including ones that have nothing to do with the import.
+
+use pyo3::prelude::*;
+use std::ops::Range;
+
+use crate::asset_sync_context::AssetSyncContext;
+use crate::command_thread::CommandHandle;
+use crate::engine_api;
+
+/// Outcome of one batch: its paths, the command error if it didn't go through, and the publishes drained after it
+type ImportItem = (Vec<String>, Option<String>, Option<AssetSyncContext>);
+
+#[pyclass(unsendable)]
+pub struct ImportStream {
+    paths: Vec<String>,
+    batch_size: usize,
+    max_in_flight: usize,
+    deliver_assets: bool,
+    /// First path not yet submitted
+    next_start: usize,
+    /// Batches submitted so far, picks the shard of the next one
+    submitted: usize,
+    in_flight: Vec<CommandHandle>,
+    /// Path range of every in-flight batch, same order as in_flight
+    in_flight_ranges: Vec<Range<usize>>,
+    /// Paths of every batch that finished, successful or not
+    completed: usize,
+    command_failed: usize,
+    /// Error hit after a batch finished, reported by the next call so the batch isn't lost
+    deferred_error: Option<String>,
+}
+
+impl ImportStream {
+    pub fn new(
+        paths: Vec<String>,
+        batch_size: usize,
+        max_in_flight: usize,
+        deliver_assets: bool,
+    ) -> Result<ImportStream, String> {
+        if batch_size == 0 {
+            return Err("batch_size must be at least 1".to_string());
+        }
+
+        Ok(ImportStream {
+            paths,
+            batch_size,
+            max_in_flight: max_in_flight.max(1),
+            deliver_assets,
+            next_start: 0,
+            submitted: 0,
+            in_flight: Vec::new(),
+            in_flight_ranges: Vec::new(),
+            completed: 0,
+            command_failed: 0,
+            deferred_error: None,
+        })
+    }
+
+    /// Submits batches until the in-flight window is full or every path has been requested
+    fn top_up(&mut self) -> Result<(), String> {
+        while self.in_flight.len() < self.max_in_flight && self.next_start < self.paths.len() {
+            let range = self.next_start..(self.next_start + self.batch_size).min(self.paths.len());
+            let handle = engine_api::submit_import_batch(&self.paths[range.clone()], self.submitted)?;
+
+            self.in_flight.push(handle);
+            self.next_start = range.end;
+            self.in_flight_ranges.push(range);
+            self.submitted += 1;
+        }
+        Ok(())
+    }
+
+    /// Next finished batch in completion order, None once every path was imported
+    fn next_batch(&mut self) -> Result<Option<ImportItem>, String> {
+        if let Some(e) = self.deferred_error.take() {
+            return Err(e);
+        }
+        self.top_up()?;
+
+        if self.in_flight.is_empty() {
+            // The engine may still publish the last batch's assets after answering
+            if self.deliver_assets {
+                if let Some(context) = engine_api::poll_mesh_sync_all()? {
+                    return Ok(Some((Vec::new(), None, Some(context))));
+                }
+            }
+            return Ok(None);
+        }
+
+        let i = CommandHandle::select(&mut self.in_flight);
+        let range = self.in_flight_ranges.swap_remove(i);
+        let result = self.in_flight.swap_remove(i).wait();
+
+        let command_error = result.err();
+        self.completed += range.len();
+        if command_error.is_some() {
+            self.command_failed += range.len();
+        }
+
+        // Keep the engines busy with the following batches while Python handles this one.
+        // The batch is done either way, failures here wait for the next call.
+        if let Err(e) = self.top_up() {
+            self.deferred_error = Some(e);
+        }
+
+        let assets = if self.deliver_assets {
+            engine_api::poll_mesh_sync_all().unwrap_or_else(|e| {
+                self.deferred_error.get_or_insert(e);
+                None
+            })
+        } else {
+            None
+        };
+        Ok(Some((self.paths[range].to_vec(), command_error, assets)))
+    }
+}
+
+#[pymethods]
+impl ImportStream {
+    fn __iter__(slf: PyRef<'_, Self>) -> PyRef<'_, Self> {
+        slf
+    }
+
+    /// Blocks until the next batch is answered and returns (paths, command_error, assets).
+    ///
+    /// command_error is set only when the command didn't go through (transport error,
+    /// timeout or cancel). The engine reports no per-file status, so files it failed to
+    /// import still come back with command_error None. assets is an
+    /// AssetSyncContext of every mesh sync publish received so far when deliver_assets
+    /// is set, not only this batch's. Publishes arriving after the last batch come as
+    /// items with no paths. An error submitting the next batches is raised by the
+    /// following call, after the finished batch was returned.
+    fn __next__(&mut self, py: Python) -> PyResult<Option<ImportItem>> {
+        py.detach(|| self.next_batch())
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    /// Stop waiting for the batches still in flight and submit no more.
+    fn cancel(&mut self) {
+        for handle in &self.in_flight {
+            handle.cancel();
+        }
+        self.next_start = self.paths.len();
+    }
+
+    /// Number of paths in the stream.
+    #[getter]
+    fn total(&self) -> usize {
+        self.paths.len()
+    }
+
+    /// Paths whose batch has finished, successful or not.
+    #[getter]
+    fn completed(&self) -> usize {
+        self.completed
+    }
+
+    /// Paths whose batch command didn't go through; files the engine failed to import aren't counted.
+    #[getter]
+    fn command_failed(&self) -> usize {
+        self.command_failed
+    }
+}
@@ -1,69 +1,344 @@
 mod asset_sync_context;
 mod command_thread;
+mod content_hash;
 mod engine_api;
 mod engine_client; // This line remains unchanged
+mod engine_stats;
+mod import_stream;
+mod mesh_send_stream;
 mod mesh_sync_thread;
+mod parallel;
+mod pending_command;
+mod readiness;
+mod service_names;
+mod shards;
+mod slab_options;
+mod slab_table;
 mod tbo_export_context;
+mod tbo_file_stream;
+mod tbo_reader;
+mod trace;
+mod typed_buffer;
 extern crate iceoryx2_loggers;
 
+/// Rust entry points for the criterion benches in benches/, not part of the Python API
+#[doc(hidden)]
+pub mod bench_api {
+    pub use crate::asset_sync_context::AssetSyncContext;
+    pub use crate::engine_api::{
+        GroupNames, MeshSendInput, allocate_memory, attach_engine, drop_all_groups_command, drop_groups_command,
+        generate_uuid_bytes, organize_objects_command, set_command_coalescing, stop_engine, submit_drop_groups_command,
+        submit_tbo_flush_command, tbo_downsample_command,
+    };
+    pub use crate::service_names::ServiceNames;
+
+    use pivot_com_types::asset_ptr::AssetPtr;
+
+    /// Resolves `asset_ptrs` through shard 0's slab table like every alloc response and publish does,
+    /// returns how many were resolved
+    pub fn hydrate_ptrs(asset_ptrs: &[AssetPtr], root_handle: &[u8]) -> Result<usize, String> {
+        let _pin = crate::slab_table::SlabPin::new();
+        crate::engine_api::CLIENT.shard(0).hydrate_ptrs(asset_ptrs, root_handle).map(|ptrs| ptrs.len())
+    }
+}
+
 use pyo3::prelude::*;
 
 #[pymodule(name = "_elbo_sdk_rust")]
 mod elbo_sdk_rust {
     use crate::asset_sync_context::AssetSyncContext;
     use crate::engine_api;
+    use crate::engine_api::{GroupNames, MeshSendInput};
+    use crate::engine_stats::STATS;
+    use crate::import_stream::ImportStream;
+    use crate::mesh_send_stream::{MeshSendStream, OwnedGroupNames, OwnedMeshSendInput};
+    use crate::pending_command::{PendingCommand, ResponseKind};
+    use crate::slab_options::SlabMapOptions;
     use crate::tbo_export_context::TboExportContext;
+    use crate::tbo_file_stream::TboFileStream;
+    use crate::tbo_reader::TboReader;
+    use crate::trace;
+    use crate::typed_buffer::{RawBytes, TypedBuffer, contiguous_slice, record_slice};
     use pivot_com_types::fields::Uuid;
+    use pyo3::buffer::PyBuffer;
     use pyo3::prelude::*;
+    use pyo3::types::{PyDict, PyTuple};
     use std::path::PathBuf;
 
+    /// Spawn the engine.
+    ///
+    /// Args:
+    ///     wait: Block until the engine's command and mesh services are live
+    ///     timeout: Seconds to wait before giving up and tearing the engine down again
+    ///     instance: Run the engine's services under this id so other processes can attach to it
+    ///     persistent: Leave the engine running on stop_engine, for later attach_engine calls
+    ///     shards: Number of engine processes; groups are spread over them by UUID,
+    ///         each running as `<instance>-<n>` (or `shard-<n>` without an instance)
     #[pyfunction]
-    fn start_engine(_py: Python) -> PyResult<()> {
-        engine_api::start_engine()
+    #[pyo3(signature = (wait=false, timeout=30.0, instance=None, persistent=false, shards=1))]
+    fn start_engine(
+        py: Python,
+        wait: bool,
+        timeout: f64,
+        instance: Option<String>,
+        persistent: bool,
+        shards: usize,
+    ) -> PyResult<()> {
+        let _span = trace::span("start_engine");
+        let wait = if wait { Some(timeout_from_secs(timeout)?) } else { None };
+        py.detach(|| engine_api::start_engine(wait, instance, persistent, shards))
             .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()))
     }
 
+    /// Connect to an engine another process started, instead of spawning one.
+    ///
+    /// Blocks until its services are live. stop_engine afterwards only detaches,
+    /// the engine and its caches stay up for the next session. `shards` must match
+    /// the count the engines were started with.
+    ///
+    /// With several shards, groups an engine created itself (imports,
+    /// group_all_objects) are routed by this process' record of where they were
+    /// published. An attached session starts without that record, so such groups
+    /// go to their hash shard until they are published again, e.g. by
+    /// organize_objects_command or a mesh sync.
+    #[pyfunction]
+    #[pyo3(signature = (instance=None, timeout=30.0, shards=1))]
+    fn attach_engine(py: Python, instance: Option<String>, timeout: f64, shards: usize) -> PyResult<()> {
+        let _span = trace::span("attach_engine");
+        let timeout = timeout_from_secs(timeout)?;
+        py.detach(|| engine_api::attach_engine(instance, timeout, shards))
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    fn timeout_from_secs(secs: f64) -> PyResult<std::time::Duration> {
+        std::time::Duration::try_from_secs_f64(secs).map_err(|e| {
+            PyErr::new::<pyo3::exceptions::PyValueError, _>(format!("Invalid timeout: {}", e))
+        })
+    }
+
+    /// Per-call deadline of a blocking command, None keeps the set_command_timeout default
+    fn call_timeout(timeout: Option<f64>) -> PyResult<Option<std::time::Duration>> {
+        timeout.map(timeout_from_secs).transpose()
+    }
+
+    /// True once the engine's command and mesh services are both live (on every shard).
+    #[pyfunction]
+    fn is_engine_ready() -> bool {
+        engine_api::is_engine_ready()
+    }
+
+    /// Number of engine processes groups are spread over.
+    #[pyfunction]
+    fn get_engine_shard_count() -> usize {
+        engine_api::shard_count()
+    }
+
     #[pyfunction]
-    fn stop_engine(_py: Python) -> PyResult<()> {
-        engine_api::stop_engine()
+    fn stop_engine(py: Python) -> PyResult<()> {
+        let _span = trace::span("stop_engine");
+        py.detach(engine_api::stop_engine)
             .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()))
     }
 
     #[pyfunction]
+    #[pyo3(signature = (uuids, surface_contexts, timeout=None))]
     fn standardize_synced_groups_command(
-        _py: Python,
+        py: Python,
         uuids: Vec<Uuid>,
         surface_contexts: Vec<u32>,
-    ) -> () {
-        let _ = engine_api::standardize_synced_groups_command(uuids, surface_contexts)
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+        timeout: Option<f64>,
+    ) -> PyResult<()> {
+        let _span = trace::span("standardize_synced_groups_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::standardize_synced_groups_command(uuids, surface_contexts))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
     #[pyfunction]
+    #[pyo3(signature = (group_surface_map, timeout=None))]
     fn set_surface_types_command(
-        _py: Python,
+        py: Python,
         group_surface_map: std::collections::HashMap<Uuid, i64>,
-    ) -> () {
-        let _ = engine_api::set_surface_types_command(group_surface_map)
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+        timeout: Option<f64>,
+    ) -> PyResult<()> {
+        let _span = trace::span("set_surface_types_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::set_surface_types_command(group_surface_map))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    #[pyfunction]
+    #[pyo3(signature = (uuids, timeout=None))]
+    fn drop_groups_command(py: Python, uuids: Vec<Uuid>, timeout: Option<f64>) -> PyResult<()> {
+        let _span = trace::span("drop_groups_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::drop_groups_command(uuids))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
+    /// Bulk lane, ordered after earlier downsamples, exports and imports but not
+    /// after interactive-lane commands such as standardize_synced or set_surface_types.
     #[pyfunction]
-    fn drop_groups_command(_py: Python, uuids: Vec<Uuid>) -> () {
-        let _ = engine_api::drop_groups_command(uuids)
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+    fn submit_drop_groups_command(py: Python, uuids: Vec<Uuid>) -> PyResult<PendingCommand> {
+        let _span = trace::span("submit_drop_groups_command");
+        let handle = py.detach(|| engine_api::submit_drop_groups_command(uuids))
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+        Ok(PendingCommand::new(handle, ResponseKind::Ack))
+    }
+
+    /// Bulk lane, not ordered against interactive-lane commands on the same groups;
+    /// wait on an earlier send or set_surface_types before submitting this.
+    #[pyfunction]
+    fn submit_standardize_groups_command(py: Python, uuids: Vec<Uuid>) -> PyResult<PendingCommand> {
+        let _span = trace::span("submit_standardize_groups_command");
+        let handle = py.detach(|| engine_api::submit_standardize_groups_command(uuids))
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+        Ok(PendingCommand::new(handle, ResponseKind::Ack))
+    }
+
+    /// Interactive lane, can overtake earlier bulk-lane commands such as an import
+    /// that creates the groups; wait on those first.
+    #[pyfunction]
+    fn submit_standardize_synced_groups_command(
+        py: Python,
+        uuids: Vec<Uuid>,
+        surface_contexts: Vec<u32>,
+    ) -> PyResult<PendingCommand> {
+        let _span = trace::span("submit_standardize_synced_groups_command");
+        let handle = py.detach(|| engine_api::submit_standardize_synced_groups_command(uuids, surface_contexts))
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+        Ok(PendingCommand::new(handle, ResponseKind::Ack))
+    }
+
+    /// Interactive lane, can overtake earlier bulk-lane commands on the same groups.
+    #[pyfunction]
+    fn submit_set_surface_types_command(
+        py: Python,
+        group_surface_map: std::collections::HashMap<Uuid, i64>,
+    ) -> PyResult<PendingCommand> {
+        let _span = trace::span("submit_set_surface_types_command");
+        let handle = py.detach(|| engine_api::submit_set_surface_types_command(group_surface_map))
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+        Ok(PendingCommand::new(handle, ResponseKind::Ack))
     }
 
+    /// Bulk lane, can be overtaken by later interactive-lane commands; wait on
+    /// earlier sends of the same groups before downsampling them.
     #[pyfunction]
-    fn get_surface_types_command(_py: Python) -> () {
-        let _ = engine_api::get_surface_types_command()
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+    fn submit_tbo_downsample_command(py: Python, uuids: Vec<Uuid>) -> PyResult<PendingCommand> {
+        let _span = trace::span("submit_tbo_downsample_command");
+        let handle = py.detach(|| engine_api::submit_tbo_downsample_command(uuids))
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+        Ok(PendingCommand::new(handle, ResponseKind::TboDownsample))
     }
 
+    /// Bulk lane, ordered after earlier downsamples but not after interactive-lane
+    /// commands such as tbo_config; wait on those first.
     #[pyfunction]
-    fn organize_objects_command(_py: Python) -> () {
-        let _ = engine_api::organize_objects_command()
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+    fn submit_tbo_flush_command(
+        py: Python,
+        path: String,
+        target_bytes: u64,
+        batch_offset: u32,
+    ) -> PyResult<PendingCommand> {
+        let _span = trace::span("submit_tbo_flush_command");
+        let handle = py.detach(|| engine_api::submit_tbo_flush_command(&path, target_bytes, batch_offset))
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+        Ok(PendingCommand::new(handle, ResponseKind::TboFlush))
+    }
+
+    /// Bulk lane, not ordered against earlier interactive-lane sends still in flight.
+    #[pyfunction]
+    fn submit_export_all_asset_tbo_command(
+        py: Python,
+        path: String,
+        target_bytes: u64,
+        skip_normalization: bool,
+    ) -> PyResult<PendingCommand> {
+        let _span = trace::span("submit_export_all_asset_tbo_command");
+        let handle =
+            py.detach(|| engine_api::submit_export_all_asset_tbo_command(&path, target_bytes, skip_normalization))
+                .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+        Ok(PendingCommand::new(handle, ResponseKind::TboFlush))
+    }
+
+    /// Streaming variant of submit_tbo_flush_command.
+    ///
+    /// Iterate the returned stream to get (path, size_bytes) for every written
+    /// file. The output directory is watched while the flush runs, so each file
+    /// comes as soon as the engine has moved on to the next one and consumers can
+    /// start on it while the engine is still writing.
+    #[pyfunction]
+    fn stream_tbo_flush_command(
+        py: Python,
+        path: String,
+        target_bytes: u64,
+        batch_offset: u32,
+    ) -> PyResult<TboFileStream> {
+        let _span = trace::span("stream_tbo_flush_command");
+        py.detach(|| {
+            let output_dir = path.clone();
+            TboFileStream::start(path, || engine_api::submit_tbo_flush_command(&output_dir, target_bytes, batch_offset))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    /// Streaming variant of export_all_asset_tbo_command, yields (path, size_bytes)
+    /// per written file as it lands in the output directory.
+    #[pyfunction]
+    #[pyo3(signature = (path, target_bytes, skip_normalization=false))]
+    fn stream_export_all_asset_tbo_command(
+        py: Python,
+        path: String,
+        target_bytes: u64,
+        skip_normalization: bool,
+    ) -> PyResult<TboFileStream> {
+        let _span = trace::span("stream_export_all_asset_tbo_command");
+        py.detach(|| {
+            let output_dir = path.clone();
+            TboFileStream::start(path, || {
+                engine_api::submit_export_all_asset_tbo_command(&output_dir, target_bytes, skip_normalization)
+            })
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    /// Bulk lane, so interactive-lane commands on the imported groups can overtake
+    /// it; wait for the import before standardizing or setting surface types.
+    #[pyfunction]
+    fn submit_import_assets_command(py: Python, paths: Vec<String>) -> PyResult<PendingCommand> {
+        let _span = trace::span("submit_import_assets_command");
+        let handle = py.detach(|| engine_api::submit_import_assets_command(paths))
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+        Ok(PendingCommand::new(handle, ResponseKind::Ack))
+    }
+
+    #[pyfunction]
+    #[pyo3(signature = (timeout=None))]
+    fn get_surface_types_command(py: Python, timeout: Option<f64>) -> PyResult<()> {
+        let _span = trace::span("get_surface_types_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::get_surface_types_command())
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    #[pyfunction]
+    #[pyo3(signature = (timeout=None))]
+    fn organize_objects_command(py: Python, timeout: Option<f64>) -> PyResult<()> {
+        let _span = trace::span("organize_objects_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::organize_objects_command())
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
     #[pyfunction]
@@ -78,8 +353,9 @@ mod elbo_sdk_rust {
     }
 
     #[pyfunction]
-    fn poll_mesh_sync() -> PyResult<Option<AssetSyncContext>> {
-        let context = match engine_api::poll_mesh_sync() {
+    fn poll_mesh_sync(py: Python) -> PyResult<Option<AssetSyncContext>> {
+        let _span = trace::span("poll_mesh_sync");
+        let context = match py.detach(engine_api::poll_mesh_sync) {
             Ok(Some(slices)) => slices,
             Ok(None) => return Ok(None),
             Err(e) => {
@@ -92,8 +368,259 @@ mod elbo_sdk_rust {
         Ok(Some(context))
     }
 
+    /// Drain every pending mesh publish into one merged AssetSyncContext (None if nothing arrived).
+    #[pyfunction]
+    fn poll_mesh_sync_all(py: Python) -> PyResult<Option<AssetSyncContext>> {
+        let _span = trace::span("poll_mesh_sync_all");
+        py.detach(engine_api::poll_mesh_sync_all)
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    /// File descriptor that is readable while mesh publishes are waiting.
+    ///
+    /// Register it with selectors/asyncio (loop.add_reader) and call poll_mesh_sync_all
+    /// when it fires instead of polling from a timer. Stays valid across engine restarts.
+    #[pyfunction]
+    fn mesh_sync_fd() -> PyResult<i32> {
+        #[cfg(unix)]
+        {
+            Ok(engine_api::mesh_sync_fd())
+        }
+        #[cfg(not(unix))]
+        {
+            Err(PyErr::new::<pyo3::exceptions::PyNotImplementedError, _>(
+                "mesh_sync_fd is only available on unix platforms",
+            ))
+        }
+    }
+
+    /// Cap the number of queued mesh publishes (0 = unbounded). Takes effect on the next start_engine.
+    ///
+    /// A full queue stops the SDK from draining the engine. If the engine's service overwrites
+    /// on overflow, the oldest queued publish is dropped instead and counted as
+    /// mesh_publishes_dropped in get_engine_stats().
+    #[pyfunction]
+    fn set_mesh_queue_capacity(capacity: usize) {
+        engine_api::set_mesh_queue_capacity(capacity);
+    }
+
+    /// Snapshot of the IPC counters and per-command latency histograms.
+    ///
+    /// Histograms hold log2 microsecond buckets for each stage (queue_wait, loan, send, response)
+    /// keyed by command name; only commands that ran since the last reset are listed.
+    #[pyfunction]
+    fn get_engine_stats<'py>(py: Python<'py>) -> PyResult<Bound<'py, PyDict>> {
+        let (command_queue_len, mesh_queue_len) = engine_api::queue_lengths();
+        STATS.snapshot(py, command_queue_len, mesh_queue_len, engine_api::mapped_slab_count())
+    }
+
+    /// Clear the counters and histograms returned by get_engine_stats.
     #[pyfunction]
+    fn reset_engine_stats() {
+        STATS.reset();
+    }
+
+    /// Start recording spans into the trace ring buffer.
+    ///
+    /// Covers the SDK pyfunctions, every command from queueing to response (keyed by request id),
+    /// forwarded mesh publishes and the TboExportContext phases. The oldest spans are overwritten once full.
+    #[pyfunction]
+    fn enable_tracing() {
+        trace::enable();
+    }
+
+    #[pyfunction]
+    fn disable_tracing() {
+        trace::disable();
+    }
+
+    /// Write the recorded spans as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+    ///
+    /// Returns:
+    ///     Number of spans written
+    #[pyfunction]
+    #[pyo3(signature = (path, clear=true))]
+    fn dump_trace(py: Python, path: String, clear: bool) -> PyResult<usize> {
+        let written = py.detach(|| trace::dump(&path))
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+        if clear {
+            trace::clear();
+        }
+        Ok(written)
+    }
+
+    /// Page settings for the engine slabs mapped into this process.
+    ///
+    /// Args:
+    ///     huge_pages: Request transparent huge pages (needs shmem THP set to advise/always)
+    ///     populate: Fault each slab in when it is mapped instead of on the first buffer write
+    ///     numa_node: Bind slab pages to this NUMA node (Linux only)
+    ///
+    /// Applies to slabs already mapped and to every slab mapped afterwards.
+    #[pyfunction]
+    #[pyo3(signature = (huge_pages=false, populate=false, numa_node=None))]
+    fn set_slab_map_options(py: Python, huge_pages: bool, populate: bool, numa_node: Option<u32>) {
+        let options = SlabMapOptions {
+            huge_pages,
+            populate,
+            numa_node,
+        };
+        py.detach(|| engine_api::set_slab_map_options(options));
+    }
+
+    /// Unmap slabs the engine retired and, with advise, drop this process' pages of the others.
+    ///
+    /// drop_all_groups_command only unmaps retired slabs; call this with advise=True
+    /// to also shrink RSS, at the cost of faulting the pages in again on the next fill.
+    /// Skipped (deferred=True) while any AssetSyncContext or view of its buffers is
+    /// still alive, since they point into the slabs.
+    #[pyfunction]
+    #[pyo3(signature = (advise=true))]
+    fn reclaim_slab_memory<'py>(py: Python<'py>, advise: bool) -> PyResult<Bound<'py, PyDict>> {
+        let stats = py.detach(|| engine_api::reclaim_slabs(advise));
+        let dict = PyDict::new(py);
+        dict.set_item("unmapped_slabs", stats.unmapped_slabs)?;
+        dict.set_item("unmapped_bytes", stats.unmapped_bytes)?;
+        dict.set_item("advised_bytes", stats.advised_bytes)?;
+        dict.set_item("deferred", stats.deferred)?;
+        Ok(dict)
+    }
+
+    /// Touch every page of new allocations while prepare_mesh_send writes their metadata,
+    /// moving the page faults off the Python fill loop. Off by default.
+    #[pyfunction]
+    fn set_prefault_allocations(enabled: bool) {
+        engine_api::set_prefault_allocations(enabled);
+    }
+
+    /// Content hash of one asset's source arrays, for prepare_mesh_send(content_hashes=...).
+    ///
+    /// Takes any C-contiguous buffers (numpy arrays, memoryviews, bytes) and hashes
+    /// their raw bytes in order, so pass every array that ends up in the asset,
+    /// plus anything else that should force a resend when it changes.
+    #[pyfunction]
+    #[pyo3(signature = (*buffers))]
+    fn content_hash(py: Python, buffers: &Bound<'_, PyTuple>) -> PyResult<u64> {
+        let raw: Vec<RawBytes> = buffers.iter().map(|buffer| RawBytes::get(&buffer)).collect::<PyResult<_>>()?;
+        let fields: Vec<&[u8]> = raw.iter().map(RawBytes::as_slice).collect();
+        // The pyfunction shadows the module name here
+        Ok(py.detach(|| crate::content_hash::hash_fields(&fields)))
+    }
+
+    /// Forget the content hashes prepare_mesh_send(content_hashes=...) compares against,
+    /// so the next incremental prepare allocates these assets again (every asset when uuids
+    /// is None). Needed when the engine's copy changed behind the SDK's back; drops,
+    /// restarts and mesh publishes already forget on their own.
+    #[pyfunction]
+    #[pyo3(signature = (uuids=None))]
+    fn forget_content_hashes(uuids: Option<Vec<Uuid>>) {
+        engine_api::forget_content_hashes(uuids.as_deref());
+    }
+
+    /// Merge runs of queued drop_groups, standardize_groups, set_surface_types and
+    /// standardize_synced_groups commands into one engine request each. Only commands
+    /// queued back to back are merged, so ordering against other commands is kept.
+    /// Every merged caller gets the shared result; an error fails all of them. Off by default.
+    ///
+    /// Without a linger only commands already queued are merged, so use the submit_*
+    /// variants to queue several before waiting. A linger (seconds) holds a run that
+    /// emptied the queue that much longer for more commands of its kind, which also
+    /// merges blocking calls made from several threads.
+    #[pyfunction]
+    #[pyo3(signature = (enabled, linger=0.0))]
+    fn set_command_coalescing(enabled: bool, linger: f64) -> PyResult<()> {
+        engine_api::set_command_coalescing(enabled, timeout_from_secs(linger)?);
+        Ok(())
+    }
+
+    /// Declare the optional engine features the engines support, e.g. ["experimental_tbo_encodings"].
+    ///
+    /// The engine can't report them, so nothing relying on one is sent until it has been
+    /// declared. Replaces the previous declaration.
+    #[pyfunction]
+    fn set_engine_capabilities(capabilities: Vec<String>) -> PyResult<()> {
+        engine_api::set_engine_capabilities(&capabilities)
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyValueError, _>(e))
+    }
+
+    /// Deadline for every command queued afterwards, in seconds. A command that gets no
+    /// response in time fails with a timeout error and its engine request is abandoned.
+    /// None waits forever (the default).
+    #[pyfunction]
+    #[pyo3(signature = (timeout=None))]
+    fn set_command_timeout(timeout: Option<f64>) -> PyResult<()> {
+        let timeout = timeout
+            .map(|secs| {
+                std::time::Duration::try_from_secs_f64(secs).map_err(|e| {
+                    PyErr::new::<pyo3::exceptions::PyValueError, _>(format!("Invalid timeout: {}", e))
+                })
+            })
+            .transpose()?;
+        engine_api::set_command_timeout(timeout);
+        Ok(())
+    }
+
+    /// Liveness of every engine shard, for telling a busy engine from a dead or wedged one.
+    ///
+    /// A shard counts as stalled when a request has been pending for `stall_after` seconds
+    /// without the engine answering anything in between. Returns a dict with `healthy` and
+    /// a `shards` list holding instance, ready, process_alive (None for attached engines),
+    /// threads_alive, oldest_pending, since_last_response and stalled.
+    #[pyfunction]
+    #[pyo3(signature = (stall_after=10.0))]
+    fn engine_health<'py>(py: Python<'py>, stall_after: f64) -> PyResult<Bound<'py, PyDict>> {
+        let secs = |d: Option<std::time::Duration>| d.map(|d| d.as_secs_f64());
+        let shards = pyo3::types::PyList::empty(py);
+        let mut healthy = true;
+
+        for health in engine_api::engine_health() {
+            let entry = PyDict::new(py);
+            match health {
+                Some(health) => {
+                    let stalled = match (health.oldest_pending, health.since_last_response) {
+                        (Some(pending), last) => {
+                            pending.as_secs_f64() >= stall_after
+                                && last.map_or(true, |last| last.as_secs_f64() >= stall_after)
+                        }
+                        (None, _) => false,
+                    };
+                    healthy &= health.ready
+                        && health.threads_alive
+                        && health.process_alive != Some(false)
+                        && !stalled;
+
+                    entry.set_item("instance", health.instance)?;
+                    entry.set_item("ready", health.ready)?;
+                    entry.set_item("process_alive", health.process_alive)?;
+                    entry.set_item("threads_alive", health.threads_alive)?;
+                    entry.set_item("oldest_pending", secs(health.oldest_pending))?;
+                    entry.set_item("since_last_response", secs(health.since_last_response))?;
+                    entry.set_item("stalled", stalled)?;
+                }
+                None => {
+                    healthy = false;
+                    entry.set_item("ready", false)?;
+                }
+            }
+            shards.append(entry)?;
+        }
+
+        let dict = PyDict::new(py);
+        dict.set_item("healthy", healthy && !shards.is_empty())?;
+        dict.set_item("shards", shards)?;
+        Ok(dict)
+    }
+
+    /// Allocate engine memory for the assets and return the context to fill and send.
+    ///
+    /// With content_hashes (one content_hash() per asset) assets whose hash matches
+    /// what was last sent for their uuid are not allocated at all and the engine keeps
+    /// its copy; the returned context only holds the changed assets, see its uuids().
+    /// When none changed it is empty and neither preparing nor sending it reaches an engine.
+    #[pyfunction]
+    #[pyo3(signature = (vert_counts, edge_counts, loop_counts, total_loop_lengths, object_counts, group_names, surface_contexts, asset_uuids, content_hashes=None))]
     fn prepare_mesh_send(
+        py: Python,
         vert_counts: Vec<u32>,
         edge_counts: Vec<u32>,
         loop_counts: Vec<u32>,
@@ -102,26 +629,167 @@ mod elbo_sdk_rust {
         group_names: Vec<String>,
         surface_contexts: Vec<u16>,
         asset_uuids: Vec<Uuid>,
+        content_hashes: Option<Vec<u64>>,
     ) -> PyResult<AssetSyncContext> {
-        let context = engine_api::allocate_memory(
+        let _span = trace::span("prepare_mesh_send");
+        let input = MeshSendInput {
+            vert_counts: &vert_counts,
+            edge_counts: &edge_counts,
+            loop_counts: &loop_counts,
+            total_loop_lengths: &total_loop_lengths,
+            object_counts: &object_counts,
+            group_names: GroupNames::List(&group_names),
+            surface_contexts: &surface_contexts,
+            asset_uuids: &asset_uuids,
+        };
+
+        let context = py
+            .detach(|| match &content_hashes {
+                Some(hashes) => engine_api::allocate_changed(&input, hashes),
+                None => engine_api::allocate_memory(&input),
+            })
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()))?;
+
+        Ok(context)
+    }
+
+    /// Streaming variant of prepare_mesh_send for scenes too large for one allocation.
+    ///
+    /// Splits the assets into chunks of chunk_size and keeps up to max_in_flight
+    /// alloc requests outstanding. Iterate the returned stream to get one
+    /// AssetSyncContext per chunk, in order, as soon as it is allocated.
+    #[pyfunction]
+    #[pyo3(signature = (vert_counts, edge_counts, loop_counts, total_loop_lengths, object_counts, group_names, surface_contexts, asset_uuids, chunk_size=4096, max_in_flight=2))]
+    fn prepare_mesh_send_stream(
+        vert_counts: Vec<u32>,
+        edge_counts: Vec<u32>,
+        loop_counts: Vec<u32>,
+        total_loop_lengths: Vec<u32>,
+        object_counts: Vec<u32>,
+        group_names: Vec<String>,
+        surface_contexts: Vec<u16>,
+        asset_uuids: Vec<Uuid>,
+        chunk_size: usize,
+        max_in_flight: usize,
+    ) -> PyResult<MeshSendStream> {
+        let _span = trace::span("prepare_mesh_send_stream");
+        let input = OwnedMeshSendInput {
             vert_counts,
             edge_counts,
             loop_counts,
             total_loop_lengths,
             object_counts,
-            group_names,
+            group_names: OwnedGroupNames::List(group_names),
             surface_contexts,
             asset_uuids,
-        )
-        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()))?;
+        };
+        MeshSendStream::new(input, chunk_size, max_in_flight)
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyValueError, _>(e))
+    }
+
+    /// Buffer variant of prepare_mesh_send_stream, takes the inputs of prepare_mesh_send_buffers.
+    ///
+    /// The buffers are copied once, the stream outlives the call and keeps
+    /// reading them as it submits chunks.
+    #[pyfunction]
+    #[pyo3(signature = (vert_counts, edge_counts, loop_counts, total_loop_lengths, object_counts, group_names, group_name_offsets, surface_contexts, asset_uuids, chunk_size=4096, max_in_flight=2))]
+    fn prepare_mesh_send_buffers_stream(
+        vert_counts: PyBuffer<u32>,
+        edge_counts: PyBuffer<u32>,
+        loop_counts: PyBuffer<u32>,
+        total_loop_lengths: PyBuffer<u32>,
+        object_counts: PyBuffer<u32>,
+        group_names: PyBuffer<u8>,
+        group_name_offsets: PyBuffer<u32>,
+        surface_contexts: PyBuffer<u16>,
+        asset_uuids: PyBuffer<u8>,
+        chunk_size: usize,
+        max_in_flight: usize,
+    ) -> PyResult<MeshSendStream> {
+        let _span = trace::span("prepare_mesh_send_buffers_stream");
+        let input = OwnedMeshSendInput {
+            vert_counts: contiguous_slice(&vert_counts, "vert_counts")?.to_vec(),
+            edge_counts: contiguous_slice(&edge_counts, "edge_counts")?.to_vec(),
+            loop_counts: contiguous_slice(&loop_counts, "loop_counts")?.to_vec(),
+            total_loop_lengths: contiguous_slice(&total_loop_lengths, "total_loop_lengths")?.to_vec(),
+            object_counts: contiguous_slice(&object_counts, "object_counts")?.to_vec(),
+            group_names: OwnedGroupNames::Packed {
+                bytes: contiguous_slice(&group_names, "group_names")?.to_vec(),
+                offsets: contiguous_slice(&group_name_offsets, "group_name_offsets")?.to_vec(),
+            },
+            surface_contexts: contiguous_slice(&surface_contexts, "surface_contexts")?.to_vec(),
+            asset_uuids: record_slice::<Uuid>(
+                contiguous_slice(&asset_uuids, "asset_uuids")?,
+                "asset_uuids",
+            )?
+            .to_vec(),
+        };
+        MeshSendStream::new(input, chunk_size, max_in_flight)
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyValueError, _>(e))
+    }
+
+    /// Buffer variant of prepare_mesh_send, reads numpy/array/bytes inputs in place.
+    ///
+    /// Counts are u32 buffers, surface_contexts a u16 buffer, asset_uuids one packed
+    /// buffer of 32-byte UUIDs, and group names one UTF-8 buffer sliced by
+    /// group_name_offsets (u32, one more entry than there are assets). content_hashes
+    /// is an optional u64 buffer, skipping unchanged assets like prepare_mesh_send.
+    #[pyfunction]
+    #[pyo3(signature = (vert_counts, edge_counts, loop_counts, total_loop_lengths, object_counts, group_names, group_name_offsets, surface_contexts, asset_uuids, content_hashes=None))]
+    fn prepare_mesh_send_buffers(
+        py: Python,
+        vert_counts: PyBuffer<u32>,
+        edge_counts: PyBuffer<u32>,
+        loop_counts: PyBuffer<u32>,
+        total_loop_lengths: PyBuffer<u32>,
+        object_counts: PyBuffer<u32>,
+        group_names: PyBuffer<u8>,
+        group_name_offsets: PyBuffer<u32>,
+        surface_contexts: PyBuffer<u16>,
+        asset_uuids: PyBuffer<u8>,
+        content_hashes: Option<PyBuffer<u64>>,
+    ) -> PyResult<AssetSyncContext> {
+        let _span = trace::span("prepare_mesh_send_buffers");
+        let hashes = match &content_hashes {
+            Some(buffer) => Some(contiguous_slice(buffer, "content_hashes")?),
+            None => None,
+        };
+        let input = MeshSendInput {
+            vert_counts: contiguous_slice(&vert_counts, "vert_counts")?,
+            edge_counts: contiguous_slice(&edge_counts, "edge_counts")?,
+            loop_counts: contiguous_slice(&loop_counts, "loop_counts")?,
+            total_loop_lengths: contiguous_slice(&total_loop_lengths, "total_loop_lengths")?,
+            object_counts: contiguous_slice(&object_counts, "object_counts")?,
+            group_names: GroupNames::Packed {
+                bytes: contiguous_slice(&group_names, "group_names")?,
+                offsets: contiguous_slice(&group_name_offsets, "group_name_offsets")?,
+            },
+            surface_contexts: contiguous_slice(&surface_contexts, "surface_contexts")?,
+            asset_uuids: record_slice::<Uuid>(
+                contiguous_slice(&asset_uuids, "asset_uuids")?,
+                "asset_uuids",
+            )?,
+        };
+
+        let context = py
+            .detach(|| match hashes {
+                Some(hashes) => engine_api::allocate_changed(&input, hashes),
+                None => engine_api::allocate_memory(&input),
+            })
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
 
         Ok(context)
     }
 
     #[pyfunction]
-    fn standardize_groups_command(_py: Python, uuids: Vec<Uuid>) -> () {
-        let _ = engine_api::standardize_groups_command(uuids)
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+    #[pyo3(signature = (uuids, timeout=None))]
+    fn standardize_groups_command(py: Python, uuids: Vec<Uuid>, timeout: Option<f64>) -> PyResult<()> {
+        let _span = trace::span("standardize_groups_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::standardize_groups_command(uuids))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
     #[pyfunction]
@@ -135,77 +803,144 @@ mod elbo_sdk_rust {
     }
 
     #[pyfunction]
+    #[pyo3(signature = (path, target_bytes, uuids, timeout=None))]
     fn export_assets_command(
-        _py: Python,
+        py: Python,
         path: String,
         target_bytes: u64,
         uuids: Vec<Uuid>,
-    ) -> () {
-        let _ = engine_api::export_assets_command(&path, target_bytes, uuids)
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+        timeout: Option<f64>,
+    ) -> PyResult<()> {
+        let _span = trace::span("export_assets_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::export_assets_command(&path, target_bytes, uuids))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
     #[pyfunction]
-    fn export_all_command(_py: Python, path: String, target_bytes: u64) -> () {
-        let _ = engine_api::export_all_command(&path, target_bytes)
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+    #[pyo3(signature = (path, target_bytes, timeout=None))]
+    fn export_all_command(py: Python, path: String, target_bytes: u64, timeout: Option<f64>) -> PyResult<()> {
+        let _span = trace::span("export_all_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::export_all_command(&path, target_bytes))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
     #[pyfunction]
+    #[pyo3(signature = (path, target_bytes, uuids, timeout=None))]
     fn export_asset_tbo_command(
-        _py: Python,
+        py: Python,
         path: String,
         target_bytes: u64,
         uuids: Vec<Uuid>,
-    ) -> () {
-        let _ = engine_api::export_asset_tbo_command(&path, target_bytes, uuids)
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+        timeout: Option<f64>,
+    ) -> PyResult<()> {
+        let _span = trace::span("export_asset_tbo_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::export_asset_tbo_command(&path, target_bytes, uuids))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
     #[pyfunction]
+    #[pyo3(signature = (path, target_bytes, skip_normalization, timeout=None))]
     fn export_all_asset_tbo_command(
+        py: Python,
         path: String,
         target_bytes: u64,
         skip_normalization: bool,
+        timeout: Option<f64>,
     ) -> PyResult<Vec<String>> {
-        let resp = engine_api::export_all_asset_tbo_command(&path, target_bytes, skip_normalization)
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
-        let filenames = resp.read_tbo_flush()
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
-                format!("Failed to read flush response: {}", e),
-            ))?;
-        let result: Vec<String> = filenames.into_iter().map(|s| s.to_string()).collect();
-        Ok(result)
+        let _span = trace::span("export_all_asset_tbo_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::export_all_asset_tbo_command(&path, target_bytes, skip_normalization))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    #[pyfunction]
+    #[pyo3(signature = (timeout=None))]
+    fn drop_all_groups_command(py: Python, timeout: Option<f64>) -> PyResult<()> {
+        let _span = trace::span("drop_all_groups_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::drop_all_groups_command())
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
     #[pyfunction]
-    fn drop_all_groups_command(_py: Python) -> () {
-        let _ = engine_api::drop_all_groups_command()
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+    #[pyo3(signature = (paths, timeout=None))]
+    fn import_assets_command(py: Python, paths: Vec<String>, timeout: Option<f64>) -> PyResult<()> {
+        let _span = trace::span("import_assets_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::import_assets_command(paths))
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
+    /// Streaming variant of import_assets_command for large libraries.
+    ///
+    /// Imports batch_size files per engine command with up to max_in_flight
+    /// commands outstanding, spread over the engine shards. Iterate the returned
+    /// stream to get (paths, command_error, assets) per batch as soon as its engine
+    /// answers. command_error only reports commands that didn't go through (transport
+    /// errors, timeouts, cancels); the engine doesn't report files it failed to import.
+    /// With deliver_assets each item also carries every mesh sync publish received
+    /// so far. Publishes can't be told apart by command, so that includes ones from
+    /// other work on the engines; leave it off when another loop already polls mesh sync.
     #[pyfunction]
-    fn import_assets_command(_py: Python, paths: Vec<String>) -> () {
-        let _ = engine_api::import_assets_command(paths)
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+    #[pyo3(signature = (paths, batch_size=1, max_in_flight=4, deliver_assets=false))]
+    fn import_assets_stream(
+        paths: Vec<String>,
+        batch_size: usize,
+        max_in_flight: usize,
+        deliver_assets: bool,
+    ) -> PyResult<ImportStream> {
+        let _span = trace::span("import_assets_stream");
+        ImportStream::new(paths, batch_size, max_in_flight, deliver_assets)
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyValueError, _>(e))
     }
 
     #[pymodule_init]
     fn pyinit(m: &Bound<'_, PyModule>) -> PyResult<()> {
         m.add_class::<TboExportContext>()?;
+        m.add_class::<PendingCommand>()?;
+        m.add_class::<TypedBuffer>()?;
+        m.add_class::<MeshSendStream>()?;
+        m.add_class::<TboFileStream>()?;
+        m.add_class::<TboReader>()?;
+        m.add_class::<ImportStream>()?;
         Ok(())
     }
 
     #[pyfunction]
-    fn group_all_objects_command(_py: Python) -> () {
-        let _ = engine_api::group_all_objects_command()
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+    #[pyo3(signature = (timeout=None))]
+    fn group_all_objects_command(py: Python, timeout: Option<f64>) -> PyResult<()> {
+        let _span = trace::span("group_all_objects_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::group_all_objects_command())
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
     #[pyfunction]
-    fn embed_all_assets_command(_py: Python) -> () {
-        let _ = engine_api::embed_all_assets_command()
-            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e.to_string()));
+    #[pyo3(signature = (timeout=None))]
+    fn embed_all_assets_command(py: Python, timeout: Option<f64>) -> PyResult<()> {
+        let _span = trace::span("embed_all_assets_command");
+        let timeout = call_timeout(timeout)?;
+        py.detach(|| {
+            engine_api::with_call_timeout(timeout, || engine_api::embed_all_assets_command())
+        })
+        .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
     }
 
   }
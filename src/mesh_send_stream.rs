@@ -0,0 +1,159 @@
+//! Chunked allocation for scenes too large for a single alloc_request.
+//!
+//! The scene is split into fixed-size chunks and up to `max_in_flight`
+//! alloc_requests stay outstanding, so Python can fill chunk K while the
+//! engine is still allocating chunk K+1. Chunks still in flight when the
+//! stream is closed or dropped are sent back as empty assets, otherwise the
+//! engine would keep their allocations for a send that never comes.
+
+use pivot_com_types::fields::Uuid;
+use pyo3::prelude::*;
+use std::collections::VecDeque;
+
+use crate::asset_sync_context::AssetSyncContext;
+use crate::engine_api::{self, AllocChunk, GroupNames, MeshSendInput};
+
+/// Owned group names, as a list or packed into one buffer with offsets like GroupNames
+pub enum OwnedGroupNames {
+    List(Vec<String>),
+    Packed { bytes: Vec<u8>, offsets: Vec<u32> },
+}
+
+/// Owned copy of the prepare_mesh_send arguments, chunks borrow from it as they are submitted
+pub struct OwnedMeshSendInput {
+    pub vert_counts: Vec<u32>,
+    pub edge_counts: Vec<u32>,
+    pub loop_counts: Vec<u32>,
+    pub total_loop_lengths: Vec<u32>,
+    pub object_counts: Vec<u32>,
+    pub group_names: OwnedGroupNames,
+    pub surface_contexts: Vec<u16>,
+    pub asset_uuids: Vec<Uuid>,
+}
+
+impl OwnedMeshSendInput {
+    fn as_input(&self) -> MeshSendInput<'_> {
+        MeshSendInput {
+            vert_counts: &self.vert_counts,
+            edge_counts: &self.edge_counts,
+            loop_counts: &self.loop_counts,
+            total_loop_lengths: &self.total_loop_lengths,
+            object_counts: &self.object_counts,
+            group_names: match &self.group_names {
+                OwnedGroupNames::List(names) => GroupNames::List(names),
+                OwnedGroupNames::Packed { bytes, offsets } => GroupNames::Packed { bytes, offsets },
+            },
+            surface_contexts: &self.surface_contexts,
+            asset_uuids: &self.asset_uuids,
+        }
+    }
+}
+
+#[pyclass(unsendable)]
+pub struct MeshSendStream {
+    input: OwnedMeshSendInput,
+    count: usize,
+    chunk_size: usize,
+    max_in_flight: usize,
+    /// First asset not yet submitted
+    next_start: usize,
+    in_flight: VecDeque<AllocChunk>,
+}
+
+impl MeshSendStream {
+    pub fn new(input: OwnedMeshSendInput, chunk_size: usize, max_in_flight: usize) -> Result<MeshSendStream, String> {
+        if chunk_size == 0 {
+            return Err("chunk_size must be at least 1".to_string());
+        }
+        let count = input.as_input().validate()?;
+
+        Ok(MeshSendStream {
+            input,
+            count,
+            chunk_size,
+            max_in_flight: max_in_flight.max(1),
+            next_start: 0,
+            in_flight: VecDeque::new(),
+        })
+    }
+
+    /// Submits chunks until the in-flight window is full or every asset has been requested
+    fn top_up(&mut self) -> Result<(), String> {
+        while self.in_flight.len() < self.max_in_flight && self.next_start < self.count {
+            let end = (self.next_start + self.chunk_size).min(self.count);
+            let chunk = engine_api::submit_alloc_chunk(&self.input.as_input(), self.next_start..end)?;
+            self.in_flight.push_back(chunk);
+            self.next_start = end;
+        }
+        Ok(())
+    }
+
+    /// Next allocated chunk in submission order, None once the scene is exhausted
+    fn next_chunk(&mut self) -> Result<Option<AssetSyncContext>, String> {
+        self.top_up()?;
+
+        let chunk = match self.in_flight.pop_front() {
+            Some(chunk) => chunk,
+            None => return Ok(None),
+        };
+        let context = engine_api::complete_alloc_chunk(&self.input.as_input(), chunk)?;
+
+        // Keep the engine busy with the following chunks while Python fills this one
+        self.top_up()?;
+        Ok(Some(context))
+    }
+
+    /// Submits nothing more and returns the allocations of every chunk still in flight
+    fn release(&mut self) -> Result<(), String> {
+        self.next_start = self.count;
+
+        let mut first_error = None;
+        while let Some(chunk) = self.in_flight.pop_front() {
+            if let Err(e) = engine_api::release_alloc_chunk(&self.input.as_input(), chunk) {
+                first_error.get_or_insert(e);
+            }
+        }
+        first_error.map_or(Ok(()), Err)
+    }
+}
+
+impl Drop for MeshSendStream {
+    fn drop(&mut self) {
+        if let Err(e) = self.release() {
+            println!("{:?}", e);
+        }
+    }
+}
+
+#[pymethods]
+impl MeshSendStream {
+    fn __iter__(slf: PyRef<'_, Self>) -> PyRef<'_, Self> {
+        slf
+    }
+
+    /// Blocks until the next chunk is allocated and returns its AssetSyncContext.
+    fn __next__(&mut self, py: Python) -> PyResult<Option<AssetSyncContext>> {
+        py.detach(|| self.next_chunk())
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    /// Stop the stream and hand the chunks allocated ahead back to the engine as empty assets.
+    ///
+    /// Called on drop too; call it explicitly to release them at a known point and see errors.
+    fn close(&mut self, py: Python) -> PyResult<()> {
+        py.detach(|| self.release())
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    /// Number of chunks the scene is split into.
+    #[getter]
+    fn chunk_count(&self) -> usize {
+        self.count.div_ceil(self.chunk_size)
+    }
+
+    /// Total number of assets in the stream.
+    #[getter]
+    fn asset_count(&self) -> usize {
+        self.count
+    }
+}
@@ -1,54 +1,127 @@
 use std::{
+    io::{Read, Write},
     sync::{
-        Arc,
+        Arc, Mutex,
         atomic::{AtomicBool, Ordering},
     },
     thread,
     time::Duration,
 };
-const MESH_UPDATES_SERVICE_NAME: &str = "PivotEngine/MeshUpdates";
-const NOTIFICATIONS_SERVICE_NAME: &str = "PivotEngine/Notifications";
 
 use crossbeam::channel;
 use iceoryx2::prelude::*;
 use pivot_com_types::MeshPublish;
 
+use crate::engine_stats::STATS;
+use crate::readiness::{DiscoveryBackoff, MESH_SERVICES, ReadyLatch};
+use crate::service_names::ServiceNames;
+use crate::trace;
+
+/// How long a forward blocks on a full queue before rechecking shutdown
+const FORWARD_RETRY_TIMEOUT: Duration = Duration::from_millis(200);
+
+/// Readiness notification for the mesh update queue.
+///
+/// Backed by a pipe whose read end becomes readable while publishes are waiting,
+/// so Python can sleep in select/asyncio instead of busy-polling poll_mesh_sync.
+/// At most one byte is ever in the pipe: `raise` writes on the clear -> raised edge
+/// and `clear` consumes it before the queue is drained.
+#[derive(Debug)]
+pub struct MeshSyncSignal {
+    reader: Mutex<std::io::PipeReader>,
+    writer: Mutex<std::io::PipeWriter>,
+    raised: AtomicBool,
+}
+
+impl MeshSyncSignal {
+    pub fn new() -> std::io::Result<Self> {
+        let (reader, writer) = std::io::pipe()?;
+        Ok(MeshSyncSignal {
+            reader: Mutex::new(reader),
+            writer: Mutex::new(writer),
+            raised: AtomicBool::new(false),
+        })
+    }
+
+    /// Marks the queue as having data, call after the publish is queued
+    pub fn raise(&self) {
+        if !self.raised.swap(true, Ordering::AcqRel) {
+            let _ = self.writer.lock().unwrap().write_all(&[1]);
+        }
+    }
+
+    /// Resets readiness, call before draining so publishes queued afterwards raise it again
+    pub fn clear(&self) {
+        if self.raised.swap(false, Ordering::AcqRel) {
+            // The raiser may not have written yet, in which case this waits the few instructions until it does
+            let mut byte = [0u8; 1];
+            let _ = self.reader.lock().unwrap().read_exact(&mut byte);
+        }
+    }
+
+    #[cfg(unix)]
+    pub fn fd(&self) -> std::os::fd::RawFd {
+        use std::os::fd::AsRawFd;
+        self.reader.lock().unwrap().as_raw_fd()
+    }
+}
+
 pub fn spawn_mesh_sync_thread(
     node: Arc<Node<ipc::Service>>,
+    names: Arc<ServiceNames>,
     shutdown: Arc<AtomicBool>,
     mesh_update_tx: channel::Sender<MeshPublish>,
+    mesh_update_rx: channel::Receiver<MeshPublish>,
+    signal: Arc<MeshSyncSignal>,
+    ready: Arc<ReadyLatch>,
 ) -> std::thread::JoinHandle<()> {
     thread::spawn(move || {
+        trace::set_thread_name("mesh_sync");
+
         // 1. Create independent ports for this thread
         // This ensures we never compete with send_command for a Mutex.
 
-        let (subscriber, listener) = loop {
+        let mut discovery = DiscoveryBackoff::new();
+        let (subscriber, listener, overflow) = loop {
+            if shutdown.load(Ordering::Relaxed) {
+                return;
+            }
+
             let sub_service = node
-                .service_builder(&MESH_UPDATES_SERVICE_NAME.try_into().unwrap())
+                .service_builder(&names.mesh_updates.as_str().try_into().unwrap())
                 .publish_subscribe::<MeshPublish>()
                 .open();
 
             let event_service = node
-                .service_builder(&NOTIFICATIONS_SERVICE_NAME.try_into().unwrap())
+                .service_builder(&names.notifications.as_str().try_into().unwrap())
                 .event()
                 .open();
 
             match (sub_service, event_service) {
                 (Ok(sub), Ok(event)) => {
+                    // The engine creates the service, so it decides what a full subscriber buffer
+                    // does. Take the largest buffer it allows and follow its overflow policy.
+                    let config = sub.static_config();
+                    let overflow = if config.has_safe_overflow() {
+                        Overflow::DropOldest(mesh_update_rx.clone())
+                    } else {
+                        Overflow::Block
+                    };
                     break (
-                        sub.subscriber_builder().create().expect("Subscriber error"),
+                        sub.subscriber_builder()
+                            .buffer_size(config.subscriber_max_buffer_size())
+                            .create()
+                            .expect("Subscriber error"),
                         event.listener_builder().create().expect("Listener error"),
+                        overflow,
                     );
                 }
-                _ => {
-                    // Engine isn't fully ready yet, or services aren't registered.
-                    // Sleep for a bit and try again.
-                    thread::sleep(Duration::from_millis(500));
-                    println!("Waiting for Engine mesh services to appear...");
-                }
+                // Engine isn't fully ready yet, or services aren't registered. Retry shortly.
+                _ => discovery.wait("mesh"),
             }
         };
 
+        ready.mark(MESH_SERVICES);
         println!("Background mesh sync loop active.");
 
         while !shutdown.load(Ordering::Relaxed) {
@@ -62,12 +135,62 @@ pub fn spawn_mesh_sync_thread(
             // Drain all pending samples from the subscriber
             while let Ok(Some(sample)) = subscriber.receive() {
                 // Send the mesh update to the main thread or whoever is interested
-                let r = mesh_update_tx.send(*sample.payload());
-                if r.is_err() {
-                    eprintln!("Failed to send mesh update to main thread: {:?}", r.err());
+                let _span = trace::span("forward_mesh_publish");
+                if !forward(&mesh_update_tx, *sample.payload(), &overflow, &shutdown) {
+                    break;
                 }
+                STATS.mesh_publishes.fetch_add(1, Ordering::Relaxed);
+                signal.raise();
             }
         }
         println!("Background mesh sync loop exiting.");
     })
 }
+
+/// What forward does when the bounded main-thread queue is full
+enum Overflow {
+    /// Stop draining the subscriber. Only reaches the engine when its service blocks publishers
+    /// on full subscribers; with safe overflow it would just overwrite the oldest samples there.
+    Block,
+    /// The engine overwrites on overflow anyway, so discard the oldest queued publish here
+    /// where it can be counted, and keep draining
+    DropOldest(channel::Receiver<MeshPublish>),
+}
+
+/// Hands a publish to the main-thread queue, applying `overflow` while it is full.
+/// Returns false if the publish could not be delivered and draining should stop.
+fn forward(
+    mesh_update_tx: &channel::Sender<MeshPublish>,
+    publish: MeshPublish,
+    overflow: &Overflow,
+    shutdown: &AtomicBool,
+) -> bool {
+    let mut publish = publish;
+    loop {
+        let result = match overflow {
+            Overflow::Block => mesh_update_tx.send_timeout(publish, FORWARD_RETRY_TIMEOUT),
+            Overflow::DropOldest(_) => mesh_update_tx.try_send(publish).map_err(|e| match e {
+                channel::TrySendError::Full(p) => channel::SendTimeoutError::Timeout(p),
+                channel::TrySendError::Disconnected(p) => channel::SendTimeoutError::Disconnected(p),
+            }),
+        };
+        match result {
+            Ok(()) => return true,
+            Err(channel::SendTimeoutError::Timeout(p)) => {
+                if shutdown.load(Ordering::Relaxed) {
+                    return false;
+                }
+                if let Overflow::DropOldest(mesh_update_rx) = overflow {
+                    if mesh_update_rx.try_recv().is_ok() {
+                        STATS.mesh_publishes_dropped.fetch_add(1, Ordering::Relaxed);
+                    }
+                }
+                publish = p;
+            }
+            Err(channel::SendTimeoutError::Disconnected(_)) => {
+                eprintln!("Failed to send mesh update to main thread: queue disconnected");
+                return false;
+            }
+        }
+    }
+}
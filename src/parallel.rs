@@ -0,0 +1,65 @@
+//! Data-parallel helpers for per-asset loops over large sends.
+//!
+//! Work is split into one contiguous index range per worker on scoped threads,
+//! so results come back in input order and nothing outlives the call. Below
+//! `PARALLEL_THRESHOLD` items everything runs inline on the calling thread.
+
+use std::ops::Range;
+
+/// Item count from which the per-asset loops fan out across threads
+pub const PARALLEL_THRESHOLD: usize = 4096;
+
+/// Upper bound on worker threads, the loops are memory bound well before this
+const MAX_WORKERS: usize = 8;
+
+fn worker_count(count: usize) -> usize {
+    if count < PARALLEL_THRESHOLD {
+        return 1;
+    }
+    let available = std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1);
+    available.min(MAX_WORKERS).min(count / (PARALLEL_THRESHOLD / 4)).max(1)
+}
+
+fn ranges(count: usize, workers: usize) -> impl Iterator<Item = Range<usize>> {
+    let chunk = count.div_ceil(workers);
+    (0..workers).map(move |w| (w * chunk).min(count)..((w + 1) * chunk).min(count))
+}
+
+/// Maps every index range to a Vec and concatenates them in order, stopping at the first error
+pub fn map_ranges<T, F>(count: usize, f: F) -> Result<Vec<T>, String>
+where
+    T: Send,
+    F: Fn(Range<usize>) -> Result<Vec<T>, String> + Sync,
+{
+    let workers = worker_count(count);
+    if workers == 1 {
+        return f(0..count);
+    }
+
+    let parts: Vec<Result<Vec<T>, String>> = std::thread::scope(|scope| {
+        let handles: Vec<_> = ranges(count, workers)
+            .map(|range| {
+                let f = &f;
+                scope.spawn(move || f(range))
+            })
+            .collect();
+        handles
+            .into_iter()
+            .map(|h| h.join().unwrap_or_else(|_| Err("Worker thread panicked".to_string())))
+            .collect()
+    });
+
+    let mut out = Vec::with_capacity(count);
+    for part in parts {
+        out.extend(part?);
+    }
+    Ok(out)
+}
+
+/// Runs `f` over every index range, returning the first error
+pub fn for_each_range<F>(count: usize, f: F) -> Result<(), String>
+where
+    F: Fn(Range<usize>) -> Result<(), String> + Sync,
+{
+    map_ranges(count, |range| f(range).map(|_| Vec::<()>::new())).map(|_| ())
+}
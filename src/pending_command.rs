@@ -0,0 +1,200 @@
+//! Python handle for a command submitted without blocking on its response.
+//!
+//! Lets one thread keep several engine requests outstanding and collect
+//! the results later, either by polling `done()`/`result()` or by awaiting.
+
+use pivot_com_types::EngineResponse;
+use pyo3::exceptions::{PyRuntimeError, PyStopIteration, PyTimeoutError, PyValueError};
+use pyo3::prelude::*;
+use pyo3::types::{PyCFunction, PyDict, PyTuple};
+use pyo3::IntoPyObjectExt;
+use std::time::Duration;
+
+use crate::engine_api;
+use crate::shards::ShardHandles;
+
+/// First and longest event loop sleep between polls while a command is awaited
+const AWAIT_MIN_DELAY: Duration = Duration::from_micros(100);
+const AWAIT_MAX_DELAY: Duration = Duration::from_millis(10);
+
+/// How the engine response is turned into a Python value
+#[derive(Clone, Copy)]
+pub enum ResponseKind {
+    /// Commands whose response carries nothing the caller needs
+    Ack,
+    /// tbo_downsample, resolves to the number of meshes accumulated
+    TboDownsample,
+    /// tbo_flush / export_all_asset_tbo, resolves to the written filenames
+    TboFlush,
+}
+
+/// Responses come back per engine shard the command was sent to
+enum State {
+    Pending(ShardHandles),
+    Done(Result<Vec<EngineResponse>, String>),
+}
+
+#[pyclass(unsendable)]
+pub struct PendingCommand {
+    state: Option<State>,
+    kind: ResponseKind,
+    request_id: u64,
+    /// Polls made by __next__ so far, grows the event loop sleep between them
+    await_polls: u32,
+}
+
+impl PendingCommand {
+    pub fn new(handle: ShardHandles, kind: ResponseKind) -> Self {
+        PendingCommand {
+            request_id: handle.request_id(),
+            state: Some(State::Pending(handle)),
+            kind,
+            await_polls: 0,
+        }
+    }
+
+    fn poll(&mut self) -> bool {
+        match self.state.take() {
+            Some(State::Pending(handle)) => match handle.try_wait() {
+                Ok(result) => {
+                    self.state = Some(State::Done(result));
+                    true
+                }
+                Err(handle) => {
+                    self.state = Some(State::Pending(handle));
+                    false
+                }
+            },
+            other => {
+                self.state = other;
+                true
+            }
+        }
+    }
+
+    /// Waits for the responses, with a `timeout` raises TimeoutError and stays pending once it passes
+    fn resolve(&mut self, py: Python, timeout: Option<Duration>) -> PyResult<&[EngineResponse]> {
+        match self.state.take() {
+            // Block without the GIL so other Python threads keep running while the engine works
+            Some(State::Pending(handle)) => match timeout {
+                None => self.state = Some(State::Done(py.detach(|| handle.wait()))),
+                Some(timeout) => match py.detach(|| handle.wait_timeout(timeout)) {
+                    Ok(result) => self.state = Some(State::Done(result)),
+                    Err(handle) => {
+                        self.state = Some(State::Pending(handle));
+                        return Err(PyErr::new::<PyTimeoutError, _>(format!(
+                            "No response within {:?}, the command is still pending",
+                            timeout
+                        )));
+                    }
+                },
+            },
+            other => self.state = other,
+        }
+        match &self.state {
+            Some(State::Done(result)) => result
+                .as_deref()
+                .map_err(|e| PyErr::new::<PyRuntimeError, _>(e.clone())),
+            _ => Err(PyErr::new::<PyRuntimeError, _>("Command already consumed")),
+        }
+    }
+
+    /// Future on the running event loop that resolves after the next poll delay.
+    /// Yielding it parks the awaiting task; a bare None would have asyncio resume it right away and spin.
+    fn sleep_future<'py>(&mut self, py: Python<'py>) -> PyResult<Bound<'py, PyAny>> {
+        let delay = (AWAIT_MIN_DELAY * (1 << self.await_polls.min(7))).min(AWAIT_MAX_DELAY);
+        self.await_polls = self.await_polls.saturating_add(1);
+
+        let event_loop = py.import("asyncio")?.call_method0("get_running_loop")?;
+        let future = event_loop.call_method0("create_future")?;
+        // A cancelled task leaves its future done, don't set a result on it then
+        let wake = PyCFunction::new_closure(
+            py,
+            None,
+            None,
+            |args: &Bound<'_, PyTuple>, _kwargs: Option<&Bound<'_, PyDict>>| -> PyResult<()> {
+                let future = args.get_item(0)?;
+                if !future.call_method0("done")?.is_truthy()? {
+                    future.call_method1("set_result", (args.py().None(),))?;
+                }
+                Ok(())
+            },
+        )?;
+        event_loop.call_method1("call_later", (delay.as_secs_f64(), wake, &future))?;
+        // What Future.__await__ sets before yielding, asyncio rejects the future without it
+        future.setattr("_asyncio_future_blocking", true)?;
+        Ok(future)
+    }
+
+    fn decode(&mut self, py: Python, timeout: Option<Duration>) -> PyResult<Py<PyAny>> {
+        let kind = self.kind;
+        let responses = self.resolve(py, timeout)?;
+
+        match kind {
+            ResponseKind::Ack => Ok(py.None()),
+            ResponseKind::TboDownsample => engine_api::merge_tbo_downsample(responses).into_py_any(py),
+            ResponseKind::TboFlush => engine_api::merge_tbo_flush(responses)
+                .map_err(|e| PyErr::new::<PyRuntimeError, _>(e))?
+                .into_py_any(py),
+        }
+    }
+}
+
+#[pymethods]
+impl PendingCommand {
+    /// SDK request id of the command, matches the `request_id` of its spans in dump_trace output.
+    #[getter]
+    fn request_id(&self) -> u64 {
+        self.request_id
+    }
+
+    /// True once the engine has responded (never blocks).
+    fn done(&mut self) -> bool {
+        self.poll()
+    }
+
+    /// Block until the engine responds and return the decoded result.
+    ///
+    /// Args:
+    ///     timeout: Seconds to wait; raises TimeoutError after that and the
+    ///         command stays pending, call cancel() to give up on it
+    ///
+    /// Returns:
+    ///     None for plain commands, the accumulated count for tbo_downsample,
+    ///     or the list of written filenames for flush/export commands
+    #[pyo3(signature = (timeout=None))]
+    fn result(&mut self, py: Python, timeout: Option<f64>) -> PyResult<Py<PyAny>> {
+        let timeout = timeout
+            .map(|secs| {
+                Duration::try_from_secs_f64(secs)
+                    .map_err(|e| PyErr::new::<PyValueError, _>(format!("Invalid timeout: {}", e)))
+            })
+            .transpose()?;
+        self.decode(py, timeout)
+    }
+
+    /// Give up on the command. The SDK stops waiting for the engine's answer and
+    /// result() raises; the engine may still carry the command out.
+    fn cancel(&mut self) {
+        if let Some(State::Pending(handle)) = &self.state {
+            handle.cancel();
+        }
+    }
+
+    fn __await__(slf: PyRef<'_, Self>) -> PyRef<'_, Self> {
+        slf
+    }
+
+    fn __iter__(slf: PyRef<'_, Self>) -> PyRef<'_, Self> {
+        slf
+    }
+
+    /// Awaitable protocol: sleeps on the event loop until the response is in, then returns it via StopIteration.
+    fn __next__(&mut self, py: Python) -> PyResult<Option<Py<PyAny>>> {
+        if !self.poll() {
+            return Ok(Some(self.sleep_future(py)?.unbind()));
+        }
+        let value = self.decode(py, None)?;
+        Err(PyStopIteration::new_err((value,)))
+    }
+}
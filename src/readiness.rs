@@ -0,0 +1,76 @@
+//! Startup handshake between the IPC threads and `EngineClient::start`.
+//!
+//! Each thread marks its services live once it has opened them, so a caller
+//! can block until the engine is actually reachable instead of guessing.
+
+use std::sync::{Condvar, Mutex};
+use std::time::{Duration, Instant};
+
+pub const INTERACTIVE_COMMAND_SERVICES: u8 = 1 << 0;
+pub const MESH_SERVICES: u8 = 1 << 1;
+pub const BULK_COMMAND_SERVICES: u8 = 1 << 2;
+pub const ALL_SERVICES: u8 = INTERACTIVE_COMMAND_SERVICES | BULK_COMMAND_SERVICES | MESH_SERVICES;
+
+#[derive(Debug, Default)]
+pub struct ReadyLatch {
+    live: Mutex<u8>,
+    changed: Condvar,
+}
+
+impl ReadyLatch {
+    pub fn new() -> Self {
+        ReadyLatch::default()
+    }
+
+    pub fn mark(&self, services: u8) {
+        *self.live.lock().unwrap() |= services;
+        self.changed.notify_all();
+    }
+
+    pub fn is_ready(&self) -> bool {
+        *self.live.lock().unwrap() == ALL_SERVICES
+    }
+
+    /// Waits up to `timeout` for every service, returns whether they all came up
+    pub fn wait_for(&self, timeout: Duration) -> bool {
+        let live = self.live.lock().unwrap();
+        let (live, _) = self
+            .changed
+            .wait_timeout_while(live, timeout, |live| *live != ALL_SERVICES)
+            .unwrap();
+        *live == ALL_SERVICES
+    }
+}
+
+/// Retry delays for opening engine services: starts at 1ms and doubles up to 50ms,
+/// so a freshly spawned engine is picked up within a millisecond or two of registering.
+pub struct DiscoveryBackoff {
+    delay: Duration,
+    started: Instant,
+    reported: bool,
+}
+
+impl DiscoveryBackoff {
+    const MIN_DELAY: Duration = Duration::from_millis(1);
+    const MAX_DELAY: Duration = Duration::from_millis(50);
+    /// Only log once the wait is noticeable
+    const REPORT_AFTER: Duration = Duration::from_secs(1);
+
+    pub fn new() -> Self {
+        DiscoveryBackoff {
+            delay: Self::MIN_DELAY,
+            started: Instant::now(),
+            reported: false,
+        }
+    }
+
+    /// Sleeps for the next delay, `what` names the services in the one-time wait message
+    pub fn wait(&mut self, what: &str) {
+        if !self.reported && self.started.elapsed() >= Self::REPORT_AFTER {
+            println!("Waiting for Engine {} services to appear...", what);
+            self.reported = true;
+        }
+        std::thread::sleep(self.delay);
+        self.delay = (self.delay * 2).min(Self::MAX_DELAY);
+    }
+}
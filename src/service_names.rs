@@ -0,0 +1,55 @@
+//! iceoryx2 service names of one engine instance.
+//!
+//! Without an instance id the names are the historical `PivotEngine/...`
+//! ones, so existing engines keep working. With an id every service lives
+//! under `PivotEngine/<id>/...`, letting several engines share a machine and
+//! SDK processes attach to a specific long-running one.
+
+/// Environment variable a spawned engine reads its instance id from
+pub const INSTANCE_ENV_VAR: &str = "PIVOT_ENGINE_INSTANCE";
+
+#[derive(Debug, Clone)]
+pub struct ServiceNames {
+    pub instance: Option<String>,
+    pub command: String,
+    pub command_events: String,
+    /// Dedicated request-response service for the interactive lane, engines that
+    /// don't offer it serve both lanes from `command`
+    pub interactive_command: String,
+    pub interactive_command_events: String,
+    /// Optional event the engine signals after writing a response
+    pub response_events: String,
+    pub mesh_updates: String,
+    pub notifications: String,
+}
+
+impl ServiceNames {
+    pub fn new(instance: Option<&str>) -> Self {
+        let prefix = match instance {
+            Some(id) => format!("PivotEngine/{}", id),
+            None => "PivotEngine".to_string(),
+        };
+
+        ServiceNames {
+            instance: instance.map(str::to_string),
+            command: format!("{}/CommandService", prefix),
+            command_events: format!("{}/CommandEvents", prefix),
+            interactive_command: format!("{}/InteractiveCommandService", prefix),
+            interactive_command_events: format!("{}/InteractiveCommandEvents", prefix),
+            response_events: format!("{}/ResponseEvents", prefix),
+            mesh_updates: format!("{}/MeshUpdates", prefix),
+            notifications: format!("{}/Notifications", prefix),
+        }
+    }
+
+    /// Rejects ids that would not form a valid service name segment
+    pub fn validate_instance(id: &str) -> Result<(), String> {
+        if id.is_empty() || !id.chars().all(|c| c.is_ascii_alphanumeric() || c == '-' || c == '_') {
+            return Err(format!(
+                "Invalid engine instance id '{}', use letters, digits, '-' or '_'",
+                id
+            ));
+        }
+        Ok(())
+    }
+}
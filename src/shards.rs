@@ -0,0 +1,510 @@
+//! Several engine processes behind one SDK.
+//!
+//! Every group lives on exactly one shard, picked by hashing its UUID, so
+//! alloc/send/standardize/drop only reach the engine that owns the group while
+//! the `*_all` commands fan out to every shard and their results are merged.
+//! With a single shard (the default) this is the plain one-engine client,
+//! using the historical service names.
+//!
+//! Groups an engine creates itself (imports, group_all_objects) land on
+//! whichever shard made them, and neither the import nor the group_all_objects
+//! response says which groups those are. So the owner of every group this
+//! process allocated or saw published is remembered, and commands on groups
+//! with no known owner go to every shard, the ones not holding them ignore
+//! them. That record lives in this process only: after attaching to running
+//! engines it is empty and only refills as groups are allocated or published.
+//!
+//! Shards share one iceoryx2 node and one mesh sync readiness pipe, so Python
+//! still registers a single fd. Each shard keeps its own slab table, slabs of
+//! different engines never mix.
+
+use iceoryx2::prelude::*;
+use pivot_com_types::fields::Uuid;
+use pivot_com_types::{EngineResponse, MeshPublish};
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex, RwLock};
+use std::time::{Duration, Instant};
+
+use crate::command_thread::{Command, CommandHandle};
+use crate::engine_client::{EngineClient, EngineHealth};
+use crate::mesh_sync_thread::MeshSyncSignal;
+use crate::slab_options::SlabMapOptions;
+use crate::slab_table::ReclaimStats;
+
+/// Upper bound on engines one SDK process drives
+pub const MAX_SHARDS: usize = 64;
+
+/// Instance id prefix of sharded engines started without an explicit instance
+const DEFAULT_SHARD_PREFIX: &str = "shard";
+
+/// Shard a group belongs to. FNV-1a over the UUID bytes, so every SDK process
+/// (and every Rust version) routes the same group to the same engine.
+pub fn shard_of(uuid: &Uuid, shard_count: usize) -> usize {
+    if shard_count <= 1 {
+        return 0;
+    }
+    let mut hash: u64 = 0xcbf2_9ce4_8422_2325;
+    for &byte in &uuid.bytes {
+        hash ^= byte as u64;
+        hash = hash.wrapping_mul(0x0000_0100_0000_01b3);
+    }
+    (hash % shard_count as u64) as usize
+}
+
+/// Instance id of one shard, the plain `instance` when there is only one
+fn shard_instance(instance: Option<&str>, shard: usize, shard_count: usize) -> Option<String> {
+    if shard_count == 1 {
+        return instance.map(str::to_string);
+    }
+    Some(format!("{}-{}", instance.unwrap_or(DEFAULT_SHARD_PREFIX), shard))
+}
+
+/// Handles of one logical command submitted to one or more shards
+pub struct ShardHandles {
+    handles: Vec<CommandHandle>,
+    /// Shard every handle was submitted to, same order as handles
+    shards: Vec<usize>,
+}
+
+impl ShardHandles {
+    /// Request id of the first sub-command, 0 when nothing was submitted
+    pub fn request_id(&self) -> u64 {
+        self.handles.first().map_or(0, |handle| handle.request_id())
+    }
+
+    /// Blocks until every shard responded, returns the responses in shard order or the first error
+    pub fn wait(self) -> Result<Vec<EngineResponse>, String> {
+        let mut responses = Vec::with_capacity(self.handles.len());
+        let mut first_error = None;
+        for handle in self.handles {
+            match handle.wait() {
+                Ok(resp) => responses.push(resp),
+                Err(e) => {
+                    first_error.get_or_insert(e);
+                }
+            }
+        }
+        match first_error {
+            Some(e) => Err(e),
+            None => Ok(responses),
+        }
+    }
+
+    /// Blocks until the next shard responds, in completion order, and returns which shard it was;
+    /// None once every shard has
+    pub fn wait_next(&mut self) -> Option<(usize, Result<EngineResponse, String>)> {
+        if self.handles.is_empty() {
+            return None;
+        }
+        let i = CommandHandle::select(&mut self.handles);
+        Some(self.take(i))
+    }
+
+    /// Like wait_next, but returns None as well if no shard responded within `timeout`
+    pub fn wait_next_timeout(&mut self, timeout: Duration) -> Option<(usize, Result<EngineResponse, String>)> {
+        if self.handles.is_empty() {
+            return None;
+        }
+        let i = CommandHandle::select_until(&mut self.handles, Some(Instant::now() + timeout))?;
+        Some(self.take(i))
+    }
+
+    fn take(&mut self, i: usize) -> (usize, Result<EngineResponse, String>) {
+        let shard = self.shards.swap_remove(i);
+        (shard, self.handles.swap_remove(i).wait())
+    }
+
+    /// Shard of every sub-command still held, in the order wait() returns their responses
+    pub fn shards(&self) -> &[usize] {
+        &self.shards
+    }
+
+    /// Whether every shard already responded and was handed out by wait_next
+    pub fn is_empty(&self) -> bool {
+        self.handles.is_empty()
+    }
+
+    /// Gives up on every sub-command
+    pub fn cancel(&self) {
+        for handle in &self.handles {
+            handle.cancel();
+        }
+    }
+
+    /// Like wait(), but hands the handles back if not every shard responded within `timeout`
+    pub fn wait_timeout(mut self, timeout: Duration) -> Result<Result<Vec<EngineResponse>, String>, ShardHandles> {
+        let until = Instant::now() + timeout;
+        if self.handles.iter_mut().all(|handle| handle.wait_until(until)) {
+            Ok(self.wait())
+        } else {
+            Err(self)
+        }
+    }
+
+    /// Returns the merged result once every shard responded, otherwise hands the handles back
+    pub fn try_wait(self) -> Result<Result<Vec<EngineResponse>, String>, ShardHandles> {
+        if self.handles.iter().all(CommandHandle::is_ready) {
+            Ok(self.wait())
+        } else {
+            Err(self)
+        }
+    }
+}
+
+#[derive(Debug)]
+pub struct ShardedClient {
+    node: Arc<Node<ipc::Service>>,
+    shards: RwLock<Vec<Arc<EngineClient>>>,
+    /// Shared by every shard so Python waits on one fd
+    mesh_signal: Arc<MeshSyncSignal>,
+    /// Replayed onto shards created by a later resize
+    slab_options: Mutex<SlabMapOptions>,
+    mesh_queue_capacity: AtomicUsize,
+    /// Owning shard of every group allocated or published since the shards started
+    placements: RwLock<HashMap<Uuid, u16>>,
+    /// First shard the next poll_mesh_sync looks at, so no engine starves the others
+    next_poll: AtomicUsize,
+}
+
+impl ShardedClient {
+    pub fn new() -> Self {
+        let node = Arc::new(
+            NodeBuilder::new()
+                .create::<ipc::Service>()
+                .expect("Failed to create iceoryx2 node"),
+        );
+        let mesh_signal = Arc::new(
+            MeshSyncSignal::new().expect("Failed to create mesh sync readiness pipe"),
+        );
+        let primary = Arc::new(EngineClient::new(node.clone(), mesh_signal.clone()));
+
+        ShardedClient {
+            node,
+            shards: RwLock::new(vec![primary]),
+            mesh_signal,
+            slab_options: Mutex::new(SlabMapOptions::default()),
+            mesh_queue_capacity: AtomicUsize::new(0),
+            placements: RwLock::new(HashMap::new()),
+            next_poll: AtomicUsize::new(0),
+        }
+    }
+
+    pub fn shard_count(&self) -> usize {
+        self.shards.read().unwrap().len()
+    }
+
+    pub fn shard(&self, shard: usize) -> Arc<EngineClient> {
+        self.shards.read().unwrap()[shard].clone()
+    }
+
+    pub fn shards(&self) -> Vec<Arc<EngineClient>> {
+        self.shards.read().unwrap().clone()
+    }
+
+    /// Indices of `uuids` grouped by owning shard, one (possibly empty) list per shard.
+    /// Groups with no known owner go where shard_of() puts new groups, for allocating them.
+    pub fn partition(&self, uuids: &[Uuid]) -> Vec<Vec<usize>> {
+        self.split(uuids, false)
+    }
+
+    /// Like partition, but groups with no known owner are listed for every shard,
+    /// for commands on groups an engine may have created on its own
+    pub fn partition_known(&self, uuids: &[Uuid]) -> Vec<Vec<usize>> {
+        self.split(uuids, true)
+    }
+
+    fn split(&self, uuids: &[Uuid], fan_out_unknown: bool) -> Vec<Vec<usize>> {
+        let count = self.shard_count();
+        let mut parts = vec![Vec::new(); count];
+        if count == 1 {
+            parts[0] = (0..uuids.len()).collect();
+            return parts;
+        }
+        let placements = self.placements.read().unwrap();
+        for (i, uuid) in uuids.iter().enumerate() {
+            match placements.get(uuid) {
+                Some(&shard) => parts[shard as usize].push(i),
+                None if fan_out_unknown => parts.iter_mut().for_each(|part| part.push(i)),
+                None => parts[shard_of(uuid, count)].push(i),
+            }
+        }
+        parts
+    }
+
+    /// Records that `uuids` live on `shard`, because it allocated or published them
+    pub fn note_placement(&self, shard: usize, uuids: impl IntoIterator<Item = Uuid>) {
+        if self.shard_count() == 1 {
+            return;
+        }
+        let mut placements = self.placements.write().unwrap();
+        for uuid in uuids {
+            placements.insert(uuid, shard as u16);
+        }
+    }
+
+    /// Forgets the placement of dropped groups, `None` forgets every group
+    pub fn forget_placement(&self, uuids: Option<&[Uuid]>) {
+        let mut placements = self.placements.write().unwrap();
+        match uuids {
+            Some(uuids) if !placements.is_empty() => {
+                for uuid in uuids {
+                    placements.remove(uuid);
+                }
+            }
+            Some(_) => {}
+            None => placements.clear(),
+        }
+    }
+
+    /// Submits `command(shard)` to every shard it returns a command for, without waiting.
+    /// Every shard is tried; if any submit fails the ones that went out are cancelled
+    /// and the failures are returned together.
+    pub fn submit_each<F>(&self, command: F) -> Result<ShardHandles, String>
+    where
+        F: Fn(usize) -> Option<Command>,
+    {
+        let shards = self.shards();
+        let mut handles = Vec::new();
+        let mut submitted = Vec::new();
+        let mut errors = Vec::new();
+        for (shard, client) in shards.iter().enumerate() {
+            if let Some(cmd) = command(shard) {
+                match client.submit_command(cmd) {
+                    Ok(handle) => {
+                        handles.push(handle);
+                        submitted.push(shard);
+                    }
+                    Err(e) => errors.push((shard, e)),
+                }
+            }
+        }
+        let handles = ShardHandles { handles, shards: submitted };
+        if errors.is_empty() {
+            return Ok(handles);
+        }
+
+        handles.cancel();
+        // A single engine keeps its error text as is, like connect_all
+        if shards.len() == 1 {
+            return Err(errors.pop().unwrap().1);
+        }
+        Err(errors
+            .into_iter()
+            .map(|(shard, e)| format!("shard {}: {}", shard, e))
+            .collect::<Vec<_>>()
+            .join("; "))
+    }
+
+    /// Sends the same command to every shard and waits for all of them
+    pub fn send_all<F>(&self, command: F) -> Result<Vec<EngineResponse>, String>
+    where
+        F: Fn() -> Command,
+    {
+        self.submit_each(|_| Some(command()))?.wait()
+    }
+
+    /// Replaces the shard set, only while every shard is stopped
+    fn resize(&self, count: usize) -> Result<(), String> {
+        if count == 0 || count > MAX_SHARDS {
+            return Err(format!("Shard count must be between 1 and {}, got {}", MAX_SHARDS, count));
+        }
+
+        let mut shards = self.shards.write().unwrap();
+        if shards.len() == count {
+            return Ok(());
+        }
+        if shards.iter().any(|client| client.is_active()) {
+            return Err(format!(
+                "Already running {} engine shard(s), stop them before starting {}",
+                shards.len(),
+                count
+            ));
+        }
+
+        self.placements.write().unwrap().clear();
+        let options = *self.slab_options.lock().unwrap();
+        let capacity = self.mesh_queue_capacity.load(Ordering::Relaxed);
+        shards.truncate(count);
+        while shards.len() < count {
+            let client = EngineClient::new(self.node.clone(), self.mesh_signal.clone());
+            client.set_slab_map_options(options);
+            client.set_mesh_queue_capacity(capacity);
+            shards.push(Arc::new(client));
+        }
+        Ok(())
+    }
+
+    /// Runs `connect` for every shard concurrently; if any fails the others are stopped again
+    fn connect_all<F>(&self, connect: F) -> Result<(), String>
+    where
+        F: Fn(usize, &EngineClient) -> Result<(), String> + Sync,
+    {
+        let shards = self.shards();
+        let results: Vec<Result<(), String>> = std::thread::scope(|scope| {
+            let handles: Vec<_> = shards
+                .iter()
+                .enumerate()
+                .map(|(shard, client)| {
+                    let connect = &connect;
+                    scope.spawn(move || connect(shard, client))
+                })
+                .collect();
+            handles
+                .into_iter()
+                .map(|h| h.join().unwrap_or_else(|_| Err("Shard startup thread panicked".to_string())))
+                .collect()
+        });
+
+        // A single engine tears itself down on failure and keeps its error text as is
+        if results.len() == 1 {
+            return results.into_iter().next().unwrap();
+        }
+
+        let errors: Vec<String> = results
+            .into_iter()
+            .enumerate()
+            .filter_map(|(shard, result)| result.err().map(|e| format!("shard {}: {}", shard, e)))
+            .collect();
+        if errors.is_empty() {
+            return Ok(());
+        }
+        let _ = self.stop();
+        Err(errors.join("; "))
+    }
+
+    /// Spawns `shard_count` engines under distinct instance ids (`<instance>-<n>`, or `shard-<n>`)
+    pub fn start(
+        &self,
+        path: String,
+        wait: Option<Duration>,
+        instance: Option<String>,
+        persistent: bool,
+        shard_count: usize,
+    ) -> Result<(), String> {
+        self.resize(shard_count)?;
+        self.connect_all(|shard, client| {
+            let id = shard_instance(instance.as_deref(), shard, shard_count);
+            client.start(path.clone(), wait, id, persistent)
+        })
+    }
+
+    /// Attaches to `shard_count` running engines named like start() names them
+    pub fn attach(&self, instance: Option<String>, timeout: Duration, shard_count: usize) -> Result<(), String> {
+        self.resize(shard_count)?;
+        self.connect_all(|shard, client| {
+            client.attach(shard_instance(instance.as_deref(), shard, shard_count), timeout)
+        })
+    }
+
+    /// Stops every shard, returning the first error after all of them were tried
+    pub fn stop(&self) -> Result<(), String> {
+        let mut first_error = None;
+        for client in self.shards() {
+            if let Err(e) = client.stop() {
+                first_error.get_or_insert(e);
+            }
+        }
+        first_error.map_or(Ok(()), Err)
+    }
+
+    pub fn is_ready(&self) -> bool {
+        self.shards().iter().all(|client| client.is_ready())
+    }
+
+    /// Liveness of every shard in shard order, None for shards that are not running
+    pub fn health(&self) -> Vec<Option<EngineHealth>> {
+        self.shards().iter().map(|client| client.health()).collect()
+    }
+
+    /// Next publish of any shard, together with the shard it came from
+    pub fn poll_mesh_sync(&self) -> Result<Option<(usize, MeshPublish)>, String> {
+        let shards = self.shards();
+        let start = self.next_poll.fetch_add(1, Ordering::Relaxed);
+        let mut found = None;
+
+        for k in 0..shards.len() {
+            let shard = (start + k) % shards.len();
+            if let Some(mp) = shards[shard].poll_mesh_sync()? {
+                found = Some((shard, mp));
+                break;
+            }
+        }
+
+        // A shard that was not polled may have cleared nothing but still hold publishes
+        if shards.iter().any(|client| client.has_mesh_updates()) {
+            self.mesh_signal.raise();
+        }
+        Ok(found)
+    }
+
+    /// Every publish queued so far on every shard, tagged with its shard
+    pub fn drain_mesh_sync(&self) -> Vec<(usize, MeshPublish)> {
+        let mut publishes = Vec::new();
+        for (shard, client) in self.shards().iter().enumerate() {
+            publishes.extend(client.drain_mesh_sync().into_iter().map(|mp| (shard, mp)));
+        }
+        publishes
+    }
+
+    /// Hands drained publishes back to their shards, in order, for the next poll
+    pub fn requeue_mesh_sync(&self, publishes: Vec<(usize, MeshPublish)>) {
+        let shards = self.shards();
+        let mut per_shard: Vec<Vec<MeshPublish>> = vec![Vec::new(); shards.len()];
+        for (shard, mp) in publishes {
+            if let Some(part) = per_shard.get_mut(shard) {
+                part.push(mp);
+            }
+        }
+        for (client, part) in shards.iter().zip(per_shard) {
+            client.requeue_mesh_sync(part);
+        }
+    }
+
+    #[cfg(unix)]
+    pub fn mesh_sync_fd(&self) -> std::os::fd::RawFd {
+        self.mesh_signal.fd()
+    }
+
+    pub fn mapped_slab_count(&self) -> usize {
+        self.shards().iter().map(|client| client.mapped_slab_count()).sum()
+    }
+
+    pub fn registered_slab_count(&self) -> usize {
+        self.shards().iter().map(|client| client.registered_slab_count()).sum()
+    }
+
+    pub fn set_slab_map_options(&self, options: SlabMapOptions) {
+        *self.slab_options.lock().unwrap() = options;
+        for client in self.shards() {
+            client.set_slab_map_options(options);
+        }
+    }
+
+    pub fn reclaim_slabs(&self, advise: bool) -> ReclaimStats {
+        let mut total = ReclaimStats::default();
+        for client in self.shards() {
+            let stats = client.reclaim_slabs(advise);
+            total.unmapped_slabs += stats.unmapped_slabs;
+            total.unmapped_bytes += stats.unmapped_bytes;
+            total.advised_bytes += stats.advised_bytes;
+            total.deferred |= stats.deferred;
+        }
+        total
+    }
+
+    /// (command queue, mesh update queue) lengths summed over the shards
+    pub fn queue_lengths(&self) -> (usize, usize) {
+        self.shards()
+            .iter()
+            .map(|client| client.queue_lengths())
+            .fold((0, 0), |(c, m), (sc, sm)| (c + sc, m + sm))
+    }
+
+    pub fn set_mesh_queue_capacity(&self, capacity: usize) {
+        self.mesh_queue_capacity.store(capacity, Ordering::Relaxed);
+        for client in self.shards() {
+            client.set_mesh_queue_capacity(capacity);
+        }
+    }
+}
@@ -0,0 +1,108 @@
+//! Page-level tuning applied to slab mappings after they are opened.
+//!
+//! The engine creates the shared memory objects, so the SDK can only advise
+//! the kernel about its own mapping: transparent huge pages, prefaulting and
+//! NUMA placement. Explicit hugetlbfs pages have to be chosen by the engine
+//! when it creates the slabs; here they are requested through MADV_HUGEPAGE,
+//! which shmem honours when /sys/kernel/mm/transparent_hugepage/shmem_enabled
+//! is `advise` or `always`.
+
+use iceoryx2_bb_posix::shared_memory::SharedMemory;
+
+/// MADV_POPULATE_WRITE (Linux 5.14+), faults the range in writable without touching the data
+#[cfg(target_os = "linux")]
+const MADV_POPULATE_WRITE: libc::c_int = 23;
+
+#[cfg(target_os = "linux")]
+const MPOL_BIND: libc::c_int = 2;
+#[cfg(target_os = "linux")]
+const MPOL_MF_MOVE: libc::c_uint = 1 << 1;
+
+#[derive(Debug, Default, Clone, Copy)]
+pub struct SlabMapOptions {
+    /// Ask for transparent huge pages on every asset slab
+    pub huge_pages: bool,
+    /// Fault the whole slab in when it is mapped instead of on first write
+    pub populate: bool,
+    /// Bind the slab pages to this NUMA node
+    pub numa_node: Option<u32>,
+}
+
+impl SlabMapOptions {
+    pub fn is_default(&self) -> bool {
+        !self.huge_pages && !self.populate && self.numa_node.is_none()
+    }
+
+    /// Applies the options to a mapping, failures are logged and leave the mapping usable as is
+    pub fn apply(&self, shm: &SharedMemory) {
+        let (addr, len) = (shm.base_address().as_ptr() as *mut libc::c_void, shm.size());
+
+        #[cfg(target_os = "linux")]
+        {
+            if self.huge_pages {
+                advise(addr, len, libc::MADV_HUGEPAGE, "MADV_HUGEPAGE");
+            }
+            // Bind before populating so the faulted pages land on the right node
+            if let Some(node) = self.numa_node {
+                bind_to_node(addr, len, node);
+            }
+            if self.populate && !advise(addr, len, MADV_POPULATE_WRITE, "") {
+                // Older kernels, at least start readahead of the backing pages
+                advise(addr, len, libc::MADV_WILLNEED, "MADV_WILLNEED");
+            }
+        }
+
+        #[cfg(not(target_os = "linux"))]
+        {
+            if self.populate {
+                advise(addr, len, libc::MADV_WILLNEED, "MADV_WILLNEED");
+            }
+        }
+    }
+}
+
+/// Releases this process' pages of a mapping, returns the number of bytes advised
+pub fn advise_dont_need(shm: &SharedMemory) -> usize {
+    let len = shm.size();
+    if advise(shm.base_address().as_ptr() as *mut libc::c_void, len, libc::MADV_DONTNEED, "MADV_DONTNEED") {
+        len
+    } else {
+        0
+    }
+}
+
+/// madvise wrapper, logs failures unless `name` is empty
+fn advise(addr: *mut libc::c_void, len: usize, advice: libc::c_int, name: &str) -> bool {
+    let ret = unsafe { libc::madvise(addr, len, advice) };
+    if ret != 0 && !name.is_empty() {
+        eprintln!("[SDK] madvise({}) failed: {}", name, std::io::Error::last_os_error());
+    }
+    ret == 0
+}
+
+#[cfg(target_os = "linux")]
+fn bind_to_node(addr: *mut libc::c_void, len: usize, node: u32) {
+    const MASK_BITS: usize = 64 * 16;
+    if node as usize >= MASK_BITS {
+        eprintln!("[SDK] NUMA node {} is out of range", node);
+        return;
+    }
+
+    let mut nodemask = [0u64; MASK_BITS / 64];
+    nodemask[node as usize / 64] |= 1 << (node % 64);
+
+    let ret = unsafe {
+        libc::syscall(
+            libc::SYS_mbind,
+            addr,
+            len,
+            MPOL_BIND,
+            nodemask.as_ptr(),
+            MASK_BITS as libc::c_ulong,
+            MPOL_MF_MOVE,
+        )
+    };
+    if ret != 0 {
+        eprintln!("[SDK] mbind to NUMA node {} failed: {}", node, std::io::Error::last_os_error());
+    }
+}
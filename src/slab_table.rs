@@ -0,0 +1,302 @@
+//! Read-mostly table of the engine slabs mapped into this process.
+//!
+//! Slab base addresses are published into a fixed array of atomics so
+//! resolving an `AssetPtr` never takes a lock. Mapping new slabs is the
+//! only write and is serialized behind `mapped`; between reclaims the
+//! engine only appends slabs, so readers see a growing prefix of valid entries.
+//!
+//! Slabs the engine retired (fewer registered, or a different handle at an
+//! index) are unmapped by `reclaim`, which only runs while no `SlabPin` is
+//! alive, i.e. no AssetSyncContext or hydration still points into them.
+
+use iceoryx2::prelude::*;
+use iceoryx2_bb_posix::file::AccessMode;
+use iceoryx2_bb_posix::shared_memory::{SharedMemory, SharedMemoryBuilder};
+use pivot_com_types::alloc::SlabRegistry;
+use pivot_com_types::asset_meta::AssetMeta;
+use pivot_com_types::asset_ptr::AssetPtr;
+use std::ptr::NonNull;
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicPtr, AtomicUsize, Ordering, fence};
+
+static LIVE_PINS: AtomicUsize = AtomicUsize::new(0);
+
+use crate::engine_client::bytes_to_clean_str;
+use crate::engine_stats::STATS;
+use crate::slab_options::{SlabMapOptions, advise_dont_need};
+
+/// Capacity of the published table, slab indices past this are rejected
+pub const MAX_SLABS: usize = 1024;
+
+/// Keeps mapped slabs from being unmapped while local pointers into them are in use
+#[derive(Debug)]
+pub struct SlabPin(());
+
+impl SlabPin {
+    pub fn new() -> Self {
+        LIVE_PINS.fetch_add(1, Ordering::SeqCst);
+        // Order the pin before any read of `len`, pairs with the shrink in reclaim
+        fence(Ordering::SeqCst);
+        SlabPin(())
+    }
+}
+
+impl Drop for SlabPin {
+    fn drop(&mut self) {
+        LIVE_PINS.fetch_sub(1, Ordering::SeqCst);
+    }
+}
+
+/// Outcome of a reclaim pass
+#[derive(Debug, Default, Clone, Copy)]
+pub struct ReclaimStats {
+    pub unmapped_slabs: usize,
+    pub unmapped_bytes: usize,
+    pub advised_bytes: usize,
+    /// Skipped because pointers into the slabs were still live
+    pub deferred: bool,
+}
+
+#[derive(Debug)]
+struct MappedSlab {
+    /// Handle the slab was opened with, compared against the registry to spot retired slabs
+    handle: Vec<u8>,
+    shm: SharedMemory,
+}
+
+#[derive(Debug)]
+pub struct SlabTable {
+    bases: Box<[AtomicPtr<u8>]>,
+    len: AtomicUsize,
+    /// Owns the mappings, index 0 is the root slab holding the SlabRegistry
+    mapped: Mutex<Vec<MappedSlab>>,
+    /// Applied to every asset slab as it is mapped, the root slab is left alone
+    options: Mutex<SlabMapOptions>,
+}
+
+// Mappings are only created and dropped under the mutex, readers only see raw base addresses
+unsafe impl Send for SlabTable {}
+unsafe impl Sync for SlabTable {}
+
+impl SlabTable {
+    pub fn new() -> Self {
+        SlabTable {
+            bases: (0..MAX_SLABS)
+                .map(|_| AtomicPtr::new(std::ptr::null_mut()))
+                .collect(),
+            len: AtomicUsize::new(0),
+            mapped: Mutex::new(Vec::new()),
+            options: Mutex::new(SlabMapOptions::default()),
+        }
+    }
+
+    /// Sets the mapping options for slabs mapped from now on and applies them to the asset slabs already mapped
+    pub fn set_options(&self, options: SlabMapOptions) {
+        let mapped = self.mapped.lock().unwrap();
+        *self.options.lock().unwrap() = options;
+        for slab in mapped.iter().skip(1) {
+            options.apply(&slab.shm);
+        }
+    }
+
+    /// Number of slabs currently mapped
+    pub fn len(&self) -> usize {
+        self.len.load(Ordering::Acquire)
+    }
+
+    /// Number of slabs the engine has registered, mapped here or not; 0 before the root slab is mapped
+    pub fn registered_slabs(&self) -> usize {
+        // Held so a concurrent clear() can't unmap the registry under the read
+        let mapped = self.mapped.lock().unwrap();
+        if mapped.is_empty() {
+            return 0;
+        }
+        self.registered_count()
+    }
+
+    /// Resolves an asset pointer to its AssetMeta in local memory without locking
+    pub fn resolve(&self, asset_ptr: &AssetPtr) -> Result<NonNull<AssetMeta>, String> {
+        let (slab_index, offset) = asset_ptr.unpack();
+        let slab_index = slab_index as usize;
+
+        if slab_index >= self.len() {
+            return Err(format!("Slab index {} is out of bounds", slab_index));
+        }
+
+        let base = self.bases[slab_index].load(Ordering::Acquire);
+        unsafe {
+            let raw_ptr = base.add(offset as usize) as *mut AssetMeta;
+            Ok(NonNull::new_unchecked(raw_ptr))
+        }
+    }
+
+    /// Makes sure every slab the engine has registered is mapped.
+    /// Lock-free when nothing changed; if we dont have any slabs yet the root_handle is opened first as it holds the registry.
+    pub fn sync(&self, root_handle: &[u8]) -> Result<(), String> {
+        let len = self.len();
+        if len > 0 && self.registered_count() <= len {
+            return Ok(());
+        }
+
+        let mut mapped = self.mapped.lock().unwrap();
+
+        if mapped.is_empty() {
+            let root = open_shm(root_handle)?;
+            self.publish(&mut mapped, bytes_to_clean_str(root_handle), root);
+        }
+
+        self.map_new_slabs(&mut mapped);
+        Ok(())
+    }
+
+    /// Unmaps everything, only call once no one is resolving or holding pointers into the slabs
+    pub fn clear(&self) {
+        let mut mapped = self.mapped.lock().unwrap();
+        self.len.store(0, Ordering::Release);
+        for base in self.bases.iter().take(mapped.len()) {
+            base.store(std::ptr::null_mut(), Ordering::Release);
+        }
+        let bytes: usize = mapped.iter().map(|slab| slab.shm.size()).sum();
+        STATS.mapped_bytes.fetch_sub(bytes as u64, Ordering::Relaxed);
+        mapped.clear();
+    }
+
+    /// Unmaps slabs the engine has retired and, with `advise`, drops this process' pages of the rest
+    /// with madvise(DONTNEED). The data stays in the shared memory objects, only the local page tables
+    /// and RSS are released, and prefaulted pages fault again on the next fill.
+    /// Does nothing while any SlabPin is alive.
+    pub fn reclaim(&self, advise: bool) -> ReclaimStats {
+        let mut stats = ReclaimStats::default();
+        let mut mapped = self.mapped.lock().unwrap();
+
+        if mapped.is_empty() {
+            return stats;
+        }
+        if LIVE_PINS.load(Ordering::SeqCst) > 0 {
+            STATS.reclaims_deferred.fetch_add(1, Ordering::Relaxed);
+            stats.deferred = true;
+            return stats;
+        }
+
+        let keep = self.retained_prefix(&mapped);
+        if keep < mapped.len() {
+            // Shrink first so new hydrations can't resolve into the tail, then make sure none started meanwhile
+            self.len.store(keep, Ordering::SeqCst);
+            if LIVE_PINS.load(Ordering::SeqCst) > 0 {
+                self.len.store(mapped.len(), Ordering::SeqCst);
+                STATS.reclaims_deferred.fetch_add(1, Ordering::Relaxed);
+                stats.deferred = true;
+                return stats;
+            }
+
+            for (index, slab) in mapped.drain(keep..).enumerate() {
+                self.bases[keep + index].store(std::ptr::null_mut(), Ordering::Release);
+                stats.unmapped_slabs += 1;
+                stats.unmapped_bytes += slab.shm.size();
+                println!(
+                    "[SDK] Unmapped retired memory slab [{}]: {:?}",
+                    keep + index,
+                    slab.handle
+                );
+            }
+            STATS.mapped_bytes.fetch_sub(stats.unmapped_bytes as u64, Ordering::Relaxed);
+            STATS.slabs_unmapped.fetch_add(stats.unmapped_slabs as u64, Ordering::Relaxed);
+        }
+
+        if advise {
+            // The root slab holds the live registry, everything after it only holds dropped asset data
+            for slab in mapped.iter().skip(1) {
+                stats.advised_bytes += advise_dont_need(&slab.shm);
+            }
+            STATS.reclaimed_bytes.fetch_add(stats.advised_bytes as u64, Ordering::Relaxed);
+        }
+
+        // Pick up replacements for the slabs we just unmapped
+        self.map_new_slabs(&mut mapped);
+        stats
+    }
+
+    /// Number of leading mapped slabs that still match the registry
+    fn retained_prefix(&self, mapped: &[MappedSlab]) -> usize {
+        let registry = unsafe { &*self.registry() };
+        let registered = self.registered_count().min(MAX_SLABS).max(1);
+
+        (1..mapped.len().min(registered))
+            .find(|&index| bytes_to_clean_str(&registry.slab_handles[index]) != mapped[index].handle.as_slice())
+            .unwrap_or(mapped.len().min(registered))
+    }
+
+    fn registry(&self) -> *const SlabRegistry {
+        self.bases[0].load(Ordering::Acquire) as *const SlabRegistry
+    }
+
+    /// Slab count as currently published by the engine in the root registry
+    fn registered_count(&self) -> usize {
+        let registry = self.registry();
+        unsafe { std::ptr::read_volatile(std::ptr::addr_of!((*registry).num_slabs)) as usize }
+    }
+
+    fn publish(&self, mapped: &mut Vec<MappedSlab>, handle: &[u8], shm: SharedMemory) {
+        let index = mapped.len();
+        let options = *self.options.lock().unwrap();
+        if index > 0 && !options.is_default() {
+            options.apply(&shm);
+        }
+        self.bases[index].store(shm.base_address().as_ptr() as *mut u8, Ordering::Release);
+        STATS.slabs_mapped.fetch_add(1, Ordering::Relaxed);
+        STATS.mapped_bytes.fetch_add(shm.size() as u64, Ordering::Relaxed);
+        mapped.push(MappedSlab {
+            handle: handle.to_vec(),
+            shm,
+        });
+        self.len.store(index + 1, Ordering::Release);
+    }
+
+    ///Checks the returned number of slabs and opens the ones at the end of the list until we have the correct ones open as the engine will only ever create new ones at the end
+    fn map_new_slabs(&self, mapped: &mut Vec<MappedSlab>) {
+        let registry = unsafe { &*self.registry() };
+        let target_count = self.registered_count().min(MAX_SLABS);
+
+        // If the Engine added a slab, Blender catches up here.
+        while mapped.len() < target_count {
+            let next_idx = mapped.len();
+            let handle = &registry.slab_handles[next_idx];
+
+            match open_shm(handle) {
+                Ok(shm) => {
+                    println!(
+                        "[SDK] Auto-mapped new memory slab [{}]: {:?}",
+                        next_idx,
+                        bytes_to_clean_str(handle)
+                    );
+                    self.publish(mapped, bytes_to_clean_str(handle), shm);
+                }
+                Err(e) => {
+                    eprintln!("[SDK] Failed to map discovered slab: {}", e);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+///Opens existing shm by u8 handle
+fn open_shm(handle: &[u8]) -> Result<SharedMemory, String> {
+    let clean_handle = bytes_to_clean_str(handle);
+    let file_name = match FileName::new(clean_handle) {
+        Ok(f) => f,
+        Err(e) => {
+            return Err(format!(
+                "invalid shared memory name '{:?}': {:?}",
+                clean_handle, e
+            ));
+        }
+    };
+
+    let shm = {
+        SharedMemoryBuilder::new(&file_name)
+            .open_existing(AccessMode::ReadWrite)
+            .expect("Failed to open shm")
+    };
+    Ok(shm)
+}
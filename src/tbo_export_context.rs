@@ -5,22 +5,88 @@
 //!
 //! Batches downsample and drop calls for efficiency.
 
+use pyo3::buffer::PyBuffer;
 use pyo3::prelude::*;
+use std::collections::VecDeque;
+use std::time::{Duration, Instant};
 
+use pivot_com_types::EngineResponse;
 use pivot_com_types::fields::Uuid;
 
 use crate::engine_api;
+use crate::shards::ShardHandles;
+use crate::tbo_file_stream::{TboFileWatcher, WATCH_INTERVAL};
+use crate::trace;
+use crate::typed_buffer::{contiguous_slice, record_slice};
 
 /// Channel bit flags (must match engine constants)
-const CHANNEL_X: u32 = 1 << 0;
-const CHANNEL_Y: u32 = 1 << 1;
-const CHANNEL_Z: u32 = 1 << 2;
-const CHANNEL_NORMAL_VARIANCE: u32 = 1 << 3;
-const CHANNEL_SURFACE_VARIATION: u32 = 1 << 4;
-const CHANNEL_COMBINED: u32 = 1 << 5;
+pub const CHANNEL_X: u32 = 1 << 0;
+pub const CHANNEL_Y: u32 = 1 << 1;
+pub const CHANNEL_Z: u32 = 1 << 2;
+pub const CHANNEL_NORMAL_VARIANCE: u32 = 1 << 3;
+pub const CHANNEL_SURFACE_VARIATION: u32 = 1 << 4;
+pub const CHANNEL_COMBINED: u32 = 1 << 5;
 const DEFAULT_CHANNEL_MASK: u32 = CHANNEL_X | CHANNEL_Y | CHANNEL_Z
     | CHANNEL_NORMAL_VARIANCE | CHANNEL_SURFACE_VARIATION | CHANNEL_COMBINED;
 
+/// Experimental encoding bits above the channel bits of the tbo_config mask. pivot-com-types
+/// does not define them yet, so they are only sent to engines declared with
+/// set_engine_capabilities(["experimental_tbo_encodings"]) and may still change.
+/// Without any of them every channel is written as a 4-byte float.
+pub const ENCODING_POSITION_INT16: u32 = 1 << 8;
+pub const ENCODING_VARIANCE_FP16: u32 = 1 << 9;
+pub const ENCODING_VARIANCE_BF16: u32 = 1 << 10;
+pub const ENCODING_COMPRESS_ZSTD: u32 = 1 << 11;
+
+/// Resolve encoding option names to encoding bits.
+///
+/// position: "f32" (default) or "int16" for X/Y/Z quantized to the normalized asset bounds,
+/// variance: "f32" (default), "fp16" or "bf16" for the normal variance and surface variation channels,
+/// compression: "none" (default) or "zstd" for per-chunk block compression
+fn resolve_encoding(position: Option<&str>, variance: Option<&str>, compression: Option<&str>) -> Result<u32, String> {
+    let position = match position.unwrap_or("f32") {
+        "f32" => 0,
+        "int16" => ENCODING_POSITION_INT16,
+        other => return Err(format!("Unknown position encoding '{}', expected f32 or int16", other)),
+    };
+    let variance = match variance.unwrap_or("f32") {
+        "f32" => 0,
+        "fp16" => ENCODING_VARIANCE_FP16,
+        "bf16" => ENCODING_VARIANCE_BF16,
+        other => return Err(format!("Unknown variance encoding '{}', expected f32, fp16 or bf16", other)),
+    };
+    let compression = match compression.unwrap_or("none") {
+        "none" => 0,
+        "zstd" => ENCODING_COMPRESS_ZSTD,
+        other => return Err(format!("Unknown compression '{}', expected none or zstd", other)),
+    };
+    Ok(position | variance | compression)
+}
+
+/// Short description of the encoding bits for the config log line.
+fn encoding_label(encoding: u32) -> String {
+    let position = if encoding & ENCODING_POSITION_INT16 != 0 { "int16" } else { "f32" };
+    let variance = if encoding & ENCODING_VARIANCE_FP16 != 0 {
+        "fp16"
+    } else if encoding & ENCODING_VARIANCE_BF16 != 0 {
+        "bf16"
+    } else {
+        "f32"
+    };
+    let compression = if encoding & ENCODING_COMPRESS_ZSTD != 0 { "zstd" } else { "none" };
+    format!("pos={}/var={}/compress={}", position, variance, compression)
+}
+
+/// Uncompressed bytes one point of `channel` takes on disk under `encoding`.
+pub fn channel_bytes(channel: u32, encoding: u32) -> u64 {
+    match channel {
+        CHANNEL_X | CHANNEL_Y | CHANNEL_Z if encoding & ENCODING_POSITION_INT16 != 0 => 2,
+        CHANNEL_NORMAL_VARIANCE | CHANNEL_SURFACE_VARIATION
+            if encoding & (ENCODING_VARIANCE_FP16 | ENCODING_VARIANCE_BF16) != 0 => 2,
+        _ => 4,
+    }
+}
+
 /// Count set bits in a 6-bit channel mask.
 fn popcount(mask: u32) -> u32 {
     let mut count = 0;
@@ -32,14 +98,51 @@ fn popcount(mask: u32) -> u32 {
     count
 }
 
-/// Resolve channel mask from legacy flags value.
-fn resolve_channel_mask(flags: u32) -> u32 {
+/// Resolve channel mask from legacy flags value, rejecting bits that are not channels.
+fn resolve_channel_mask(flags: u32) -> Result<u32, String> {
     if flags == 0x1 {
-        DEFAULT_CHANNEL_MASK
+        Ok(DEFAULT_CHANNEL_MASK)
     } else if flags == 0 {
-        CHANNEL_X | CHANNEL_Y | CHANNEL_Z
+        Ok(CHANNEL_X | CHANNEL_Y | CHANNEL_Z)
+    } else if flags & !DEFAULT_CHANNEL_MASK != 0 {
+        Err(format!(
+            "flags 0x{:x} has bits outside the channel mask 0x{:x}, encodings are set with position_encoding, variance_encoding and compression",
+            flags, DEFAULT_CHANNEL_MASK
+        ))
     } else {
-        flags
+        Ok(flags)
+    }
+}
+
+/// Feedback controller for batch size and flush point.
+///
+/// Grows the batch while tbo_downsample round-trips stay well under the target
+/// latency and shrinks it when they overshoot or the engine had to map new slabs
+/// to hold the batch. The flush point follows the bytes the engine actually
+/// accumulated rather than the static clamped threshold.
+struct AutoTune {
+    min_batch_size: usize,
+    max_batch_size: usize,
+    target_latency: Duration,
+    /// Slabs the engine may add between flushes before we force one
+    max_slab_growth: usize,
+    slabs_at_last_flush: usize,
+}
+
+impl AutoTune {
+    const GROW: f64 = 1.25;
+    const SHRINK: f64 = 0.7;
+
+    /// New batch size after a downsample of `batch` meshes took `latency` and the slab count went from `slabs_before` to `slabs_after`
+    fn next_batch_size(&self, batch: usize, latency: Duration, slabs_before: usize, slabs_after: usize) -> usize {
+        let next = if latency > self.target_latency || slabs_after > slabs_before {
+            (batch as f64 * Self::SHRINK) as usize
+        } else if latency < self.target_latency / 2 {
+            ((batch as f64 * Self::GROW) as usize).max(batch + 1)
+        } else {
+            batch
+        };
+        next.clamp(self.min_batch_size, self.max_batch_size)
     }
 }
 
@@ -66,14 +169,30 @@ pub struct TboExportContext {
     flags: u32,
     target_point_count: u32,
     channel_mask: u32,
+    /// ENCODING_* bits sent along with channel_mask
+    encoding: u32,
     accumulated_count: u64,
     flush_threshold: u64,
+    /// First batch number neither a finished nor an outstanding flush can write to
     next_batch_number: u32,
+    /// One past the highest batch number a finished flush actually wrote
+    written_until: u32,
     batch_size: usize,
-    pending_downsample: Vec<Vec<u8>>,
-    pending_drop: Vec<Vec<u8>>,
+    /// UUIDs waiting for the next downsample + drop batch (both use the same set)
+    pending: Vec<Uuid>,
     export_mode: TboExportMode,
     skip_normalization: bool,
+    /// Drop of the previous batch, left in flight so it overlaps the next batch's ingest
+    inflight_drop: Option<ShardHandles>,
+    /// Points mode flushes allowed in flight at once, 0 keeps flush() synchronous
+    max_outstanding_flushes: usize,
+    /// Background flushes with the batch offset each was given
+    outstanding_flushes: VecDeque<(ShardHandles, u32)>,
+    /// Files from finished background flushes not yet returned to Python
+    completed_files: Vec<String>,
+    auto_tune: Option<AutoTune>,
+    /// Called with (filename, size_bytes) as soon as the shard that wrote a file answers
+    file_callback: Option<Py<PyAny>>,
 }
 
 #[pymethods]
@@ -86,14 +205,21 @@ impl TboExportContext {
             flags: 0,
             target_point_count: 1024,
             channel_mask: 0,
+            encoding: 0,
             accumulated_count: 0,
             flush_threshold: 0,
             next_batch_number: 0,
+            written_until: 0,
             batch_size: 900,
-            pending_downsample: Vec::new(),
-            pending_drop: Vec::new(),
+            pending: Vec::new(),
             export_mode: TboExportMode::Points,
             skip_normalization: false,
+            inflight_drop: None,
+            max_outstanding_flushes: 0,
+            outstanding_flushes: VecDeque::new(),
+            completed_files: Vec::new(),
+            auto_tune: None,
+            file_callback: None,
         }
     }
 
@@ -107,9 +233,20 @@ impl TboExportContext {
     ///     batch_size: Number of UUIDs per downsample+drop batch
     ///     export_mode: Export mode - "points" for mesh TBO, "meshes" for asset TBO
     ///     skip_normalization: Skip per-asset centering and unit scaling in transforms
-    #[pyo3(text_signature = "(self, output_dir, target_bytes, flags, target_point_count, batch_size, export_mode, skip_normalization)")]
+    ///     position_encoding: Points mode X/Y/Z as "f32" (default) or quantized "int16"
+    ///     variance_encoding: Points mode normal variance and surface variation as "f32" (default), "fp16" or "bf16"
+    ///     compression: "none" (default) or "zstd" block compression of each written chunk
+    ///
+    /// The flush threshold follows the encoded size; compression is not accounted for,
+    /// so compressed files come out smaller than target_bytes. The encodings are
+    /// experimental and need an engine declared with
+    /// set_engine_capabilities(["experimental_tbo_encodings"]).
+    ///
+    /// Raises ValueError if flags has bits outside the channel mask.
+    #[pyo3(signature = (output_dir, target_bytes, flags, target_point_count, batch_size, export_mode=None, skip_normalization=false, position_encoding=None, variance_encoding=None, compression=None))]
     fn init(
         &mut self,
+        py: Python,
         output_dir: String,
         target_bytes: u64,
         flags: u32,
@@ -117,18 +254,36 @@ impl TboExportContext {
         batch_size: usize,
         export_mode: Option<String>,
         skip_normalization: bool,
+        position_encoding: Option<String>,
+        variance_encoding: Option<String>,
+        compression: Option<String>,
     ) -> PyResult<()> {
+        let _span = trace::span("tbo_init");
+        let encoding = resolve_encoding(position_encoding.as_deref(), variance_encoding.as_deref(), compression.as_deref())
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyValueError, _>(e))?;
+        let channel_mask = resolve_channel_mask(flags)
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyValueError, _>(e))?;
+        // An engine that doesn't know the bits writes f32 anyway, and the threshold would be off
+        if encoding != 0 && !engine_api::engine_supports_tbo_encodings() {
+            return Err(PyErr::new::<pyo3::exceptions::PyValueError, _>(
+                "The engine has not been declared to support TBO encodings, call set_engine_capabilities([\"experimental_tbo_encodings\"]) for engines that do",
+            ));
+        }
         self.output_dir = output_dir;
         self.target_bytes = target_bytes;
         self.flags = flags;
         self.target_point_count = target_point_count;
-        self.channel_mask = resolve_channel_mask(flags);
+        self.channel_mask = channel_mask;
+        self.encoding = encoding;
         self.batch_size = batch_size;
         self.skip_normalization = skip_normalization;
         self.accumulated_count = 0;
+        self.pending.clear();
+        self.wait_inflight_drop(py)?;
+        self.wait_outstanding_flushes(py, 0)?;
+        self.completed_files.clear();
         self.next_batch_number = 0;
-        self.pending_downsample.clear();
-        self.pending_drop.clear();
+        self.written_until = 0;
 
         // Set export mode
         self.export_mode = match export_mode.as_deref() {
@@ -136,6 +291,13 @@ impl TboExportContext {
             Some("lbo") => TboExportMode::Lbo,
             _ => TboExportMode::Points,
         };
+        // Meshes and LBO exports are not configured through tbo_config, so there is nowhere to send the encoding
+        if self.encoding != 0 && !matches!(self.export_mode, TboExportMode::Points) {
+            self.encoding = 0;
+            return Err(PyErr::new::<pyo3::exceptions::PyValueError, _>(
+                "position_encoding, variance_encoding and compression only apply to points mode",
+            ));
+        }
 
         // Compute flush threshold: how many objects fill target_bytes
         if matches!(self.export_mode, TboExportMode::Meshes) {
@@ -144,8 +306,7 @@ impl TboExportContext {
             self.flush_threshold = target_bytes / per_object_bytes;
         } else {
             // Points mode: target_point_count * channel_count * 4 bytes per mesh
-            let channel_count = popcount(self.channel_mask) as u64;
-            let per_mesh_bytes = (target_point_count as u64) * channel_count * 4;
+            let per_mesh_bytes = self.per_mesh_bytes();
             self.flush_threshold = if per_mesh_bytes > 0 {
                 let threshold = target_bytes / per_mesh_bytes;
                 if threshold < 1000 {
@@ -174,19 +335,21 @@ impl TboExportContext {
         } else {
             let channel_count = popcount(self.channel_mask) as u64;
             eprintln!(
-                "[TBO] Config: target={} GB, channels={}, pts={}, mode={}, flush_threshold={}, batch_size={}",
+                "[TBO] Config: target={} GB, channels={}, pts={}, encoding={}, mode={}, flush_threshold={}, batch_size={}",
                 target_bytes as f64 / (1024.0 * 1024.0 * 1024.0),
                 channel_count,
                 target_point_count,
+                encoding_label(self.encoding),
                 mode_label,
                 self.flush_threshold,
                 self.batch_size,
             );
         }
 
-        // Configure engine with compute params only (for points mode)
+        // Configure engine with compute params only (for points mode), the encoding rides in the upper mask bits
         if let TboExportMode::Points = &self.export_mode {
-            engine_api::tbo_config_command(self.channel_mask, self.target_point_count)
+            let (channel_mask, target_point_count) = (self.channel_mask | self.encoding, self.target_point_count);
+            py.detach(|| engine_api::tbo_config_command(channel_mask, target_point_count))
                 .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
         }
 
@@ -204,79 +367,123 @@ impl TboExportContext {
     ///
     /// Returns:
     ///     Number of meshes accumulated in this call (1 if batch flushed, 0 if still pending)
-    fn accumulate(&mut self, uuid_bytes: Vec<u8>, object_count: u32) -> PyResult<u32> {
+    fn accumulate(&mut self, py: Python, uuid_bytes: Vec<u8>, object_count: u32) -> PyResult<u32> {
         if uuid_bytes.len() != Uuid::SIZE {
             return Err(PyErr::new::<pyo3::exceptions::PyValueError, _>(
                 format!("UUID must be {} bytes, got {}", Uuid::SIZE, uuid_bytes.len()),
             ));
         }
 
+        let mut uuid = Uuid { bytes: [0u8; Uuid::SIZE] };
+        uuid.bytes.copy_from_slice(&uuid_bytes);
+
         // For meshes/lbo mode, track object count for flush threshold
         if matches!(self.export_mode, TboExportMode::Meshes | TboExportMode::Lbo) {
             self.accumulated_count += object_count as u64;
-            self.pending_downsample.push(uuid_bytes.clone());
-            self.pending_drop.push(uuid_bytes);
+            self.pending.push(uuid);
             return Ok(0);
         }
 
-        self.pending_downsample.push(uuid_bytes.clone());
-        self.pending_drop.push(uuid_bytes);
+        self.pending.push(uuid);
 
         // Check if batch is full - downsample immediately to avoid buffer overflow
-        if self.pending_downsample.len() >= self.batch_size {
-            return self.flush_pending();
+        if self.pending.len() >= self.batch_size {
+            return self.flush_pending(py);
         }
 
         Ok(0)
     }
 
+    /// Add many mesh UUIDs in one call, flushing full batches along the way.
+    ///
+    /// Args:
+    ///     uuid_buffer: Packed UUIDs (32 bytes each) in any buffer-protocol object
+    ///     object_counts: u32 buffer with one object count per UUID (for meshes mode tracking)
+    ///
+    /// Returns:
+    ///     Number of meshes accumulated by the batches flushed during this call
+    fn accumulate_many(
+        &mut self,
+        py: Python,
+        uuid_buffer: PyBuffer<u8>,
+        object_counts: PyBuffer<u32>,
+    ) -> PyResult<u32> {
+        let _span = trace::span("tbo_accumulate_many");
+        let uuids: &[Uuid] =
+            record_slice(contiguous_slice(&uuid_buffer, "uuid_buffer")?, "uuid_buffer")?;
+        let object_counts = contiguous_slice(&object_counts, "object_counts")?;
+
+        if object_counts.len() != uuids.len() {
+            return Err(PyErr::new::<pyo3::exceptions::PyValueError, _>(format!(
+                "object_counts has {} entries, expected {}",
+                object_counts.len(),
+                uuids.len()
+            )));
+        }
+
+        if matches!(self.export_mode, TboExportMode::Meshes | TboExportMode::Lbo) {
+            self.accumulated_count += object_counts.iter().map(|&c| c as u64).sum::<u64>();
+            self.pending.extend_from_slice(uuids);
+            return Ok(0);
+        }
+
+        let mut accumulated = 0;
+        let mut remaining = uuids;
+        while !remaining.is_empty() {
+            let room = self.batch_size.saturating_sub(self.pending.len()).max(1);
+            let (batch, rest) = remaining.split_at(room.min(remaining.len()));
+            self.pending.extend_from_slice(batch);
+            remaining = rest;
+
+            if self.pending.len() >= self.batch_size {
+                accumulated += self.flush_pending(py)?;
+            }
+        }
+
+        Ok(accumulated)
+    }
+
     /// Flush pending downsample and drop calls to the engine.
-    fn flush_pending(&mut self) -> PyResult<u32> {
-        if self.pending_downsample.is_empty() {
+    fn flush_pending(&mut self, py: Python) -> PyResult<u32> {
+        if self.pending.is_empty() {
             return Ok(0);
         }
+        let _span = trace::span("tbo_flush_pending");
 
         // For meshes/lbo mode, skip downsample/drop (export does its own)
         if matches!(&self.export_mode, TboExportMode::Meshes | TboExportMode::Lbo) {
-            self.pending_downsample.clear();
-            self.pending_drop.clear();
+            self.pending.clear();
             return Ok(0);
         }
 
-        let downsample_uuids = std::mem::take(&mut self.pending_downsample);
-        let drop_uuids = std::mem::take(&mut self.pending_drop);
-
-        // Downsample
-        let pivot_downsample: Result<Vec<Uuid>, PyErr> = downsample_uuids
-            .iter()
-            .map(|bytes| {
-                let mut uuid = Uuid { bytes: [0u8; Uuid::SIZE] };
-                uuid.bytes.copy_from_slice(bytes);
-                Ok(uuid)
-            })
-            .collect();
+        // The same batch is downsampled and then dropped, so it is handed over without copying
+        let batch = std::mem::take(&mut self.pending);
+        let count = batch.len();
 
-        let pivot_downsample = pivot_downsample?;
-        let count = pivot_downsample.len();
+        let slabs_before = engine_api::registered_slab_count();
+        let started = Instant::now();
+        let result = py.detach(|| engine_api::tbo_downsample_command(&batch));
+        let latency = started.elapsed();
+        trace::complete("tbo_downsample", started, started + latency, 0);
 
-        match engine_api::tbo_downsample_command(pivot_downsample) {
-            Ok(resp) => {
-                let accumulated = resp.read_tbo_downsample();
+        match result {
+            Ok(accumulated) => {
                 self.accumulated_count += accumulated as u64;
 
+                if let Some(tune) = &self.auto_tune {
+                    self.batch_size =
+                        tune.next_batch_size(count, latency, slabs_before, engine_api::registered_slab_count());
+                }
+
                 // Drop
-                let pivot_drop: Result<Vec<Uuid>, PyErr> = drop_uuids
-                    .iter()
-                    .map(|bytes| {
-                        let mut uuid = Uuid { bytes: [0u8; Uuid::SIZE] };
-               uuid.bytes.copy_from_slice(&bytes);
-                        Ok(uuid)
-                    })
-                    .collect();
-
-                let pivot_drop = pivot_drop.map_err(|e| e)?;
-                engine_api::drop_groups_command(pivot_drop)
+                let pivot_drop = batch;
+
+                // Only one drop is kept outstanding, the previous one has had a whole batch to finish
+                self.wait_inflight_drop(py)?;
+                let handle = py
+                    .detach(|| engine_api::submit_drop_groups_command(pivot_drop))
                     .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
+                self.inflight_drop = Some(handle);
 
                 Ok(accumulated)
             }
@@ -293,7 +500,7 @@ impl TboExportContext {
     ///
     /// Returns:
     ///     Number of meshes successfully accumulated
-    fn downsample(&mut self, uuids: Vec<Vec<u8>>) -> PyResult<u32> {
+    fn downsample(&mut self, py: Python, uuids: Vec<Vec<u8>>) -> PyResult<u32> {
         // For meshes/lbo mode, skip downsample (export does its own)
         if matches!(&self.export_mode, TboExportMode::Meshes | TboExportMode::Lbo) {
             return Ok(uuids.len() as u32);
@@ -316,9 +523,8 @@ impl TboExportContext {
         let pivot_uuids = pivot_uuids?;
         let count = pivot_uuids.len();
 
-        match engine_api::tbo_downsample_command(pivot_uuids) {
-            Ok(resp) => {
-                let accumulated = resp.read_tbo_downsample();
+        match py.detach(|| engine_api::tbo_downsample_command(&pivot_uuids)) {
+            Ok(accumulated) => {
                 self.accumulated_count += accumulated as u64;
                 Ok(accumulated)
             }
@@ -332,7 +538,7 @@ impl TboExportContext {
     ///
     /// Args:
     ///     uuids: List of UUID byte arrays (each 32 bytes)
-    fn drop(&self, uuids: Vec<Vec<u8>>) -> PyResult<()> {
+    fn drop(&self, py: Python, uuids: Vec<Vec<u8>>) -> PyResult<()> {
         // For meshes/lbo mode, skip drop (export does its own)
         if matches!(&self.export_mode, TboExportMode::Meshes | TboExportMode::Lbo) {
             return Ok(());
@@ -349,34 +555,141 @@ impl TboExportContext {
 
         let pivot_uuids = pivot_uuids.map_err(|e| e)?;
 
-        engine_api::drop_groups_command(pivot_uuids)
+        py.detach(|| engine_api::drop_groups_command(pivot_uuids))
             .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))?;
 
         Ok(())
     }
 
+    /// Let the context tune batch_size and the flush point from engine feedback.
+    ///
+    /// batch_size then follows measured tbo_downsample latency and slab growth,
+    /// and needs_flush triggers once the meshes the engine reports as accumulated
+    /// fill target_bytes, or once the engine has mapped max_slab_growth new slabs
+    /// since the last flush. Points mode only.
+    ///
+    /// Args:
+    ///     min_batch_size: Lower bound for batch_size
+    ///     max_batch_size: Upper bound for batch_size
+    ///     target_latency_ms: Downsample round-trip to aim for per batch
+    ///     max_slab_growth: New slabs tolerated between flushes before forcing one
+    #[pyo3(signature = (min_batch_size=100, max_batch_size=20000, target_latency_ms=20.0, max_slab_growth=4))]
+    fn enable_auto_tune(
+        &mut self,
+        min_batch_size: usize,
+        max_batch_size: usize,
+        target_latency_ms: f64,
+        max_slab_growth: usize,
+    ) -> PyResult<()> {
+        if min_batch_size == 0 || min_batch_size > max_batch_size {
+            return Err(PyErr::new::<pyo3::exceptions::PyValueError, _>(
+                format!("invalid batch size range {}..{}", min_batch_size, max_batch_size),
+            ));
+        }
+
+        self.batch_size = self.batch_size.clamp(min_batch_size, max_batch_size);
+        self.auto_tune = Some(AutoTune {
+            min_batch_size,
+            max_batch_size,
+            target_latency: Duration::from_secs_f64(target_latency_ms.max(0.0) / 1000.0),
+            max_slab_growth,
+            slabs_at_last_flush: engine_api::registered_slab_count(),
+        });
+        Ok(())
+    }
+
+    fn disable_auto_tune(&mut self) {
+        self.auto_tune = None;
+    }
+
+    /// Keep Points mode flushes running in the background.
+    ///
+    /// With max_outstanding > 0, flush() submits tbo_flush and returns immediately
+    /// so accumulate/downsample for the next generation overlaps the engine writing
+    /// the previous one. flush() then returns the files of flushes that have finished
+    /// so far, and blocks only when more than max_outstanding are still running.
+    /// finalize() waits for all of them. A flush submitted while others are still running
+    /// gets a batch number range none of them can reach, so numbering skips ahead then;
+    /// once they finished, numbering continues right after the last file written.
+    ///
+    /// Args:
+    ///     max_outstanding: Flushes allowed in flight (0 = synchronous, the default)
+    fn set_pipelined_flush(&mut self, py: Python, max_outstanding: usize) -> PyResult<()> {
+        self.max_outstanding_flushes = max_outstanding;
+        self.wait_outstanding_flushes(py, max_outstanding)
+    }
+
+    /// Get told about every written file before flush() returns.
+    ///
+    /// During a synchronous flush or meshes export the output directory is watched, and
+    /// the callback is called with (path, size_bytes) as soon as the engine has moved on
+    /// from a file, so uploads can start while it is still writing; the last files of
+    /// each shard come with its response. In pipelined mode the callback runs per shard
+    /// when a background flush is collected, with the filename the engine reported.
+    /// size_bytes is None if the file can't be found below output_dir.
+    /// An exception raised by the callback fails the flush.
+    ///
+    /// Args:
+    ///     callback: Callable taking (filename, size_bytes), or None to remove it
+    #[pyo3(signature = (callback=None))]
+    fn set_file_callback(&mut self, callback: Option<Py<PyAny>>) {
+        self.file_callback = callback;
+    }
+
     /// Flush accumulated downsampled data to .tbo files on disk.
     ///
     /// Returns:
-    ///     List of written .tbo filenames
-    fn flush(&mut self) -> PyResult<Vec<String>> {
+    ///     List of written .tbo filenames (in pipelined mode: those finished since the last call)
+    fn flush(&mut self, py: Python) -> PyResult<Vec<String>> {
+        let _span = trace::span("tbo_flush");
         match &self.export_mode {
+            TboExportMode::Points if self.max_outstanding_flushes > 0 => {
+                self.flush_pending(py)?;
+                self.wait_inflight_drop(py)?;
+
+                // Nothing outstanding can still write into the unused part of earlier reservations
+                if self.outstanding_flushes.is_empty() {
+                    self.next_batch_number = self.written_until;
+                }
+                let batch_offset = self.next_batch_number;
+                self.next_batch_number += self.reserved_files();
+                self.accumulated_count = 0;
+                self.reset_slab_baseline();
+
+                // Groups are already dropped batch by batch, skipping drop_all_groups here keeps the next generation alive
+                let (output_dir, target_bytes) = (&self.output_dir, self.target_bytes);
+                let handle = py
+                    .detach(|| engine_api::submit_tbo_flush_command(output_dir, target_bytes, batch_offset))
+                    .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
+                        format!("tbo_flush failed: {}", e),
+                    ))?;
+                self.outstanding_flushes.push_back((handle, batch_offset));
+
+                self.collect_finished_flushes(py)?;
+                self.wait_outstanding_flushes(py, self.max_outstanding_flushes)?;
+                Ok(std::mem::take(&mut self.completed_files))
+            }
             TboExportMode::Points => {
-                self.flush_pending()?;
+                self.flush_pending(py)?;
+                self.wait_inflight_drop(py)?;
                 let batch_offset = self.next_batch_number;
-                match engine_api::tbo_flush_command(&self.output_dir, self.target_bytes, batch_offset) {
-                    Ok(resp) => {
-                        let filenames = resp.read_tbo_flush()
-                            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
-                                format!("Failed to read flush response: {}", e),
-                            ))?;
-                        let result: Vec<String> = filenames.into_iter().map(|s| s.to_string()).collect();
+                let watcher = self.file_watcher()?;
+                let (output_dir, target_bytes) = (&self.output_dir, self.target_bytes);
+                let handles = py
+                    .detach(|| engine_api::submit_tbo_flush_command(output_dir, target_bytes, batch_offset))
+                    .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
+                        format!("tbo_flush failed: {}", e),
+                    ))?;
+                match self.collect_files(py, handles, watcher)? {
+                    Ok(result) => {
                         // Update batch offset for next flush
                         self.next_batch_number += result.len() as u32;
+                        self.written_until = self.next_batch_number;
                         // Reset accumulated count so needs_flush works correctly for next batch
                         self.accumulated_count = 0;
+                        self.reset_slab_baseline();
                         // Drop all groups from scene graph to clear memory
-                        engine_api::drop_all_groups_command()
+                        py.detach(engine_api::drop_all_groups_command)
                             .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
                                 format!("drop_all_groups failed: {}", e),
                             ))?;
@@ -388,16 +701,19 @@ impl TboExportContext {
                 }
             }
             TboExportMode::Meshes => {
-                match engine_api::export_all_asset_tbo_command(&self.output_dir, self.target_bytes, self.skip_normalization) {
-                    Ok(resp) => {
-                        let filenames = resp.read_tbo_flush()
-                            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
-                                format!("Failed to read flush response: {}", e),
-                            ))?;
-                        let result: Vec<String> = filenames.into_iter().map(|s| s.to_string()).collect();
+                let watcher = self.file_watcher()?;
+                let (output_dir, target_bytes, skip_normalization) =
+                    (&self.output_dir, self.target_bytes, self.skip_normalization);
+                let handles = py
+                    .detach(|| engine_api::submit_export_all_asset_tbo_command(output_dir, target_bytes, skip_normalization))
+                    .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
+                        format!("export_all_asset_tbo failed: {}", e),
+                    ))?;
+                match self.collect_files(py, handles, watcher)? {
+                    Ok(result) => {
                         self.accumulated_count = 0;
                         // Drop all groups from scene graph to clear memory
-                        engine_api::drop_all_groups_command()
+                        py.detach(engine_api::drop_all_groups_command)
                             .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
                                 format!("drop_all_groups failed: {}", e),
                             ))?;
@@ -410,13 +726,14 @@ impl TboExportContext {
             }
             TboExportMode::Lbo => {
                 // Export all assets to LBO format
-                engine_api::export_all_command(&self.output_dir, self.target_bytes)
+                let (output_dir, target_bytes) = (&self.output_dir, self.target_bytes);
+                py.detach(|| engine_api::export_all_command(output_dir, target_bytes))
                     .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
                         format!("export_all failed: {}", e),
                     ))?;
                 
                 // Drop all groups from scene graph
-                engine_api::drop_all_groups_command()
+                py.detach(engine_api::drop_all_groups_command)
                     .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
                         format!("drop_all_groups failed: {}", e),
                     ))?;
@@ -431,14 +748,25 @@ impl TboExportContext {
     ///
     /// Returns:
     ///     Total number of meshes accumulated during this export session
-    fn finalize(&mut self) -> PyResult<u64> {
+    fn finalize(&mut self, py: Python) -> PyResult<u64> {
+        let _span = trace::span("tbo_finalize");
         // Flush any pending downsample/drop calls
-        if !self.pending_downsample.is_empty() {
-            self.flush_pending()?;
+        if !self.pending.is_empty() {
+            self.flush_pending(py)?;
         }
 
         // Flush to disk
-        let files = self.flush()?;
+        let mut files = self.flush(py)?;
+
+        // Wait out background flushes, then clear the scene graph like the synchronous path does
+        if !self.outstanding_flushes.is_empty() {
+            self.wait_outstanding_flushes(py, 0)?;
+            files.append(&mut self.completed_files);
+            py.detach(engine_api::drop_all_groups_command)
+                .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
+                    format!("drop_all_groups failed: {}", e),
+                ))?;
+        }
         
         match &self.export_mode {
             TboExportMode::Points => {
@@ -467,9 +795,21 @@ impl TboExportContext {
     /// Check if accumulated data exceeds flush threshold.
     #[getter]
     fn needs_flush(&self) -> bool {
+        if let (Some(tune), TboExportMode::Points) = (&self.auto_tune, &self.export_mode) {
+            let accumulated_bytes = self.accumulated_count * self.per_mesh_bytes();
+            let slab_growth = engine_api::registered_slab_count().saturating_sub(tune.slabs_at_last_flush);
+            return self.accumulated_count > 0
+                && (accumulated_bytes >= self.target_bytes || slab_growth >= tune.max_slab_growth);
+        }
         self.accumulated_count >= self.flush_threshold
     }
 
+    /// Current batch size (changes over time when auto-tune is enabled).
+    #[getter]
+    fn batch_size(&self) -> usize {
+        self.batch_size
+    }
+
     /// Get current accumulated mesh count.
     #[getter]
     fn accumulated_count(&self) -> u64 {
@@ -485,6 +825,174 @@ impl TboExportContext {
     /// Get number of pending UUIDs waiting to be flushed.
     #[getter]
     fn pending_count(&self) -> usize {
-        self.pending_downsample.len()
+        self.pending.len()
+    }
+}
+
+impl TboExportContext {
+    /// Output bytes for one downsampled mesh in points mode, before compression
+    fn per_mesh_bytes(&self) -> u64 {
+        let per_point: u64 = (0..6)
+            .map(|i| 1u32 << i)
+            .filter(|&channel| self.channel_mask & channel != 0)
+            .map(|channel| channel_bytes(channel, self.encoding))
+            .sum();
+        (self.target_point_count as u64) * per_point
+    }
+
+    /// Batch numbers reserved for the next pipelined flush. Every file holds at least one mesh,
+    /// so no shard can write more files than meshes were accumulated; a size based estimate
+    /// could come out short (per-shard remainders, headers) and let two flushes overwrite each other.
+    fn reserved_files(&self) -> u32 {
+        self.accumulated_count.clamp(1, u32::MAX as u64) as u32
+    }
+
+    /// Moves the files of background flushes that already finished (in submit order) to completed_files.
+    fn collect_finished_flushes(&mut self, py: Python) -> PyResult<()> {
+        while let Some((handle, batch_offset)) = self.outstanding_flushes.pop_front() {
+            let shards = handle.shards().to_vec();
+            match handle.try_wait() {
+                Ok(result) => self.complete_flush(py, result, &shards, batch_offset)?,
+                Err(handle) => {
+                    self.outstanding_flushes.push_front((handle, batch_offset));
+                    break;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    /// Blocks until at most `max_outstanding` background flushes are still running.
+    fn wait_outstanding_flushes(&mut self, py: Python, max_outstanding: usize) -> PyResult<()> {
+        while self.outstanding_flushes.len() > max_outstanding {
+            let (handle, batch_offset) = self.outstanding_flushes.pop_front().unwrap();
+            let _span = trace::span_with_id("tbo_wait_flush", handle.request_id());
+            let shards = handle.shards().to_vec();
+            let result = py.detach(|| handle.wait());
+            self.complete_flush(py, result, &shards, batch_offset)?;
+        }
+        Ok(())
+    }
+
+    /// `shards` are the shards of the flush's responses, in response order
+    fn complete_flush(
+        &mut self,
+        py: Python,
+        result: Result<Vec<EngineResponse>, String>,
+        shards: &[usize],
+        batch_offset: u32,
+    ) -> PyResult<()> {
+        let shard_files = result
+            .and_then(|responses| {
+                responses
+                    .iter()
+                    .map(|resp| engine_api::merge_tbo_flush(std::slice::from_ref(resp)))
+                    .collect::<Result<Vec<_>, String>>()
+            })
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
+                format!("tbo_flush failed: {}", e),
+            ))?;
+        // Every shard numbers its own directory from batch_offset
+        let most = shard_files.iter().map(Vec::len).max().unwrap_or(0);
+        self.written_until = self.written_until.max(batch_offset + most as u32);
+        for (&shard, files) in shards.iter().zip(shard_files) {
+            self.notify_files(py, shard, &files)?;
+            self.completed_files.extend(files);
+        }
+        Ok(())
+    }
+
+    /// A watcher over the output directories when a file callback wants files as they land,
+    /// taken before the command is submitted so older files are left out
+    fn file_watcher(&self) -> PyResult<Option<TboFileWatcher>> {
+        if self.file_callback.is_none() {
+            return Ok(None);
+        }
+        TboFileWatcher::new(&self.output_dir)
+            .map(Some)
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    /// Waits for every shard of a flush or export. With a watcher the output directories
+    /// are scanned in between, so the file callback gets each file as soon as the engine
+    /// has moved on from it, and a shard's response hands over the rest of its files.
+    /// Engine errors come back in the inner result once all shards answered, callback
+    /// exceptions propagate right away.
+    fn collect_files(
+        &self,
+        py: Python,
+        mut handles: ShardHandles,
+        mut watcher: Option<TboFileWatcher>,
+    ) -> PyResult<Result<Vec<String>, String>> {
+        let mut files = Vec::new();
+        let mut first_error = None;
+        loop {
+            let next = match watcher {
+                Some(_) => py.detach(|| handles.wait_next_timeout(WATCH_INTERVAL)),
+                None => py.detach(|| handles.wait_next()),
+            };
+            let Some((shard, response)) = next else {
+                if handles.is_empty() {
+                    break;
+                }
+                if let Some(watcher) = &mut watcher {
+                    self.call_file_callback(py, py.detach(|| watcher.scan()))?;
+                }
+                continue;
+            };
+
+            match response.and_then(|resp| engine_api::merge_tbo_flush(std::slice::from_ref(&resp))) {
+                Ok(shard_files) => {
+                    match &mut watcher {
+                        Some(watcher) => self.call_file_callback(py, watcher.take_listed(shard, shard_files.clone()))?,
+                        None => self.notify_files(py, shard, &shard_files)?,
+                    }
+                    files.extend(shard_files);
+                }
+                Err(e) => {
+                    first_error.get_or_insert(e);
+                }
+            }
+        }
+        Ok(first_error.map_or(Ok(files), Err))
+    }
+
+    /// Passes the files `shard` reported to the file callback
+    fn notify_files(&self, py: Python, shard: usize, files: &[String]) -> PyResult<()> {
+        if self.file_callback.is_some() {
+            let sized = files
+                .iter()
+                .map(|name| (name.clone(), engine_api::written_file_size(&self.output_dir, shard, name)))
+                .collect();
+            self.call_file_callback(py, sized)?;
+        }
+        Ok(())
+    }
+
+    fn call_file_callback(&self, py: Python, files: Vec<(String, Option<u64>)>) -> PyResult<()> {
+        if let Some(callback) = &self.file_callback {
+            for (name, size) in files {
+                callback.bind(py).call1((name, size))?;
+            }
+        }
+        Ok(())
+    }
+
+    fn reset_slab_baseline(&mut self) {
+        if let Some(tune) = &mut self.auto_tune {
+            tune.slabs_at_last_flush = engine_api::registered_slab_count();
+        }
+    }
+
+    /// Wait for the outstanding batch drop, if any, and surface its error.
+    fn wait_inflight_drop(&mut self, py: Python) -> PyResult<()> {
+        if let Some(handle) = self.inflight_drop.take() {
+            let _span = trace::span_with_id("tbo_wait_drop", handle.request_id());
+            py.detach(|| handle.wait())
+                .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(
+                    format!("drop_groups failed: {}", e),
+                ))?;
+        }
+        Ok(())
     }
 }
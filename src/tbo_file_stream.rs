@@ -0,0 +1,186 @@
+//! Files of a tbo_flush or export_all_asset_tbo as they land in the output directory.
+//!
+//! The engine only answers a flush once all of its files are on disk, so while
+//! the command is in flight the shards' output directories are scanned for new
+//! .tbo files. The engine writes them one after the other, so a file counts as
+//! finished once a later one appeared next to it and its size stopped changing;
+//! the last files of each shard come with that shard's response, which also
+//! lists anything the scans missed. Files already in the directories before the
+//! command started are never yielded.
+
+use pyo3::prelude::*;
+use std::collections::{HashMap, HashSet, VecDeque};
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::time::{Duration, SystemTime};
+
+use crate::engine_api;
+use crate::shards::ShardHandles;
+
+/// How often the output directories are scanned while no shard answers
+pub const WATCH_INTERVAL: Duration = Duration::from_millis(50);
+
+/// Picks up the files a flush or export writes into the shards' output directories
+pub struct TboFileWatcher {
+    /// Output directory the command writes into, for locating reported files
+    path: String,
+    /// Output directory of every shard, in shard order
+    dirs: Vec<PathBuf>,
+    /// Files already handed out or there before the command started, canonicalized
+    seen: HashSet<PathBuf>,
+    /// Size of the unfinished files at the previous scan
+    sizes: HashMap<PathBuf, u64>,
+}
+
+impl TboFileWatcher {
+    /// Records the files already in the output directories, create it before submitting the command
+    pub fn new(path: &str) -> Result<TboFileWatcher, String> {
+        let dirs = engine_api::tbo_output_dirs(path)?;
+        let seen = dirs
+            .iter()
+            .flat_map(|dir| tbo_files(dir))
+            .map(|(file, _, _)| canonical(&file))
+            .collect();
+
+        Ok(TboFileWatcher {
+            path: path.to_string(),
+            dirs,
+            seen,
+            sizes: HashMap::new(),
+        })
+    }
+
+    /// The files `shard` reported that no scan picked up yet, with their sizes
+    pub fn take_listed(&mut self, shard: usize, listed: Vec<String>) -> Vec<(String, Option<u64>)> {
+        let mut files = Vec::new();
+        for name in listed {
+            let Some(file) = engine_api::locate_written_file(&self.path, shard, &name) else {
+                files.push((name, None));
+                continue;
+            };
+            if self.seen.insert(canonical(&file)) {
+                self.sizes.remove(&file);
+                let size = fs::metadata(&file).ok().map(|meta| meta.len());
+                files.push((file.to_string_lossy().to_string(), size));
+            }
+        }
+        files
+    }
+
+    /// The new files the engine has moved on from, with their sizes
+    pub fn scan(&mut self) -> Vec<(String, Option<u64>)> {
+        let mut files = Vec::new();
+        for dir in &self.dirs {
+            let found = tbo_files(dir);
+            let Some(newest) = found.iter().map(|(_, modified, _)| *modified).max() else {
+                continue;
+            };
+
+            let mut finished = Vec::new();
+            for (file, modified, size) in found {
+                if self.seen.contains(&canonical(&file)) {
+                    continue;
+                }
+                // Unchanged since the last scan and older than the file being written now
+                let settled = self.sizes.insert(file.clone(), size) == Some(size);
+                if settled && modified < newest {
+                    finished.push((modified, file, size));
+                }
+            }
+
+            finished.sort();
+            for (_, file, size) in finished {
+                self.sizes.remove(&file);
+                self.seen.insert(canonical(&file));
+                files.push((file.to_string_lossy().to_string(), Some(size)));
+            }
+        }
+        files
+    }
+}
+
+#[pyclass(unsendable)]
+pub struct TboFileStream {
+    watcher: TboFileWatcher,
+    handles: ShardHandles,
+    /// Finished files not yet yielded, with their sizes
+    ready: VecDeque<(String, Option<u64>)>,
+}
+
+impl TboFileStream {
+    /// Records the files already in the output directories, then submits the command
+    pub fn start(
+        path: String,
+        submit: impl FnOnce() -> Result<ShardHandles, String>,
+    ) -> Result<TboFileStream, String> {
+        let watcher = TboFileWatcher::new(&path)?;
+        let handles = submit()?;
+
+        Ok(TboFileStream {
+            watcher,
+            handles,
+            ready: VecDeque::new(),
+        })
+    }
+
+    /// Next written file and its size, None once every shard answered
+    fn next_file(&mut self) -> Result<Option<(String, Option<u64>)>, String> {
+        loop {
+            if let Some(file) = self.ready.pop_front() {
+                return Ok(Some(file));
+            }
+            if self.handles.is_empty() {
+                return Ok(None);
+            }
+            match self.handles.wait_next_timeout(WATCH_INTERVAL) {
+                Some((shard, response)) => {
+                    let listed = engine_api::merge_tbo_flush(std::slice::from_ref(&response?))?;
+                    self.ready.extend(self.watcher.take_listed(shard, listed));
+                }
+                None => self.ready.extend(self.watcher.scan()),
+            }
+        }
+    }
+}
+
+/// The .tbo files directly in `dir` with their modification time and size
+fn tbo_files(dir: &Path) -> Vec<(PathBuf, SystemTime, u64)> {
+    let Ok(entries) = fs::read_dir(dir) else {
+        return Vec::new();
+    };
+    entries
+        .filter_map(|entry| {
+            let entry = entry.ok()?;
+            let file = entry.path();
+            if file.extension().is_none_or(|ext| ext != "tbo") {
+                return None;
+            }
+            let meta = entry.metadata().ok().filter(|meta| meta.is_file())?;
+            Some((file, meta.modified().ok()?, meta.len()))
+        })
+        .collect()
+}
+
+/// Key for telling files apart however the engine and the scans spell their paths
+fn canonical(file: &Path) -> PathBuf {
+    fs::canonicalize(file).unwrap_or_else(|_| file.to_path_buf())
+}
+
+#[pymethods]
+impl TboFileStream {
+    fn __iter__(slf: PyRef<'_, Self>) -> PyRef<'_, Self> {
+        slf
+    }
+
+    /// Blocks until the next file is written and returns (path, size_bytes).
+    /// size_bytes is None when a reported file can't be found below the output directory.
+    fn __next__(&mut self, py: Python) -> PyResult<Option<(String, Option<u64>)>> {
+        py.detach(|| self.next_file())
+            .map_err(|e| PyErr::new::<pyo3::exceptions::PyRuntimeError, _>(e))
+    }
+
+    /// Stop waiting for the shards that have not answered yet.
+    fn cancel(&self) {
+        self.handles.cancel();
+    }
+}
@@ -0,0 +1,444 @@
+//! Memory-mapped reader for the .tbo files TboExportContext has the engine write.
+//!
+//! Layout as this reader expects the engine's writer to produce it (little endian).
+//! The writer lives in pivot-core and shares no header definition with this crate,
+//! so the layout below is pinned by the engine-written file checked in at
+//! tests/fixtures/engine_points.tbo; the test at the bottom fails without it.
+//!
+//! | offset | size | field                                                        |
+//! |--------|------|--------------------------------------------------------------|
+//! | 0      | 4    | magic `TBO\0`                                                |
+//! | 4      | 4    | format version, 1                                            |
+//! | 8      | 4    | channel mask, CHANNEL_* bits plus ENCODING_* bits; 0 = meshes |
+//! | 12     | 4    | points per mesh, 0 in meshes mode                            |
+//! | 16     | 8    | mesh count                                                   |
+//! | 24     | 8    | byte offset of the first channel plane                      |
+//!
+//! The channels follow as planes in mask bit order, each a `[meshes, points]`
+//! array in the channel's encoding. Meshes mode files hold a `[meshes, 256]`
+//! f32 embedding plane followed by a `[meshes, 16]` f32 transform plane.
+//! Planes are exposed as views straight into the mapping, nothing is copied.
+
+use pyo3::exceptions::{PyIndexError, PyKeyError, PyRuntimeError, PyValueError};
+use pyo3::prelude::*;
+use pyo3::types::PyDict;
+use std::ffi::CStr;
+use std::fs::File;
+use std::os::fd::AsRawFd;
+use std::sync::Arc;
+
+use crate::tbo_export_context::{
+    CHANNEL_COMBINED, CHANNEL_NORMAL_VARIANCE, CHANNEL_SURFACE_VARIATION, CHANNEL_X, CHANNEL_Y, CHANNEL_Z,
+    ENCODING_COMPRESS_ZSTD, ENCODING_POSITION_INT16, ENCODING_VARIANCE_BF16, ENCODING_VARIANCE_FP16,
+    channel_bytes,
+};
+use crate::typed_buffer::TypedBuffer;
+
+const MAGIC: [u8; 4] = *b"TBO\0";
+const VERSION: u32 = 1;
+const HEADER_SIZE: usize = 32;
+
+const EMBEDDING_WIDTH: usize = 256;
+const TRANSFORM_WIDTH: usize = 16;
+
+/// Channels in plane order with the names Python uses for them
+const CHANNELS: [(u32, &str); 6] = [
+    (CHANNEL_X, "x"),
+    (CHANNEL_Y, "y"),
+    (CHANNEL_Z, "z"),
+    (CHANNEL_NORMAL_VARIANCE, "normal_variance"),
+    (CHANNEL_SURFACE_VARIATION, "surface_variation"),
+    (CHANNEL_COMBINED, "combined"),
+];
+
+/// Read-only file mapping, unmapped once the reader and every view are gone
+struct Mapping {
+    ptr: *mut u8,
+    len: usize,
+}
+
+// The mapping is read-only and only unmapped on drop
+unsafe impl Send for Mapping {}
+unsafe impl Sync for Mapping {}
+
+impl Mapping {
+    fn open(path: &str) -> Result<Mapping, String> {
+        let file = File::open(path).map_err(|e| format!("Failed to open {}: {}", path, e))?;
+        let len = file
+            .metadata()
+            .map_err(|e| format!("Failed to stat {}: {}", path, e))?
+            .len() as usize;
+        if len < HEADER_SIZE {
+            return Err(format!("{} is {} bytes, too short for a TBO header", path, len));
+        }
+
+        let ptr = unsafe {
+            libc::mmap(std::ptr::null_mut(), len, libc::PROT_READ, libc::MAP_SHARED, file.as_raw_fd(), 0)
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(format!("Failed to map {}: {}", path, std::io::Error::last_os_error()));
+        }
+        // The mapping keeps the file referenced, the descriptor can go
+        Ok(Mapping { ptr: ptr as *mut u8, len })
+    }
+
+    fn bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr, self.len) }
+    }
+
+    /// madvise over a byte range, widened to whole pages
+    fn advise(&self, offset: usize, len: usize, advice: libc::c_int) {
+        let page = unsafe { libc::sysconf(libc::_SC_PAGESIZE) }.max(1) as usize;
+        let start = offset / page * page;
+        let end = (offset + len).min(self.len);
+        if end <= start {
+            return;
+        }
+        let ret = unsafe { libc::madvise(self.ptr.add(start) as *mut libc::c_void, end - start, advice) };
+        if ret != 0 {
+            eprintln!("[SDK] madvise on TBO mapping failed: {}", std::io::Error::last_os_error());
+        }
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        unsafe {
+            libc::munmap(self.ptr as *mut libc::c_void, self.len);
+        }
+    }
+}
+
+/// One channel's `[meshes, width]` array inside the mapping
+struct Plane {
+    name: &'static str,
+    offset: usize,
+    width: usize,
+    itemsize: usize,
+    format: &'static CStr,
+}
+
+impl Plane {
+    fn row_bytes(&self) -> usize {
+        self.width * self.itemsize
+    }
+}
+
+/// Element type of a points mode channel; bf16 has no struct format and is exposed as raw `H` bits
+fn channel_format(channel: u32, encoding: u32) -> &'static CStr {
+    match channel {
+        CHANNEL_X | CHANNEL_Y | CHANNEL_Z if encoding & ENCODING_POSITION_INT16 != 0 => c"h",
+        CHANNEL_NORMAL_VARIANCE | CHANNEL_SURFACE_VARIATION if encoding & ENCODING_VARIANCE_FP16 != 0 => c"e",
+        CHANNEL_NORMAL_VARIANCE | CHANNEL_SURFACE_VARIATION if encoding & ENCODING_VARIANCE_BF16 != 0 => c"H",
+        _ => c"f",
+    }
+}
+
+fn read_u32(bytes: &[u8], offset: usize) -> u32 {
+    u32::from_le_bytes(bytes[offset..offset + 4].try_into().unwrap())
+}
+
+fn read_u64(bytes: &[u8], offset: usize) -> u64 {
+    u64::from_le_bytes(bytes[offset..offset + 8].try_into().unwrap())
+}
+
+/// The fixed header at the start of every .tbo file
+#[derive(Debug)]
+struct TboHeader {
+    channel_mask: u32,
+    point_count: usize,
+    mesh_count: usize,
+    data_offset: usize,
+}
+
+impl TboHeader {
+    fn parse(bytes: &[u8]) -> Result<TboHeader, String> {
+        if bytes.len() < HEADER_SIZE {
+            return Err(format!("{} bytes, too short for a TBO header", bytes.len()));
+        }
+        if bytes[0..4] != MAGIC {
+            return Err("not a TBO file".to_string());
+        }
+        let version = read_u32(bytes, 4);
+        if version != VERSION {
+            return Err(format!("TBO version {}, this SDK reads version {}", version, VERSION));
+        }
+        let channel_mask = read_u32(bytes, 8);
+        if channel_mask & ENCODING_COMPRESS_ZSTD != 0 {
+            return Err("block compressed and can't be mapped".to_string());
+        }
+        let point_count = read_u32(bytes, 12) as usize;
+        let mesh_count = usize::try_from(read_u64(bytes, 16)).map_err(|e| e.to_string())?;
+        let data_offset = usize::try_from(read_u64(bytes, 24)).map_err(|e| e.to_string())?;
+        if data_offset < HEADER_SIZE {
+            return Err(format!("data at {}, inside the header", data_offset));
+        }
+
+        Ok(TboHeader {
+            channel_mask,
+            point_count,
+            mesh_count,
+            data_offset,
+        })
+    }
+
+    /// Planes in file order and the offset right after the last one
+    fn planes(&self) -> Result<(Vec<Plane>, usize), String> {
+        // (name, width, itemsize, format) of every plane in file order
+        let layout: Vec<(&'static str, usize, usize, &'static CStr)> = if self.channel_mask == 0 {
+            vec![
+                ("embeddings", EMBEDDING_WIDTH, 4, c"f"),
+                ("transforms", TRANSFORM_WIDTH, 4, c"f"),
+            ]
+        } else {
+            CHANNELS
+                .iter()
+                .filter(|(channel, _)| self.channel_mask & channel != 0)
+                .map(|&(channel, name)| {
+                    let itemsize = channel_bytes(channel, self.channel_mask) as usize;
+                    (name, self.point_count, itemsize, channel_format(channel, self.channel_mask))
+                })
+                .collect()
+        };
+
+        let mut offset = self.data_offset;
+        let mut planes = Vec::with_capacity(layout.len());
+        for (name, width, itemsize, format) in layout {
+            // The mapping is page aligned, so this keeps every element of the view aligned
+            if offset % itemsize != 0 {
+                return Err(format!("plane {} at {} is not aligned to its {}-byte elements", name, offset, itemsize));
+            }
+            let size = self
+                .mesh_count
+                .checked_mul(width * itemsize)
+                .ok_or_else(|| format!("plane {} overflows", name))?;
+            planes.push(Plane { name, offset, width, itemsize, format });
+            offset = offset
+                .checked_add(size)
+                .ok_or_else(|| format!("plane {} overflows", name))?;
+        }
+        Ok((planes, offset))
+    }
+}
+
+#[pyclass(unsendable)]
+pub struct TboReader {
+    map: Arc<Mapping>,
+    mesh_count: usize,
+    point_count: usize,
+    channel_mask: u32,
+    planes: Vec<Plane>,
+}
+
+impl TboReader {
+    fn open(path: &str) -> Result<TboReader, String> {
+        let map = Mapping::open(path)?;
+        let header = TboHeader::parse(map.bytes()).map_err(|e| format!("{}: {}", path, e))?;
+        let (planes, end) = header.planes().map_err(|e| format!("{}: {}", path, e))?;
+        if end > map.len {
+            return Err(format!("{} is truncated: {} bytes, header describes {}", path, map.len, end));
+        }
+
+        Ok(TboReader {
+            map: Arc::new(map),
+            mesh_count: header.mesh_count,
+            point_count: header.point_count,
+            channel_mask: header.channel_mask,
+            planes,
+        })
+    }
+
+    /// Checks a mesh range, `stop` defaults to the end
+    fn range(&self, start: usize, stop: Option<usize>) -> PyResult<(usize, usize)> {
+        let stop = stop.unwrap_or(self.mesh_count);
+        if start > stop || stop > self.mesh_count {
+            return Err(PyErr::new::<PyIndexError, _>(format!(
+                "mesh range {}..{} out of bounds for {} meshes",
+                start, stop, self.mesh_count
+            )));
+        }
+        Ok((start, stop))
+    }
+
+    /// Zero-copy view of rows `start..stop` of a plane with the given shape, keeps the mapping alive
+    fn view(&self, py: Python, plane: &Plane, start: usize, stop: usize, shape: &[usize]) -> PyResult<Py<TypedBuffer>> {
+        let offset = plane.offset + start * plane.row_bytes();
+        let len = (stop - start) * plane.row_bytes();
+        let owner: Box<dyn std::any::Any> = Box::new(self.map.clone());
+        let buffer = unsafe {
+            TypedBuffer::new(self.map.ptr.add(offset), len, plane.itemsize, plane.format, shape, true, Some(owner))
+        };
+        Py::new(py, buffer)
+    }
+
+    fn plane(&self, name: &str) -> PyResult<&Plane> {
+        self.planes.iter().find(|plane| plane.name == name).ok_or_else(|| {
+            let names: Vec<&str> = self.planes.iter().map(|plane| plane.name).collect();
+            PyErr::new::<PyKeyError, _>(format!("No channel '{}', the file has {}", name, names.join(", ")))
+        })
+    }
+}
+
+#[pymethods]
+impl TboReader {
+    /// Map a .tbo file and validate its header.
+    ///
+    /// Args:
+    ///     path: File to read
+    ///     sequential: Tell the kernel the file will be read front to back, for aggressive readahead
+    #[new]
+    #[pyo3(signature = (path, sequential=false))]
+    fn new(path: String, sequential: bool) -> PyResult<Self> {
+        let reader = TboReader::open(&path).map_err(|e| PyErr::new::<PyRuntimeError, _>(e))?;
+        if sequential {
+            reader.map.advise(0, reader.map.len, libc::MADV_SEQUENTIAL);
+        }
+        Ok(reader)
+    }
+
+    /// Number of meshes (objects in meshes mode) in the file.
+    #[getter]
+    fn mesh_count(&self) -> usize {
+        self.mesh_count
+    }
+
+    /// Points per mesh, 0 for meshes mode files.
+    #[getter]
+    fn point_count(&self) -> usize {
+        self.point_count
+    }
+
+    /// "points" or "meshes".
+    #[getter]
+    fn mode(&self) -> &'static str {
+        if self.channel_mask == 0 { "meshes" } else { "points" }
+    }
+
+    /// Channel names in file order.
+    #[getter]
+    fn channels(&self) -> Vec<&'static str> {
+        self.planes.iter().map(|plane| plane.name).collect()
+    }
+
+    fn __len__(&self) -> usize {
+        self.mesh_count
+    }
+
+    /// Zero-copy view of one channel for meshes start..stop, shaped (meshes, points).
+    ///
+    /// Positions are `h` when written as int16, variance channels `e` for fp16 and
+    /// raw `H` bits for bf16, everything else `f`. The view keeps the file mapped.
+    #[pyo3(signature = (name, start=0, stop=None))]
+    fn channel(&self, py: Python, name: &str, start: usize, stop: Option<usize>) -> PyResult<Py<TypedBuffer>> {
+        let (start, stop) = self.range(start, stop)?;
+        let plane = self.plane(name)?;
+        self.view(py, plane, start, stop, &[stop - start, plane.width])
+    }
+
+    /// Every channel of one mesh as a dict of 1-D zero-copy views.
+    fn mesh<'py>(&self, py: Python<'py>, index: usize) -> PyResult<Bound<'py, PyDict>> {
+        if index >= self.mesh_count {
+            return Err(PyErr::new::<PyIndexError, _>(format!(
+                "mesh {} out of range for {} meshes",
+                index, self.mesh_count
+            )));
+        }
+        let dict = PyDict::new(py);
+        for plane in &self.planes {
+            dict.set_item(plane.name, self.view(py, plane, index, index + 1, &[plane.width])?)?;
+        }
+        Ok(dict)
+    }
+
+    /// Start reading meshes start..stop of every channel in the background (MADV_WILLNEED).
+    #[pyo3(signature = (start=0, stop=None))]
+    fn prefetch(&self, start: usize, stop: Option<usize>) -> PyResult<()> {
+        let (start, stop) = self.range(start, stop)?;
+        for plane in &self.planes {
+            let offset = plane.offset + start * plane.row_bytes();
+            self.map.advise(offset, (stop - start) * plane.row_bytes(), libc::MADV_WILLNEED);
+        }
+        Ok(())
+    }
+
+    /// Readahead hint for the whole file: "sequential", "random" or "normal".
+    fn set_access_pattern(&self, pattern: &str) -> PyResult<()> {
+        let advice = match pattern {
+            "sequential" => libc::MADV_SEQUENTIAL,
+            "random" => libc::MADV_RANDOM,
+            "normal" => libc::MADV_NORMAL,
+            other => {
+                return Err(PyErr::new::<PyValueError, _>(format!(
+                    "Unknown access pattern '{}', expected sequential, random or normal",
+                    other
+                )));
+            }
+        };
+        self.map.advise(0, self.map.len, advice);
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    //! Run with `cargo test --no-default-features`. PIVOT_TBO_FIXTURE points the layout
+    //! test at another engine-written file; PIVOT_TBO_FIXTURE_MASK and
+    //! PIVOT_TBO_FIXTURE_POINTS additionally check the channel mask and
+    //! target_point_count the export was configured with.
+
+    use super::*;
+
+    /// A points mode file pivot_engine wrote, checked in so the layout is tested on every run
+    const FIXTURE: &str = concat!(env!("CARGO_MANIFEST_DIR"), "/tests/fixtures/engine_points.tbo");
+
+    fn fixture_expectation(name: &str) -> Option<u64> {
+        let value = std::env::var(name).ok()?;
+        let parsed = match value.strip_prefix("0x") {
+            Some(hex) => u64::from_str_radix(hex, 16),
+            None => value.parse(),
+        };
+        Some(parsed.unwrap_or_else(|e| panic!("{}={} is not a number: {}", name, value, e)))
+    }
+
+    #[test]
+    fn engine_written_file_matches_layout() {
+        let path = std::env::var("PIVOT_TBO_FIXTURE").unwrap_or_else(|_| FIXTURE.to_string());
+        let bytes = std::fs::read(&path).unwrap_or_else(|e| {
+            panic!("Failed to read the engine-written fixture {}: {}, export one with pivot_engine", path, e)
+        });
+
+        let header = TboHeader::parse(&bytes).unwrap();
+        let (planes, end) = header.planes().unwrap();
+        assert!(header.mesh_count > 0, "fixture holds no meshes: {:?}", header);
+        assert_eq!(end, bytes.len(), "planes don't cover the file exactly: {:?}", header);
+        assert!(!planes.is_empty(), "fixture has no channels: {:?}", header);
+
+        if let Some(mask) = fixture_expectation("PIVOT_TBO_FIXTURE_MASK") {
+            assert_eq!(header.channel_mask as u64, mask);
+        }
+        if let Some(points) = fixture_expectation("PIVOT_TBO_FIXTURE_POINTS") {
+            assert_eq!(header.point_count as u64, points);
+        }
+    }
+
+    #[test]
+    fn rejects_foreign_header() {
+        let mut bytes = vec![0u8; HEADER_SIZE];
+        assert!(TboHeader::parse(&bytes).is_err());
+
+        bytes[0..4].copy_from_slice(&MAGIC);
+        bytes[4..8].copy_from_slice(&(VERSION + 1).to_le_bytes());
+        assert!(TboHeader::parse(&bytes).is_err());
+    }
+
+    #[test]
+    fn rejects_misaligned_planes() {
+        let header = TboHeader {
+            channel_mask: CHANNEL_X,
+            point_count: 1,
+            mesh_count: 1,
+            data_offset: HEADER_SIZE + 1,
+        };
+        assert!(header.planes().is_err());
+    }
+}
@@ -0,0 +1,339 @@
+//! Opt-in span tracing dumped as Chrome trace JSON (chrome://tracing, Perfetto).
+//!
+//! Spans go into a fixed ring of seqlocked slots claimed with a single
+//! fetch_add, so recording never blocks and the oldest spans are overwritten
+//! once the ring wraps. When tracing is off every entry point is one relaxed load.
+
+use std::cell::Cell;
+use std::fmt::Write as _;
+use std::sync::atomic::{AtomicBool, AtomicPtr, AtomicU8, AtomicU64, AtomicUsize, Ordering, fence};
+use std::sync::{LazyLock, Mutex};
+use std::time::Instant;
+
+/// Spans kept before the oldest are overwritten
+const CAPACITY: usize = 1 << 16;
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+static EPOCH: LazyLock<Instant> = LazyLock::new(Instant::now);
+static RING: LazyLock<Ring> = LazyLock::new(Ring::new);
+static NEXT_REQUEST_ID: AtomicU64 = AtomicU64::new(1);
+static NEXT_TID: AtomicU64 = AtomicU64::new(1);
+/// Thread labels for the trace metadata, only written once per thread
+static THREAD_NAMES: Mutex<Vec<(u64, String)>> = Mutex::new(Vec::new());
+
+thread_local! {
+    static TID: Cell<u64> = const { Cell::new(0) };
+}
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+enum Phase {
+    /// Nested span on the recording thread ("X")
+    Complete = 0,
+    /// Overlapping span keyed by request id, drawn on its own track ("b"/"e")
+    Async = 1,
+}
+
+struct Slot {
+    /// Odd while being written, 2 * (claim index + 1) once complete
+    seq: AtomicU64,
+    name_ptr: AtomicPtr<u8>,
+    name_len: AtomicUsize,
+    phase: AtomicU8,
+    tid: AtomicU64,
+    start_ns: AtomicU64,
+    dur_ns: AtomicU64,
+    request_id: AtomicU64,
+}
+
+struct Ring {
+    slots: Box<[Slot]>,
+    head: AtomicUsize,
+}
+
+struct Event {
+    name: &'static str,
+    phase: Phase,
+    tid: u64,
+    start_ns: u64,
+    dur_ns: u64,
+    request_id: u64,
+}
+
+impl Ring {
+    fn new() -> Self {
+        Ring {
+            slots: (0..CAPACITY)
+                .map(|_| Slot {
+                    seq: AtomicU64::new(0),
+                    name_ptr: AtomicPtr::new(std::ptr::null_mut()),
+                    name_len: AtomicUsize::new(0),
+                    phase: AtomicU8::new(0),
+                    tid: AtomicU64::new(0),
+                    start_ns: AtomicU64::new(0),
+                    dur_ns: AtomicU64::new(0),
+                    request_id: AtomicU64::new(0),
+                })
+                .collect(),
+            head: AtomicUsize::new(0),
+        }
+    }
+
+    fn push(&self, event: Event) {
+        let index = self.head.fetch_add(1, Ordering::Relaxed);
+        let slot = &self.slots[index % CAPACITY];
+        let done = 2 * (index as u64 + 1);
+
+        slot.seq.store(done - 1, Ordering::Relaxed);
+        fence(Ordering::Release);
+        slot.name_ptr.store(event.name.as_ptr() as *mut u8, Ordering::Relaxed);
+        slot.name_len.store(event.name.len(), Ordering::Relaxed);
+        slot.phase.store(event.phase as u8, Ordering::Relaxed);
+        slot.tid.store(event.tid, Ordering::Relaxed);
+        slot.start_ns.store(event.start_ns, Ordering::Relaxed);
+        slot.dur_ns.store(event.dur_ns, Ordering::Relaxed);
+        slot.request_id.store(event.request_id, Ordering::Relaxed);
+        slot.seq.store(done, Ordering::Release);
+    }
+
+    /// Consistent copy of every completed slot, slots torn by a concurrent writer are skipped
+    fn snapshot(&self) -> Vec<Event> {
+        let mut events = Vec::new();
+
+        for slot in self.slots.iter() {
+            let seq = slot.seq.load(Ordering::Acquire);
+            if seq == 0 || seq % 2 == 1 {
+                continue;
+            }
+
+            let name_ptr = slot.name_ptr.load(Ordering::Relaxed);
+            let name_len = slot.name_len.load(Ordering::Relaxed);
+            let phase = slot.phase.load(Ordering::Relaxed);
+            let tid = slot.tid.load(Ordering::Relaxed);
+            let start_ns = slot.start_ns.load(Ordering::Relaxed);
+            let dur_ns = slot.dur_ns.load(Ordering::Relaxed);
+            let request_id = slot.request_id.load(Ordering::Relaxed);
+
+            fence(Ordering::Acquire);
+            if slot.seq.load(Ordering::Relaxed) != seq {
+                continue;
+            }
+
+            // Names are only ever &'static str, so the pointer stays valid once the seq checks out
+            let name = unsafe {
+                std::str::from_utf8_unchecked(std::slice::from_raw_parts(name_ptr, name_len))
+            };
+            events.push(Event {
+                name,
+                phase: if phase == Phase::Async as u8 { Phase::Async } else { Phase::Complete },
+                tid,
+                start_ns,
+                dur_ns,
+                request_id,
+            });
+        }
+
+        events.sort_by_key(|e| e.start_ns);
+        events
+    }
+
+    fn clear(&self) {
+        for slot in self.slots.iter() {
+            slot.seq.store(0, Ordering::Release);
+        }
+    }
+}
+
+pub fn enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+pub fn enable() {
+    LazyLock::force(&EPOCH);
+    LazyLock::force(&RING);
+    ENABLED.store(true, Ordering::Relaxed);
+}
+
+pub fn disable() {
+    ENABLED.store(false, Ordering::Relaxed);
+}
+
+/// Drops every recorded span, tracing stays in its current on/off state
+pub fn clear() {
+    if let Some(ring) = LazyLock::get(&RING) {
+        ring.clear();
+    }
+}
+
+/// SDK-side id attached to a command so its spans can be lined up across threads
+pub fn next_request_id() -> u64 {
+    NEXT_REQUEST_ID.fetch_add(1, Ordering::Relaxed)
+}
+
+/// Labels the calling thread in the trace, e.g. "command" or "mesh_sync"
+pub fn set_thread_name(name: &str) {
+    let tid = thread_id();
+    let mut names = THREAD_NAMES.lock().unwrap();
+    names.retain(|(t, _)| *t != tid);
+    names.push((tid, name.to_string()));
+}
+
+fn thread_id() -> u64 {
+    TID.with(|tid| {
+        if tid.get() == 0 {
+            tid.set(NEXT_TID.fetch_add(1, Ordering::Relaxed));
+        }
+        tid.get()
+    })
+}
+
+fn since_epoch_ns(at: Instant) -> u64 {
+    at.saturating_duration_since(*EPOCH).as_nanos() as u64
+}
+
+fn record(name: &'static str, phase: Phase, start: Instant, end: Instant, request_id: u64) {
+    RING.push(Event {
+        name,
+        phase,
+        tid: thread_id(),
+        start_ns: since_epoch_ns(start),
+        dur_ns: end.saturating_duration_since(start).as_nanos() as u64,
+        request_id,
+    });
+}
+
+/// Records a span on the current thread covering the lifetime of the guard
+pub struct Span {
+    name: &'static str,
+    start: Instant,
+    request_id: u64,
+}
+
+impl Drop for Span {
+    fn drop(&mut self) {
+        record(self.name, Phase::Complete, self.start, Instant::now(), self.request_id);
+    }
+}
+
+/// Starts a span if tracing is enabled, bind it to `_span` so it lives until the end of scope
+pub fn span(name: &'static str) -> Option<Span> {
+    span_with_id(name, 0)
+}
+
+pub fn span_with_id(name: &'static str, request_id: u64) -> Option<Span> {
+    if !enabled() {
+        return None;
+    }
+    Some(Span {
+        name,
+        start: Instant::now(),
+        request_id,
+    })
+}
+
+/// Records an already finished span on the current thread
+pub fn complete(name: &'static str, start: Instant, end: Instant, request_id: u64) {
+    if enabled() {
+        record(name, Phase::Complete, start, end, request_id);
+    }
+}
+
+/// Records a span that may overlap others on the same thread (e.g. a command in flight)
+pub fn async_span(name: &'static str, start: Instant, end: Instant, request_id: u64) {
+    if enabled() {
+        record(name, Phase::Async, start, end, request_id);
+    }
+}
+
+/// Writes every span still in the ring as Chrome trace JSON, returns the number of spans written
+pub fn dump(path: &str) -> Result<usize, String> {
+    let events = match LazyLock::get(&RING) {
+        Some(ring) => ring.snapshot(),
+        None => Vec::new(),
+    };
+
+    let pid = std::process::id();
+    let mut json = String::with_capacity(64 + events.len() * 128);
+    json.push_str("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    let mut first = true;
+    let mut separator = |json: &mut String| {
+        if !first {
+            json.push_str(",\n");
+        }
+        first = false;
+    };
+
+    for (tid, name) in THREAD_NAMES.lock().unwrap().iter() {
+        separator(&mut json);
+        let _ = write!(
+            json,
+            "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+            pid,
+            tid,
+            escape(name)
+        );
+    }
+
+    for e in &events {
+        let ts = e.start_ns as f64 / 1000.0;
+        let dur = e.dur_ns as f64 / 1000.0;
+        match e.phase {
+            Phase::Complete => {
+                separator(&mut json);
+                let _ = write!(
+                    json,
+                    "{{\"name\":\"{}\",\"cat\":\"sdk\",\"ph\":\"X\",\"ts\":{:.3},\"dur\":{:.3},\"pid\":{},\"tid\":{},\"args\":{{\"request_id\":{}}}}}",
+                    escape(e.name),
+                    ts,
+                    dur,
+                    pid,
+                    e.tid,
+                    e.request_id
+                );
+            }
+            Phase::Async => {
+                separator(&mut json);
+                let _ = write!(
+                    json,
+                    "{{\"name\":\"{}\",\"cat\":\"command\",\"ph\":\"b\",\"id\":{},\"ts\":{:.3},\"pid\":{},\"tid\":{},\"args\":{{\"request_id\":{}}}}}",
+                    escape(e.name),
+                    e.request_id,
+                    ts,
+                    pid,
+                    e.tid,
+                    e.request_id
+                );
+                separator(&mut json);
+                let _ = write!(
+                    json,
+                    "{{\"name\":\"{}\",\"cat\":\"command\",\"ph\":\"e\",\"id\":{},\"ts\":{:.3},\"pid\":{},\"tid\":{}}}",
+                    escape(e.name),
+                    e.request_id,
+                    ts + dur,
+                    pid,
+                    e.tid
+                );
+            }
+        }
+    }
+
+    json.push_str("\n]}\n");
+    std::fs::write(path, json).map_err(|e| format!("Failed to write trace to {}: {}", path, e))?;
+    Ok(events.len())
+}
+
+fn escape(s: &str) -> String {
+    let mut out = String::with_capacity(s.len());
+    for c in s.chars() {
+        match c {
+            '"' => out.push_str("\\\""),
+            '\\' => out.push_str("\\\\"),
+            c if (c as u32) < 0x20 => {
+                let _ = write!(out, "\\u{:04x}", c as u32);
+            }
+            c => out.push(c),
+        }
+    }
+    out
+}
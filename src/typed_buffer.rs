@@ -0,0 +1,188 @@
+//! Zero-copy typed views exposed through the Python buffer protocol.
+//!
+//! Unlike `PyMemoryView_FromMemory` (always format `B`, 1-D bytes) these
+//! carry a struct format and shape, so numpy and Blender's `foreach_set`
+//! can consume them directly without a cast or copy.
+
+use pyo3::buffer::{Element, PyBuffer};
+use pyo3::exceptions::{PyBufferError, PyValueError};
+use pyo3::prelude::*;
+use pyo3::ffi;
+use std::any::Any;
+use std::ffi::CStr;
+use std::os::raw::{c_char, c_int, c_void};
+
+#[pyclass(unsendable)]
+pub struct TypedBuffer {
+    ptr: *mut u8,
+    len: usize,
+    itemsize: usize,
+    format: &'static CStr,
+    readonly: bool,
+    shape: Vec<ffi::Py_ssize_t>,
+    strides: Vec<ffi::Py_ssize_t>,
+    /// Whatever owns the memory behind `ptr`, kept alive as long as any view is
+    _owner: Option<Box<dyn Any>>,
+}
+
+impl TypedBuffer {
+    /// C-contiguous view over `len` bytes at `ptr`, shaped as `shape` items of `itemsize` bytes.
+    /// The caller guarantees the memory outlives the buffer, or hands ownership over via `owner`.
+    pub unsafe fn new(
+        ptr: *mut u8,
+        len: usize,
+        itemsize: usize,
+        format: &'static CStr,
+        shape: &[usize],
+        readonly: bool,
+        owner: Option<Box<dyn Any>>,
+    ) -> TypedBuffer {
+        // Row-major strides, innermost dimension is one item
+        let mut strides = vec![0 as ffi::Py_ssize_t; shape.len()];
+        let mut stride = itemsize;
+        for (dim, extent) in shape.iter().enumerate().rev() {
+            strides[dim] = stride as ffi::Py_ssize_t;
+            stride *= *extent;
+        }
+
+        TypedBuffer {
+            ptr,
+            len,
+            itemsize,
+            format,
+            readonly,
+            shape: shape.iter().map(|&d| d as ffi::Py_ssize_t).collect(),
+            strides,
+            _owner: owner,
+        }
+    }
+
+    /// Flat 1-D view over a raw slice; falls back to bytes when the length isn't a whole number of items
+    pub unsafe fn from_slice(
+        slice_ptr: *mut [u8],
+        itemsize: usize,
+        format: &'static CStr,
+        readonly: bool,
+        owner: Option<Box<dyn Any>>,
+    ) -> TypedBuffer {
+        let ptr = slice_ptr as *mut u8;
+        let len = unsafe { (&*slice_ptr).len() };
+
+        if itemsize == 0 || len % itemsize != 0 {
+            return unsafe { TypedBuffer::new(ptr, len, 1, c"B", &[len], readonly, owner) };
+        }
+        unsafe { TypedBuffer::new(ptr, len, itemsize, format, &[len / itemsize], readonly, owner) }
+    }
+}
+
+#[pymethods]
+impl TypedBuffer {
+    unsafe fn __getbuffer__(
+        slf: Bound<'_, Self>,
+        view: *mut ffi::Py_buffer,
+        flags: c_int,
+    ) -> PyResult<()> {
+        if view.is_null() {
+            return Err(PyBufferError::new_err("View is null"));
+        }
+
+        let this = slf.borrow();
+        if (flags & ffi::PyBUF_WRITABLE) == ffi::PyBUF_WRITABLE && this.readonly {
+            return Err(PyBufferError::new_err("Buffer is read-only"));
+        }
+
+        unsafe {
+            (*view).obj = slf.clone().into_any().into_ptr();
+            (*view).buf = this.ptr as *mut c_void;
+            (*view).len = this.len as ffi::Py_ssize_t;
+            (*view).readonly = this.readonly as c_int;
+            (*view).itemsize = this.itemsize as ffi::Py_ssize_t;
+
+            (*view).format = if (flags & ffi::PyBUF_FORMAT) == ffi::PyBUF_FORMAT {
+                this.format.as_ptr() as *mut c_char
+            } else {
+                std::ptr::null_mut()
+            };
+
+            (*view).ndim = this.shape.len() as c_int;
+            (*view).shape = if (flags & ffi::PyBUF_ND) == ffi::PyBUF_ND {
+                this.shape.as_ptr() as *mut ffi::Py_ssize_t
+            } else {
+                std::ptr::null_mut()
+            };
+            (*view).strides = if (flags & ffi::PyBUF_STRIDES) == ffi::PyBUF_STRIDES {
+                this.strides.as_ptr() as *mut ffi::Py_ssize_t
+            } else {
+                std::ptr::null_mut()
+            };
+
+            (*view).suboffsets = std::ptr::null_mut();
+            (*view).internal = std::ptr::null_mut();
+        }
+
+        Ok(())
+    }
+
+    unsafe fn __releasebuffer__(&self, _view: *mut ffi::Py_buffer) {}
+
+    fn __len__(&self) -> usize {
+        self.shape.first().map(|&d| d as usize).unwrap_or(0)
+    }
+}
+
+/// Borrows the contents of an incoming C-contiguous buffer without copying.
+pub fn contiguous_slice<'a, T: Element>(buffer: &'a PyBuffer<T>, name: &str) -> PyResult<&'a [T]> {
+    if !buffer.is_c_contiguous() {
+        return Err(PyValueError::new_err(format!("{} must be a C-contiguous buffer", name)));
+    }
+    Ok(unsafe { std::slice::from_raw_parts(buffer.buf_ptr() as *const T, buffer.item_count()) })
+}
+
+/// Reinterprets a packed byte buffer as fixed-size records (e.g. 32-byte UUIDs).
+pub fn record_slice<'a, R>(bytes: &'a [u8], name: &str) -> PyResult<&'a [R]> {
+    let size = std::mem::size_of::<R>();
+    if bytes.len() % size != 0 {
+        return Err(PyValueError::new_err(format!(
+            "{} length {} is not a multiple of {} bytes",
+            name,
+            bytes.len(),
+            size
+        )));
+    }
+    if (bytes.as_ptr() as usize) % std::mem::align_of::<R>() != 0 {
+        return Err(PyValueError::new_err(format!("{} is not suitably aligned", name)));
+    }
+    Ok(unsafe { std::slice::from_raw_parts(bytes.as_ptr() as *const R, bytes.len() / size) })
+}
+
+/// The bytes of any C-contiguous buffer-protocol object, whatever its item format,
+/// for consumers that only look at the raw contents (e.g. hashing)
+pub struct RawBytes {
+    view: Box<ffi::Py_buffer>,
+}
+
+impl RawBytes {
+    pub fn get(obj: &Bound<'_, PyAny>) -> PyResult<RawBytes> {
+        // Boxed so the exporter may keep pointers into the view struct until release
+        let mut view = Box::new(unsafe { std::mem::zeroed::<ffi::Py_buffer>() });
+        if unsafe { ffi::PyObject_GetBuffer(obj.as_ptr(), &mut *view, ffi::PyBUF_C_CONTIGUOUS) } != 0 {
+            return Err(PyErr::take(obj.py())
+                .unwrap_or_else(|| PyBufferError::new_err("Object does not export a C-contiguous buffer")));
+        }
+        Ok(RawBytes { view })
+    }
+
+    pub fn as_slice(&self) -> &[u8] {
+        if self.view.len == 0 {
+            return &[];
+        }
+        unsafe { std::slice::from_raw_parts(self.view.buf as *const u8, self.view.len as usize) }
+    }
+}
+
+impl Drop for RawBytes {
+    fn drop(&mut self) {
+        // Only ever created and dropped while holding the GIL, the pyfunction that took it owns it
+        unsafe { ffi::PyBuffer_Release(&mut *self.view) };
+    }
+}